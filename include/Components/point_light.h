@@ -8,6 +8,8 @@
 
 struct PointLightData {
   glm::vec4 lightColor;
+  float radius;
+  float intensity;
 };
 
 class Transform;
@@ -19,6 +21,10 @@ public:
   void setPosition(glm::vec3 position);
   glm::vec3 getPosition();
   void setLightColor(glm::vec3 color);
+  void setRadius(float radius);
+  float getRadius();
+  void setIntensity(float intensity);
+  float getIntensity();
   void update(UpdateData*) override;
 
 protected:
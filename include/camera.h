@@ -14,6 +14,10 @@ public:
   glm::vec3 getPosition();
   glm::mat4 getView();
   glm::mat4 getProjection();
+  float getNearPlane();
+  float getFarPlane();
+  //Left, right, bottom, top, near, far. Normals point inside
+  void getFrustumPlanes(glm::vec4* planes);
   void cameraInput(float delta_time);
   void updateCamera();
 
@@ -28,6 +32,8 @@ private:
   float yaw_;
   float speed_;
   float aspect_;
+  float nearPlane_;
+  float farPlane_;
 };
 
 #endif // __CAMERA_H__ 1
@@ -7,6 +7,18 @@
 #include "GLFW/glfw3.h"
 
 #define VALIDATION_LAYERS
+#define BINDLESS_TEXTURES
+#define GPU_CULLING
+#define GPU_NOISE
+#define TEXTURE_STREAMING
+#define GPU_PROFILER
+#define TONEMAPPING
+#define DEPTH_PREPASS
+#define CPU_OCCLUSION
+#define DYNAMIC_RESOLUTION
+//#define NOISE_BENCHMARK
+//#define HEIGHTMAP_GENERATOR
+//#define CPU_PROFILER
 #define PI 3.14159265359f
 
 typedef int8_t int8;
@@ -36,5 +48,101 @@ static std::vector<const char*> deviceExtensions = {
   const bool enableValidationLayers = false;
 #endif
 
+//Only used when the device supports it, otherwise the
+//per material sampler array is kept
+#ifdef BINDLESS_TEXTURES
+  const bool enableBindlessTextures = true;
+#else
+  const bool enableBindlessTextures = false;
+#endif
+
+//Culling and draw generation in a compute pass, needs multiDrawIndirect
+//and drawIndirectFirstInstance, otherwise culling stays on the CPU
+#ifdef GPU_CULLING
+  const bool enableGPUCulling = true;
+#else
+  const bool enableGPUCulling = false;
+#endif
+
+//Noise texture generated by a compute pass, needs r8 storage images,
+//otherwise it is generated on the CPU and uploaded
+#ifdef GPU_NOISE
+  const bool enableGPUNoise = true;
+#else
+  const bool enableGPUNoise = false;
+#endif
+
+//Mip levels of the 2D textures streamed within a memory budget, needs bindless
+//textures updated while pending, otherwise every texture is fully loaded
+#ifdef TEXTURE_STREAMING
+  const bool enableTextureStreaming = true;
+#else
+  const bool enableTextureStreaming = false;
+#endif
+
+//Timestamps and pipeline statistics of every pass, reported every few hundred frames
+//to stdout and gpu_profile.csv, needs timestamps on the graphics queue.
+//Also prints the time to the first frame
+#ifdef GPU_PROFILER
+  const bool enableGPUProfiler = true;
+#else
+  const bool enableGPUProfiler = false;
+#endif
+
+//Tone mapping in the PBR fragment shaders, a specialization constant
+//so the disabled path is stripped from the pipelines
+#ifdef TONEMAPPING
+  const bool enableTonemapping = true;
+#else
+  const bool enableTonemapping = false;
+#endif
+
+//Opaque draws write depth first with position only pipelines, the main pass then
+//shades with an EQUAL depth test so each pixel is shaded about once
+#ifdef DEPTH_PREPASS
+  const bool enableDepthPrepass = true;
+#else
+  const bool enableDepthPrepass = false;
+#endif
+
+//Draw calls behind the largest entities on screen are dropped on the CPU,
+//only where culling stays on the CPU or the entity has a render state variant
+#ifdef CPU_OCCLUSION
+  const bool enableCPUOcclusion = true;
+#else
+  const bool enableCPUOcclusion = false;
+#endif
+
+//Scene rendered at a scale of the swapchain size held to a GPU frame time, then upscaled.
+//Needs the timestamps of the GPU profiler, otherwise it renders at full size
+#ifdef DYNAMIC_RESOLUTION
+  const bool enableDynamicResolution = true;
+#else
+  const bool enableDynamicResolution = false;
+#endif
+
+//CPU zones recorded per thread, written as a Chrome trace on F12 and at exit.
+//Disabled, the zones compile to nothing (dev/cpu_profiler.h)
+#ifdef CPU_PROFILER
+  const bool enableCPUProfiler = true;
+#else
+  const bool enableCPUProfiler = false;
+#endif
+
+//Writes the streamed heightmap from the CPU fractal noise when the file is missing
+//(dev/heightmap_streamer.h)
+#ifdef HEIGHTMAP_GENERATOR
+  const bool enableHeightmapGenerator = true;
+#else
+  const bool enableHeightmapGenerator = false;
+#endif
+
+//Times the scalar and batched CPU noise at startup
+#ifdef NOISE_BENCHMARK
+  const bool enableNoiseBenchmark = true;
+#else
+  const bool enableNoiseBenchmark = false;
+#endif
+
 
 #endif
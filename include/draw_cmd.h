@@ -4,18 +4,53 @@
 #include "common_def.h"
 #include "vulkan/vulkan.h"
 
+//Material classes in draw order, draw calls are sorted by queue before depth
+enum RenderQueue {
+  kRenderQueue_Opaque = 0,
+  //Depth tested at the far plane after the opaques, only uncovered pixels are shaded
+  kRenderQueue_Skybox,
+  //Back to front after everything else
+  kRenderQueue_Transparent,
+  kRenderQueue_MAX,
+};
+
 struct DrawCallData {
   int32 geometry;
   int32 materialType;
   int32 offset;
+  int32 lod;
+  uint32 renderState;
+  uint32 renderQueue;
+  //Distance along the view direction, opaque draws are sorted front to back
+  float viewDepth;
+  //Render state variant of the main and depth passes, resolved once per frame.
+  //Null draws with the pipelines of the material
+  VkPipeline pipeline;
+  VkPipeline depthPipeline;
+};
+
+struct CullingStats {
+  uint32 visible;
+  uint32 culled;
+  //Inside the frustum but hidden behind the occluders rasterized on the CPU
+  uint32 occluded;
 };
 
 class DrawCmd {
 public:
-  DrawCmd(){}
+  DrawCmd() : depthOnly_(false) {}
+  //Draws with the depth pre-pass pipelines, skipping what doesn't write depth
+  explicit DrawCmd(bool depth_only) : depthOnly_(depth_only) {}
   ~DrawCmd(){}
-  DrawCmd(const DrawCmd&) {}
+  DrawCmd(const DrawCmd& other) : depthOnly_(other.depthOnly_) {}
   void Execute(VkCommandBuffer cmd_buffer, DrawCallData draw_call, uint32 index, int64_t buffer_padding);
+  void ExecuteIndirect(VkCommandBuffer cmd_buffer, int32 material_type, uint32 index);
+  void ExecuteTerrain(VkCommandBuffer cmd_buffer, uint32 index);
+
+private:
+  void BindMaterial(VkCommandBuffer cmd_buffer, int32 material_type, uint32 index, VkPipeline variant = VK_NULL_HANDLE);
+
+  bool depthOnly_;
 
 };
 
@@ -10,6 +10,7 @@ enum KeyCode {
   kKeyCode_S = 2,
   kKeyCode_D = 3,
   kKeyCode_ESC = 4,
+  kKeyCode_F12 = 5,
   kKeyCode_MAX
 };
 
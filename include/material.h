@@ -17,6 +17,15 @@ enum class MaterialType {
   kMaterialType_MAX,
 };
 
+//Fixed function overrides on top of the material type, each combination is its own pipeline
+enum RenderStateFlags {
+  kRenderState_Default = 0,
+  kRenderState_DoubleSided = 1,
+  //Ignored when the device can't rasterize lines
+  kRenderState_Wireframe = 2,
+  kRenderState_NoDepth = 4,
+};
+
 class Camera;
 class Texture;
 union UniformBlocks;
@@ -34,6 +43,8 @@ public:
   int32 setGammaCorrection(float gamma);
   int32 setRandomNoise(float rand);
   int32 setNoiseAmplification(float amp);
+  void setRenderState(uint32 flags);
+  uint32 getRenderState();
 
   void updateMaterialSettings(glm::mat4 model, const uint32 buffer_offset, const uint64_t buffer_padding);
 
@@ -50,6 +61,7 @@ private:
   int32 materialId_;
   MaterialType type_;
   UniformBlocks* settings_;
+  uint32 renderState_;
 
   friend class ResourceManager;
 };
@@ -14,7 +14,18 @@ private:
 
 public:
   PerlinNoise();
+  //Same seed, same permutations on every platform
+  PerlinNoise(uint32 seed);
   float noise(float x, float y, float z);
+  //Batched row, result[i] is bit identical to noise(x[i], y, z)
+  void noise(const float* x, float y, float z, uint32 count, float* result);
+  //Four corners instead of eight, equal to noise(x, y, 0) with the default period.
+  //The lattice wraps every period cells (power of two up to 256), so it tiles
+  float noise2D(float x, float y, uint32 period = 256);
+  const uint32* getPermutations() const;
+
+  //Checked once, the batched paths use 8 lanes when it is available
+  static bool hasAVX2();
 
 };
 
@@ -28,9 +39,19 @@ public:
 
   FractalNoise(const PerlinNoise& perlinNoise);
   float noise(float x, float y, float z);
+  //Batched row, result[i] is bit identical to noise(x[i], y, z)
+  void noise(const float* x, float y, float z, uint32 count, float* result);
+  //The period doubles with every octave, period << (octaves - 1) must not exceed 256 to tile
+  float noise2D(float x, float y, uint32 period = 256);
+  //Batched row, result[i] is bit identical to noise2D(x[i], y, period)
+  void noise2D(const float* x, float y, uint32 period, uint32 count, float* result);
+  //Whole image with the rows split between threads,
+  //texel (j, i) is noise2D(j / (float)width * scale, i / (float)height * scale, period)
+  void noiseImage(uint32 width, uint32 height, float scale, uint32 period, float* result);
+
+  //Scalar against batched timings at 512, 2048 and 8192 texels per side
+  static void benchmark();
 
 };
 
 #endif // define  __PERLIN_NOISE__ 1
-
-
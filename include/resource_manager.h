@@ -13,6 +13,7 @@ class Material;
 class Texture;
 class Camera;
 class Geometry;
+struct CullingStats;
 //enum class TextureFormat;
 class ResourceManager {
 public:
@@ -26,6 +27,8 @@ public:
   void createMaterial(Material*);
   void createTexture(Texture*);
   Camera& getCamera();
+  //Draw calls kept and discarded by frustum and occlusion culling in the last frame
+  CullingStats getCullingStats() const;
   std::list<PtrAlloc<Geometry>> loadObj(std::string path);
 
 
@@ -11,6 +11,7 @@ struct Resources;
 class UserMain;
 namespace vkdev {
   class VkTexture;
+  struct DecodedImage;
 }
 
 class VulkanApp {
@@ -54,15 +55,15 @@ private:
   //Render Pass
   void createRenderPass();
 
-  //FrameBuffer
-  void createFramebuffer();
+  //Frame passes
+  void createRenderGraph();
 
   //CommandPool
   void createCommandPool();
 
   void createDepthResource();
 
-  void storeTextures();
+  void storeTextures(vkdev::DecodedImage* decoded);
 
   //Buffers
   void createVertexBuffers();
@@ -71,9 +72,14 @@ private:
   void createDescriptorSetLayout();
   void createDescriptorPool();
   void createDescriptorSets();
+  void createBindlessTextureSet();
+  void createGPUCulling();
+  void createGPUProfiler();
+  void createHeightmapStreamer();
   void createUniformBuffers();
 
   void updateUniformBuffers(uint32 index);
+  void updateLightStorage(uint32 index, uint32 light_count);
 
   void initFrameData(uint32 frame_count);
   void destroyFrameData(FrameData& frame_data);
@@ -83,8 +89,9 @@ private:
   void generateBRDFLUT();
   void generateIrradianceCube();
   void generatePrefilteredCube();
-  uint32 generateIBLTextures();
+  bool hasSkyboxTexture();
   void generateNoiseTexture(uint32 width, uint32 height);
+  void loadTerrainTextures(vkdev::DecodedImage* decoded);
   void updateNoiseTexture(vkdev::VkTexture* texture);
 
   int32 presentImage(uint32 index);
@@ -7,6 +7,8 @@ PointLight::PointLight()
   type_ = ComponentType::kComponentType_Light;
   lightTransform_.alloc();
   params_.lightColor = glm::vec4(1.0f);
+  params_.radius = 5.0f;
+  params_.intensity = 1.0f;
 }
 
 PointLight::PointLight(const PointLight& other)
@@ -31,13 +33,35 @@ void PointLight::setLightColor(glm::vec3 color)
   params_.lightColor = { color, 1.0f };
 }
 
+void PointLight::setRadius(float radius)
+{
+  params_.radius = radius;
+}
+
+float PointLight::getRadius()
+{
+  return params_.radius;
+}
+
+void PointLight::setIntensity(float intensity)
+{
+  params_.intensity = intensity;
+}
+
+float PointLight::getIntensity()
+{
+  return params_.intensity;
+}
+
 void PointLight::update(UpdateData* buffer)
 {
-  LightParams* light_block = &buffer->sceneBuffer.lights[buffer->sceneBuffer.lightNumber];
-  light_block->lightPosition = { lightTransform_->getPosition() , 0.0f};
-  light_block->lilghtColor = params_.lightColor;
-  ++buffer->sceneBuffer.lightNumber;
   buffer->model = lightTransform_->getModel();
+
+  LightParams light_block;
+  light_block.lightPosition = { lightTransform_->getPosition(), params_.radius };
+  light_block.lilghtColor = { glm::vec3(params_.lightColor), params_.intensity };
+  buffer->lights->push_back(light_block);
+  ++buffer->sceneBuffer.lightNumber;
 }
 
 
@@ -12,6 +12,8 @@ Camera::Camera()
   input_ = glm::vec3(0.0f);
   speed_ = 10.0f;
   aspect_ = k_wWidth / (float)k_wHeight;
+  nearPlane_ = 0.1f;
+  farPlane_ = 100.0f;
   lastCoords_ = { 400.0f, 300.0f };
   yaw_ = -75.3f;
   pitch_ = 14.5f;
@@ -26,6 +28,8 @@ Camera::Camera(const Camera& other)
   input_ = other.input_;
   speed_ = other.speed_;
   aspect_ = other.aspect_;
+  nearPlane_ = other.nearPlane_;
+  farPlane_ = other.farPlane_;
   lastCoords_ = other.lastCoords_;
   yaw_ = other.yaw_;
   pitch_ = other.pitch_;
@@ -100,6 +104,31 @@ glm::mat4 Camera::getView()
 
 glm::mat4 Camera::getProjection()
 {
-  return glm::perspective(glm::radians(45.0f), aspect_, 0.1f, 100.0f);
+  return glm::perspective(glm::radians(45.0f), aspect_, nearPlane_, farPlane_);
+}
+
+float Camera::getNearPlane()
+{
+  return nearPlane_;
+}
+
+float Camera::getFarPlane()
+{
+  return farPlane_;
+}
+
+void Camera::getFrustumPlanes(glm::vec4* planes)
+{
+  glm::mat4 view_proj = glm::transpose(getProjection() * getView());
+  planes[0] = view_proj[3] + view_proj[0];
+  planes[1] = view_proj[3] - view_proj[0];
+  planes[2] = view_proj[3] + view_proj[1];
+  planes[3] = view_proj[3] - view_proj[1];
+  planes[4] = view_proj[3] + view_proj[2];
+  planes[5] = view_proj[3] - view_proj[2];
+
+  for (size_t i = 0; i < 6; i++) {
+    planes[i] /= glm::length(glm::vec3(planes[i]));
+  }
 }
 
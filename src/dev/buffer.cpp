@@ -83,6 +83,9 @@ void vkdev::Buffer::destroyBuffer()
     vkDestroyBuffer(device_, buffer_, nullptr);
     vkFreeMemory(device_, memory_, nullptr);
     buffer_ = VK_NULL_HANDLE;
+    memory_ = VK_NULL_HANDLE;
+    mapped_ = nullptr;
+    device_ = VK_NULL_HANDLE;
   }
 }
 
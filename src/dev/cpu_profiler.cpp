@@ -0,0 +1,123 @@
+#include "dev/cpu_profiler.h"
+
+#ifdef CPU_PROFILER
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+
+
+struct ZoneEvent {
+  const char* name;
+  int64_t begin;
+  int64_t end;
+};
+
+//Single writer, the owner thread. head counts every zone recorded so far
+struct ThreadZones {
+  std::atomic<uint64_t> head;
+  std::atomic<const char*> name;
+  ZoneEvent events[kZoneBufferSize];
+};
+
+static std::atomic<uint32> threadCount(0);
+static std::atomic<ThreadZones*> threadZones[kMaxZoneThreads];
+static thread_local ThreadZones* localZones = nullptr;
+static thread_local bool localRegistered = false;
+
+//Rings stay alive until exit so the last export can read them
+static struct ZoneCleanup {
+  ~ZoneCleanup() {
+    for (uint32 i = 0; i < kMaxZoneThreads; i++) {
+      delete threadZones[i].load();
+    }
+  }
+} zoneCleanup;
+
+static ThreadZones* getLocalZones()
+{
+  if (localRegistered) return localZones;
+  localRegistered = true;
+
+  //Threads beyond kMaxZoneThreads are not recorded
+  uint32 index = threadCount.fetch_add(1);
+  if (index >= kMaxZoneThreads) return nullptr;
+
+  localZones = new ThreadZones();
+  localZones->head.store(0);
+  localZones->name.store(nullptr);
+  threadZones[index].store(localZones, std::memory_order_release);
+
+  return localZones;
+}
+
+int64_t vkdev::CPUProfiler::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void vkdev::CPUProfiler::record(const char* name, int64_t begin, int64_t end)
+{
+  ThreadZones* zones = getLocalZones();
+  if (!zones) return;
+
+  uint64_t head = zones->head.load(std::memory_order_relaxed);
+  zones->events[head % kZoneBufferSize] = { name, begin, end };
+  zones->head.store(head + 1, std::memory_order_release);
+}
+
+void vkdev::CPUProfiler::setThreadName(const char* name)
+{
+  ThreadZones* zones = getLocalZones();
+  if (zones) zones->name.store(name);
+}
+
+static void writeEscaped(FILE* file, const char* text)
+{
+  for (; *text; text++) {
+    if (*text == '"' || *text == '\\') fputc('\\', file);
+    fputc(*text, file);
+  }
+}
+
+bool vkdev::CPUProfiler::writeTrace(const char* path)
+{
+  FILE* file = fopen(path, "w");
+  if (!file) return false;
+
+  fprintf(file, "{\"traceEvents\":[\n");
+  bool first = true;
+  uint32 count = std::min(threadCount.load(), kMaxZoneThreads);
+  for (uint32 tid = 0; tid < count; tid++) {
+    ThreadZones* zones = threadZones[tid].load(std::memory_order_acquire);
+    if (!zones) continue;
+
+    const char* name = zones->name.load();
+    fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"", first ? "" : ",\n", tid);
+    if (name) writeEscaped(file, name);
+    else fprintf(file, "thread %u", tid);
+    fprintf(file, "\"}}");
+    first = false;
+
+    uint64_t head = zones->head.load(std::memory_order_acquire);
+    uint64_t tail = head > kZoneBufferSize ? head - kZoneBufferSize : 0;
+    for (uint64_t i = tail; i < head; i++) {
+      ZoneEvent event = zones->events[i % kZoneBufferSize];
+      //The owner may have wrapped around over this slot while it was copied. It stores
+      //the event before publishing head + 1, so at head - i == size it may be writing it
+      if (zones->head.load(std::memory_order_acquire) - i >= kZoneBufferSize) continue;
+
+      fprintf(file, ",\n{\"name\":\"");
+      writeEscaped(file, event.name);
+      fprintf(file, "\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+              tid, event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+    }
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef __VKDEV_CPU_PROFILER__
+#define __VKDEV_CPU_PROFILER__ 1
+
+#include "common_def.h"
+
+//Zones are only compiled with CPU_PROFILER, otherwise every macro expands to a no-op statement
+#ifdef CPU_PROFILER
+
+//Zones kept per thread, the oldest are overwritten
+const uint32 kZoneBufferSize = 1 << 16;
+const uint32 kMaxZoneThreads = 32;
+const char* const kTracePath = "cpu_trace.json";
+
+namespace vkdev {
+  //Every thread writes its zones into its own ring, the trace export reads them without stopping the writers
+  namespace CPUProfiler {
+    int64_t now();
+    void record(const char* name, int64_t begin, int64_t end);
+    void setThreadName(const char* name);
+    //Chrome / Perfetto json with the zones still in the rings
+    bool writeTrace(const char* path);
+  }
+
+  class ScopedZone {
+  public:
+    ScopedZone(const char* name) : name_(name), begin_(CPUProfiler::now()) {}
+    ~ScopedZone() { CPUProfiler::record(name_, begin_, CPUProfiler::now()); }
+
+  private:
+    ScopedZone(const ScopedZone&);
+    const char* name_;
+    int64_t begin_;
+  };
+}
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+//Names must outlive the trace export, string literals
+#define PROFILE_ZONE(name) vkdev::ScopedZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#define PROFILE_THREAD(name) vkdev::CPUProfiler::setThreadName(name)
+#define PROFILE_WRITE_TRACE(path) vkdev::CPUProfiler::writeTrace(path)
+
+#else
+
+#define PROFILE_ZONE(name) ((void)(name))
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#define PROFILE_WRITE_TRACE(path) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,240 @@
+#include "dev/dynamic_resolution.h"
+#include "internal.h"
+#include "static_helpers.h"
+#include <algorithm>
+
+
+vkdev::DynamicResolution::DynamicResolution()
+{
+  context_ = nullptr;
+  extent_ = { 0, 0 };
+  scale_ = kMaxRenderScale;
+  previousScale_ = kMaxRenderScale;
+  frameMs_ = 0.0f;
+  sampler_ = VK_NULL_HANDLE;
+  setLayout_ = VK_NULL_HANDLE;
+  layout_ = VK_NULL_HANDLE;
+  pipeline_ = VK_NULL_HANDLE;
+  descriptorPool_ = VK_NULL_HANDLE;
+  set_ = VK_NULL_HANDLE;
+}
+
+void vkdev::DynamicResolution::setExtent(uint32 width, uint32 height)
+{
+  extent_ = { width, height };
+}
+
+void vkdev::DynamicResolution::create(Context* context, VkRenderPass render_pass, VkImageView color)
+{
+  context_ = context;
+  //Clamped in the shader, no texel outside the scaled region is filtered in
+  sampler_ = dev::StaticHelpers::createTextureSampler(context, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                                                      VK_COMPARE_OP_NEVER, 1,
+                                                      VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK, VK_FALSE);
+
+  std::vector<VkDescriptorSetLayoutBinding> bindings = {
+    dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0)
+  };
+  VkDescriptorSetLayoutCreateInfo set_info = dev::StaticHelpers::setLayoutCreateInfoInitializer(bindings);
+  assert(vkCreateDescriptorSetLayout(context->logDevice_, &set_info, nullptr, &setLayout_) == VK_SUCCESS);
+
+  VkPushConstantRange push_range{};
+  push_range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  push_range.offset = 0;
+  push_range.size = sizeof(UpscaleConstants);
+
+  VkPipelineLayoutCreateInfo layout_info{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+  layout_info.setLayoutCount = 1;
+  layout_info.pSetLayouts = &setLayout_;
+  layout_info.pushConstantRangeCount = 1;
+  layout_info.pPushConstantRanges = &push_range;
+  assert(vkCreatePipelineLayout(context->logDevice_, &layout_info, nullptr, &layout_) == VK_SUCCESS);
+
+  VkDescriptorPoolSize pool_size{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 };
+  VkDescriptorPoolCreateInfo pool_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+  pool_info.poolSizeCount = 1;
+  pool_info.pPoolSizes = &pool_size;
+  pool_info.maxSets = 1;
+  assert(vkCreateDescriptorPool(context->logDevice_, &pool_info, nullptr, &descriptorPool_) == VK_SUCCESS);
+
+  VkDescriptorSetAllocateInfo alloc_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+  alloc_info.descriptorPool = descriptorPool_;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &setLayout_;
+  assert(vkAllocateDescriptorSets(context->logDevice_, &alloc_info, &set_) == VK_SUCCESS);
+
+  VkDescriptorImageInfo color_info{ sampler_, color, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+  VkWriteDescriptorSet write = dev::StaticHelpers::descriptorWriteInitializer(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                                              set_, &color_info);
+  vkUpdateDescriptorSets(context->logDevice_, 1, &write, 0, nullptr);
+
+  //Fullscreen triangle without vertex input
+  VkPipelineVertexInputStateCreateInfo vertex_input{ VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+
+  VkPipelineInputAssemblyStateCreateInfo input_assembly{ VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+  input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+  VkPipelineViewportStateCreateInfo viewport_state{ VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+  viewport_state.viewportCount = 1;
+  viewport_state.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer{ VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.cullMode = VK_CULL_MODE_NONE;
+  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  rasterizer.lineWidth = 1.0f;
+
+  VkPipelineMultisampleStateCreateInfo multisampler{ VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+  multisampler.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkPipelineDepthStencilStateCreateInfo depth_stencil{ VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+  depth_stencil.depthTestEnable = VK_FALSE;
+  depth_stencil.depthWriteEnable = VK_FALSE;
+
+  VkPipelineColorBlendAttachmentState blend_attachment{};
+  blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                    VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  blend_attachment.blendEnable = VK_FALSE;
+
+  VkPipelineColorBlendStateCreateInfo blend_state{ VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+  blend_state.attachmentCount = 1;
+  blend_state.pAttachments = &blend_attachment;
+
+  VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+  VkPipelineDynamicStateCreateInfo dynamic_state{ VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+  dynamic_state.dynamicStateCount = 2;
+  dynamic_state.pDynamicStates = dynamic_states;
+
+  VkPipelineShaderStageCreateInfo stages[2] = {};
+  stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  stages[0].module = context->shaderCache.getModule(context->logDevice_, "./../../src/shaders/spir-v/upscale_vert.spv");
+  stages[0].pName = "main";
+  stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  stages[1].module = context->shaderCache.getModule(context->logDevice_, "./../../src/shaders/spir-v/upscale_frag.spv");
+  stages[1].pName = "main";
+
+  VkGraphicsPipelineCreateInfo pipeline_info{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+  pipeline_info.stageCount = 2;
+  pipeline_info.pStages = stages;
+  pipeline_info.pVertexInputState = &vertex_input;
+  pipeline_info.pInputAssemblyState = &input_assembly;
+  pipeline_info.pViewportState = &viewport_state;
+  pipeline_info.pRasterizationState = &rasterizer;
+  pipeline_info.pMultisampleState = &multisampler;
+  pipeline_info.pDepthStencilState = &depth_stencil;
+  pipeline_info.pColorBlendState = &blend_state;
+  pipeline_info.pDynamicState = &dynamic_state;
+  pipeline_info.layout = layout_;
+  pipeline_info.renderPass = render_pass;
+  pipeline_info.subpass = 0;
+  pipeline_info.basePipelineIndex = -1;
+  assert(vkCreateGraphicsPipelines(context->logDevice_, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline_) == VK_SUCCESS);
+}
+
+void vkdev::DynamicResolution::destroy()
+{
+  if (!context_) return;
+  VkDevice device = context_->logDevice_;
+  vkDestroyPipeline(device, pipeline_, nullptr);
+  vkDestroyPipelineLayout(device, layout_, nullptr);
+  vkDestroyDescriptorPool(device, descriptorPool_, nullptr);
+  vkDestroyDescriptorSetLayout(device, setLayout_, nullptr);
+  vkDestroySampler(device, sampler_, nullptr);
+  context_ = nullptr;
+}
+
+bool vkdev::DynamicResolution::isEnabled()
+{
+  return context_ != nullptr;
+}
+
+
+/*******************************************************************************/
+
+void vkdev::DynamicResolution::update(float gpu_ms)
+{
+  previousScale_ = scale_;
+  if (!context_ || gpu_ms <= 0.0f) return;
+
+  frameMs_ = frameMs_ > 0.0f ? frameMs_ + (gpu_ms - frameMs_) * kFrameTimeSmoothing : gpu_ms;
+  float ratio = kTargetFrameMs / frameMs_;
+  if (fabs(ratio - 1.0f) < kFrameTimeTolerance) return;
+
+  //Shading cost follows the pixel count, the square of the scale
+  float scale = scale_ * sqrt(ratio);
+  scale = glm::clamp(scale, scale_ - kRenderScaleStep, scale_ + kRenderScaleStep);
+  scale_ = glm::clamp(scale, kMinRenderScale, kMaxRenderScale);
+}
+
+VkExtent2D vkdev::DynamicResolution::scaledExtent(float scale)
+{
+  VkExtent2D extent;
+  extent.width = std::max(static_cast<uint32>(extent_.width * scale), 1u);
+  extent.height = std::max(static_cast<uint32>(extent_.height * scale), 1u);
+
+  return extent;
+}
+
+glm::vec2 vkdev::DynamicResolution::getScale()
+{
+  VkExtent2D extent = getRenderExtent();
+  return glm::vec2((float)extent.width / extent_.width, (float)extent.height / extent_.height);
+}
+
+glm::vec2 vkdev::DynamicResolution::getPreviousScale()
+{
+  VkExtent2D extent = scaledExtent(previousScale_);
+  return glm::vec2((float)extent.width / extent_.width, (float)extent.height / extent_.height);
+}
+
+VkExtent2D vkdev::DynamicResolution::getRenderExtent()
+{
+  return scaledExtent(scale_);
+}
+
+void vkdev::DynamicResolution::setViewport(VkCommandBuffer cmd_buffer)
+{
+  VkExtent2D extent = getRenderExtent();
+
+  VkViewport viewport{};
+  viewport.width = (float)extent.width;
+  viewport.height = (float)extent.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+
+  VkRect2D scissor{};
+  scissor.offset = { 0, 0 };
+  scissor.extent = extent;
+
+  vkCmdSetViewport(cmd_buffer, 0, 1, &viewport);
+  vkCmdSetScissor(cmd_buffer, 0, 1, &scissor);
+}
+
+void vkdev::DynamicResolution::upscale(VkCommandBuffer cmd_buffer)
+{
+  VkExtent2D extent = getRenderExtent();
+
+  //Whole swapchain image
+  VkViewport viewport{};
+  viewport.width = (float)extent_.width;
+  viewport.height = (float)extent_.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+
+  VkRect2D scissor{};
+  scissor.offset = { 0, 0 };
+  scissor.extent = extent_;
+
+  UpscaleConstants constants;
+  constants.uvScale = { (float)extent.width / extent_.width, (float)extent.height / extent_.height };
+  constants.uvMax = { (extent.width - 0.5f) / extent_.width, (extent.height - 0.5f) / extent_.height };
+
+  vkCmdSetViewport(cmd_buffer, 0, 1, &viewport);
+  vkCmdSetScissor(cmd_buffer, 0, 1, &scissor);
+  vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_);
+  vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout_, 0, 1, &set_, 0, nullptr);
+  vkCmdPushConstants(cmd_buffer, layout_, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(UpscaleConstants), &constants);
+  vkCmdDraw(cmd_buffer, 3, 1, 0, 0);
+}
@@ -0,0 +1,76 @@
+#ifndef __VKDEV_DYNAMIC_RESOLUTION__
+#define __VKDEV_DYNAMIC_RESOLUTION__ 1
+
+#include "vulkan/vulkan.h"
+#include "glm/glm.hpp"
+#include "common_def.h"
+
+//Fraction of the swapchain width and height the scene is rendered at
+const float kMinRenderScale = 0.5f;
+const float kMaxRenderScale = 1.0f;
+//GPU time of a frame the scale is adjusted to hold, 60 Hz with some margin
+const float kTargetFrameMs = 14.0f;
+//Weight of a new measurement in the smoothed GPU time
+const float kFrameTimeSmoothing = 0.1f;
+//Smoothed time within this fraction of the target keeps the scale
+const float kFrameTimeTolerance = 0.05f;
+//Largest change of the scale between two frames
+const float kRenderScaleStep = 0.02f;
+
+//Same layout as the push constants of upscale.frag
+struct UpscaleConstants {
+  //Scaled region in the uv of the color target, and its last texel center
+  glm::vec2 uvScale;
+  glm::vec2 uvMax;
+};
+
+struct Context;
+namespace vkdev {
+  //Render scale chosen from the GPU frame time measured by the profiler. The scene is drawn in the top left
+  //corner of full size targets with a dynamic viewport, then filtered to the swapchain with a fullscreen triangle.
+  //Without the upscale pass the scale stays at 1 and only the viewport is set
+  class DynamicResolution {
+  public:
+    DynamicResolution();
+    ~DynamicResolution(){}
+
+    //Size of the targets, the largest extent rendered
+    void setExtent(uint32 width, uint32 height);
+    //Pipeline against the upscale pass, sampling the color target the scene is drawn into
+    void create(Context* context, VkRenderPass render_pass, VkImageView color);
+    void destroy();
+    bool isEnabled();
+
+    //Once per frame, after recording it. Times of 0 (no measurement yet) keep the scale
+    void update(float gpu_ms);
+    //Scaled region over the targets per axis, from the render extent the viewport uses
+    glm::vec2 getScale();
+    //Region of the frame recorded before the last update, the one the depth pyramid was built with
+    glm::vec2 getPreviousScale();
+    VkExtent2D getRenderExtent();
+
+    //Viewport and scissor of the scaled region, the material pipelines keep them dynamic
+    void setViewport(VkCommandBuffer cmd_buffer);
+    void upscale(VkCommandBuffer cmd_buffer);
+
+  private:
+    DynamicResolution(const DynamicResolution&);
+    //Truncated to whole pixels, at least one
+    VkExtent2D scaledExtent(float scale);
+
+    Context* context_;
+    VkExtent2D extent_;
+    float scale_;
+    float previousScale_;
+    float frameMs_;
+
+    VkSampler sampler_;
+    VkDescriptorSetLayout setLayout_;
+    VkPipelineLayout layout_;
+    VkPipeline pipeline_;
+    VkDescriptorPool descriptorPool_;
+    VkDescriptorSet set_;
+  };
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include "dev/frustum_culling.h"
+#include <xmmintrin.h>
+#include <algorithm>
+
+
+glm::vec4 vkdev::FrustumCulling::transformSphere(const glm::vec4& local_sphere, const glm::mat4& model)
+{
+  glm::vec4 center = model * glm::vec4(glm::vec3(local_sphere), 1.0f);
+  float scale = std::max(glm::length(glm::vec3(model[0])),
+                         std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+  return glm::vec4(glm::vec3(center), local_sphere.w * scale);
+}
+
+void vkdev::FrustumCulling::clear()
+{
+  x_.clear();
+  y_.clear();
+  z_.clear();
+  radius_.clear();
+}
+
+uint32 vkdev::FrustumCulling::addSphere(const glm::vec4& local_sphere, const glm::mat4& model)
+{
+  glm::vec4 sphere = transformSphere(local_sphere, model);
+
+  x_.push_back(sphere.x);
+  y_.push_back(sphere.y);
+  z_.push_back(sphere.z);
+  radius_.push_back(sphere.w);
+
+  return static_cast<uint32>(x_.size() - 1);
+}
+
+void vkdev::FrustumCulling::cull(const glm::vec4* planes)
+{
+  uint32 count = getCount();
+  //Padding lanes get a negative radius so they never pass
+  uint32 padded = (count + 3) & ~3;
+  x_.resize(padded, 0.0f);
+  y_.resize(padded, 0.0f);
+  z_.resize(padded, 0.0f);
+  radius_.resize(padded, -1.0f);
+  visible_.resize(padded);
+
+  __m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+  for (uint32 p = 0; p < 6; p++) {
+    plane_x[p] = _mm_set1_ps(planes[p].x);
+    plane_y[p] = _mm_set1_ps(planes[p].y);
+    plane_z[p] = _mm_set1_ps(planes[p].z);
+    plane_w[p] = _mm_set1_ps(planes[p].w);
+  }
+
+  for (uint32 i = 0; i < padded; i += 4) {
+    __m128 x = _mm_loadu_ps(&x_[i]);
+    __m128 y = _mm_loadu_ps(&y_[i]);
+    __m128 z = _mm_loadu_ps(&z_[i]);
+    __m128 neg_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius_[i]));
+
+    //Inside while the signed distance to every plane is greater than -radius
+    __m128 inside = _mm_cmpeq_ps(x, x);
+    for (uint32 p = 0; p < 6; p++) {
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_x[p], x), _mm_mul_ps(plane_y[p], y)),
+                                   _mm_add_ps(_mm_mul_ps(plane_z[p], z), plane_w[p]));
+      inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, neg_radius));
+    }
+
+    int32 mask = _mm_movemask_ps(inside);
+    visible_[i] = mask & 1;
+    visible_[i + 1] = (mask >> 1) & 1;
+    visible_[i + 2] = (mask >> 2) & 1;
+    visible_[i + 3] = (mask >> 3) & 1;
+  }
+
+  x_.resize(count);
+  y_.resize(count);
+  z_.resize(count);
+  radius_.resize(count);
+}
+
+bool vkdev::FrustumCulling::isVisible(uint32 index)
+{
+  return visible_[index] != 0;
+}
+
+glm::vec4 vkdev::FrustumCulling::getSphere(uint32 index)
+{
+  return { x_[index], y_[index], z_[index], radius_[index] };
+}
+
+uint32 vkdev::FrustumCulling::getCount()
+{
+  return static_cast<uint32>(radius_.size());
+}
@@ -0,0 +1,31 @@
+#ifndef __VKDEV_FRUSTUM_CULLING__
+#define __VKDEV_FRUSTUM_CULLING__ 1
+
+#include "glm/glm.hpp"
+#include "common_def.h"
+
+namespace vkdev {
+  //Bounding spheres stored as SoA, tested 4 at a time against the 6 frustum planes
+  class FrustumCulling {
+  public:
+    FrustumCulling(){}
+    ~FrustumCulling(){}
+
+    static glm::vec4 transformSphere(const glm::vec4& local_sphere, const glm::mat4& model);
+
+    void clear();
+    uint32 addSphere(const glm::vec4& local_sphere, const glm::mat4& model);
+    void cull(const glm::vec4* planes);
+    bool isVisible(uint32 index);
+    glm::vec4 getSphere(uint32 index);
+    uint32 getCount();
+
+  private:
+    FrustumCulling(const FrustumCulling&);
+
+    std::vector<float> x_, y_, z_, radius_;
+    std::vector<uint8> visible_;
+  };
+}
+
+#endif
@@ -0,0 +1,384 @@
+#include "dev/gpu_culling.h"
+#include "internal.h"
+#include "static_helpers.h"
+#include <algorithm>
+#include <cstring>
+
+
+vkdev::GPUCulling::GPUCulling()
+{
+  context_ = nullptr;
+  compact_ = false;
+  pyramidReady_ = false;
+  cullSetLayout_ = VK_NULL_HANDLE;
+  pyramidSetLayout_ = VK_NULL_HANDLE;
+  cullLayout_ = VK_NULL_HANDLE;
+  pyramidLayout_ = VK_NULL_HANDLE;
+  cullPipeline_ = VK_NULL_HANDLE;
+  pyramidPipeline_ = VK_NULL_HANDLE;
+  descriptorPool_ = VK_NULL_HANDLE;
+  drawIndexedIndirectCount_ = nullptr;
+}
+
+void vkdev::GPUCulling::create(Context* context, VkTexture* depth, uint32 image_count)
+{
+  context_ = context;
+  compact_ = context->caps.drawIndirectCount;
+  if (compact_) {
+    drawIndexedIndirectCount_ = (PFN_vkCmdDrawIndexedIndirectCountKHR)
+      vkGetDeviceProcAddr(context->logDevice_, "vkCmdDrawIndexedIndirectCountKHR");
+    compact_ = drawIndexedIndirectCount_ != nullptr;
+  }
+
+  createBuffers(image_count);
+  createDepthPyramid(depth);
+  createPipelines();
+  createDescriptorSets(depth);
+}
+
+void vkdev::GPUCulling::createBuffers(uint32 image_count)
+{
+  VkDeviceSize object_size = sizeof(GPUObject) * kMaxInstance;
+  VkDeviceSize command_size = sizeof(VkDrawIndexedIndirectCommand) * kMaxInstance * (uint32)MaterialType::kMaterialType_MAX;
+  VkDeviceSize count_size = sizeof(uint32) * (uint32)MaterialType::kMaterialType_MAX;
+  VkMemoryPropertyFlags host_props = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+  objectBuffers_.resize(image_count);
+  cullUniforms_.resize(image_count);
+  indirectBuffers_.resize(image_count);
+  countBuffers_.resize(image_count);
+  objectCounts_.resize(image_count, 0);
+  for (uint32 i = 0; i < image_count; i++) {
+    objectBuffers_[i].createBuffer(context_, object_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host_props);
+    vkMapMemory(context_->logDevice_, objectBuffers_[i].memory_, 0, object_size, 0, &objectBuffers_[i].mapped_);
+
+    cullUniforms_[i].createBuffer(context_, sizeof(CullUniform), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, host_props);
+    vkMapMemory(context_->logDevice_, cullUniforms_[i].memory_, 0, sizeof(CullUniform), 0, &cullUniforms_[i].mapped_);
+
+    indirectBuffers_[i].createBuffer(context_, command_size,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    //Host visible, the counts of the last submission are read back for the stats
+    countBuffers_[i].createBuffer(context_, count_size,
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  host_props);
+    vkMapMemory(context_->logDevice_, countBuffers_[i].memory_, 0, count_size, 0, &countBuffers_[i].mapped_);
+    memset(countBuffers_[i].mapped_, 0, count_size);
+  }
+}
+
+void vkdev::GPUCulling::createDepthPyramid(VkTexture* depth)
+{
+  pyramid_.device_ = context_->logDevice_;
+  pyramid_.width_ = depth->width_;
+  pyramid_.height_ = depth->height_;
+  pyramid_.mipLevels_ = static_cast<uint32>(floor(log2(std::max(depth->width_, depth->height_)))) + 1;
+  pyramid_.createImage(context_->physDevice_, VK_FORMAT_R32_SFLOAT,
+                       VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, 1, 0);
+  pyramid_.view_ = dev::StaticHelpers::createTextureImageView(context_->logDevice_, pyramid_.image_, VK_FORMAT_R32_SFLOAT,
+                                                              VK_IMAGE_VIEW_TYPE_2D, pyramid_.mipLevels_, 1,
+                                                              VK_IMAGE_ASPECT_COLOR_BIT);
+
+  pyramidViews_.resize(pyramid_.mipLevels_);
+  for (uint32 i = 0; i < pyramid_.mipLevels_; i++) {
+    VkImageViewCreateInfo view_info{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    view_info.image = pyramid_.image_;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = VK_FORMAT_R32_SFLOAT;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.baseMipLevel = i;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+    assert(vkCreateImageView(context_->logDevice_, &view_info, nullptr, &pyramidViews_[i]) == VK_SUCCESS);
+  }
+
+  //Depth values have to be read as they are, no filtering between texels
+  VkSamplerCreateInfo sampler_info{ VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+  sampler_info.magFilter = VK_FILTER_NEAREST;
+  sampler_info.minFilter = VK_FILTER_NEAREST;
+  sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.minLod = 0.0f;
+  sampler_info.maxLod = static_cast<float>(pyramid_.mipLevels_);
+  assert(vkCreateSampler(context_->logDevice_, &sampler_info, nullptr, &pyramid_.sampler_) == VK_SUCCESS);
+
+  //Kept in general layout, it is written as storage image and sampled by the cull pass
+  VkImageSubresourceRange subresource_range{};
+  subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  subresource_range.baseMipLevel = 0;
+  subresource_range.levelCount = pyramid_.mipLevels_;
+  subresource_range.layerCount = 1;
+
+  VkCommandBuffer cmd_buffer = dev::StaticHelpers::beginSingleTimeCommands(context_);
+  pyramid_.setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresource_range);
+  dev::StaticHelpers::endSingleTimeCommands(context_, cmd_buffer);
+  pyramid_.layout_ = VK_IMAGE_LAYOUT_GENERAL;
+}
+
+void vkdev::GPUCulling::createPipelines()
+{
+  std::vector<VkDescriptorSetLayoutBinding> cull_bindings = {
+    dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+    dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+    dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+    dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+    dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 4)
+  };
+  VkDescriptorSetLayoutCreateInfo cull_set_info = dev::StaticHelpers::setLayoutCreateInfoInitializer(cull_bindings);
+  assert(vkCreateDescriptorSetLayout(context_->logDevice_, &cull_set_info, nullptr, &cullSetLayout_) == VK_SUCCESS);
+
+  std::vector<VkDescriptorSetLayoutBinding> pyramid_bindings = {
+    dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+    dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1)
+  };
+  VkDescriptorSetLayoutCreateInfo pyramid_set_info = dev::StaticHelpers::setLayoutCreateInfoInitializer(pyramid_bindings);
+  assert(vkCreateDescriptorSetLayout(context_->logDevice_, &pyramid_set_info, nullptr, &pyramidSetLayout_) == VK_SUCCESS);
+
+  VkPipelineLayoutCreateInfo layout_info{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+  layout_info.setLayoutCount = 1;
+  layout_info.pSetLayouts = &cullSetLayout_;
+  assert(vkCreatePipelineLayout(context_->logDevice_, &layout_info, nullptr, &cullLayout_) == VK_SUCCESS);
+
+  //Source and destination size of the level being reduced
+  VkPushConstantRange push_range{};
+  push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_range.offset = 0;
+  push_range.size = sizeof(glm::ivec4);
+
+  layout_info.pSetLayouts = &pyramidSetLayout_;
+  layout_info.pushConstantRangeCount = 1;
+  layout_info.pPushConstantRanges = &push_range;
+  assert(vkCreatePipelineLayout(context_->logDevice_, &layout_info, nullptr, &pyramidLayout_) == VK_SUCCESS);
+
+  cullPipeline_ = dev::StaticHelpers::createComputePipeline(context_,
+                                                            "./../../src/shaders/spir-v/cull_comp.spv",
+                                                            cullLayout_);
+  pyramidPipeline_ = dev::StaticHelpers::createComputePipeline(context_,
+                                                               "./../../src/shaders/spir-v/depth_pyramid_comp.spv",
+                                                               pyramidLayout_);
+}
+
+void vkdev::GPUCulling::createDescriptorSets(VkTexture* depth)
+{
+  uint32 image_count = static_cast<uint32>(objectBuffers_.size());
+  uint32 levels = pyramid_.mipLevels_;
+
+  std::array<VkDescriptorPoolSize, 4> pool_sizes{};
+  pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  pool_sizes[0].descriptorCount = image_count;
+  pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  pool_sizes[1].descriptorCount = 3 * image_count;
+  pool_sizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  pool_sizes[2].descriptorCount = image_count + levels;
+  pool_sizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  pool_sizes[3].descriptorCount = levels;
+
+  VkDescriptorPoolCreateInfo pool_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+  pool_info.poolSizeCount = static_cast<uint32>(pool_sizes.size());
+  pool_info.pPoolSizes = pool_sizes.data();
+  pool_info.maxSets = image_count + levels;
+  assert(vkCreateDescriptorPool(context_->logDevice_, &pool_info, nullptr, &descriptorPool_) == VK_SUCCESS);
+
+  std::vector<VkDescriptorSetLayout> cull_layouts(image_count, cullSetLayout_);
+  VkDescriptorSetAllocateInfo alloc_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+  alloc_info.descriptorPool = descriptorPool_;
+  alloc_info.descriptorSetCount = image_count;
+  alloc_info.pSetLayouts = cull_layouts.data();
+  cullSets_.resize(image_count);
+  assert(vkAllocateDescriptorSets(context_->logDevice_, &alloc_info, cullSets_.data()) == VK_SUCCESS);
+
+  std::vector<VkDescriptorSetLayout> pyramid_layouts(levels, pyramidSetLayout_);
+  alloc_info.descriptorSetCount = levels;
+  alloc_info.pSetLayouts = pyramid_layouts.data();
+  pyramidSets_.resize(levels);
+  assert(vkAllocateDescriptorSets(context_->logDevice_, &alloc_info, pyramidSets_.data()) == VK_SUCCESS);
+
+  VkDescriptorImageInfo pyramid_info{ pyramid_.sampler_, pyramid_.view_, VK_IMAGE_LAYOUT_GENERAL };
+  for (uint32 i = 0; i < image_count; i++) {
+    VkDescriptorBufferInfo uniform_info{ cullUniforms_[i].buffer_, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo object_info{ objectBuffers_[i].buffer_, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo command_info{ indirectBuffers_[i].buffer_, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo count_info{ countBuffers_[i].buffer_, 0, VK_WHOLE_SIZE };
+
+    std::array<VkWriteDescriptorSet, 5> writes = {
+      dev::StaticHelpers::descriptorWriteInitializer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, cullSets_[i], &uniform_info),
+      dev::StaticHelpers::descriptorWriteInitializer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, cullSets_[i], &object_info),
+      dev::StaticHelpers::descriptorWriteInitializer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, cullSets_[i], &command_info),
+      dev::StaticHelpers::descriptorWriteInitializer(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, cullSets_[i], &count_info),
+      dev::StaticHelpers::descriptorWriteInitializer(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, cullSets_[i], &pyramid_info)
+    };
+    vkUpdateDescriptorSets(context_->logDevice_, static_cast<uint32>(writes.size()), writes.data(), 0, nullptr);
+  }
+
+  //Level 0 reads the depth attachment, the rest the previous level
+  for (uint32 i = 0; i < levels; i++) {
+    VkDescriptorImageInfo source_info{};
+    source_info.sampler = pyramid_.sampler_;
+    source_info.imageView = i ? pyramidViews_[i - 1] : depth->view_;
+    source_info.imageLayout = i ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    VkDescriptorImageInfo destination_info{ VK_NULL_HANDLE, pyramidViews_[i], VK_IMAGE_LAYOUT_GENERAL };
+
+    std::array<VkWriteDescriptorSet, 2> writes = {
+      dev::StaticHelpers::descriptorWriteInitializer(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pyramidSets_[i], &source_info),
+      dev::StaticHelpers::descriptorWriteInitializer(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, pyramidSets_[i], &destination_info)
+    };
+    vkUpdateDescriptorSets(context_->logDevice_, static_cast<uint32>(writes.size()), writes.data(), 0, nullptr);
+  }
+}
+
+void vkdev::GPUCulling::destroy()
+{
+  if (!context_) return;
+  VkDevice device = context_->logDevice_;
+
+  vkDestroyPipeline(device, cullPipeline_, nullptr);
+  vkDestroyPipeline(device, pyramidPipeline_, nullptr);
+  vkDestroyPipelineLayout(device, cullLayout_, nullptr);
+  vkDestroyPipelineLayout(device, pyramidLayout_, nullptr);
+  vkDestroyDescriptorPool(device, descriptorPool_, nullptr);
+  vkDestroyDescriptorSetLayout(device, cullSetLayout_, nullptr);
+  vkDestroyDescriptorSetLayout(device, pyramidSetLayout_, nullptr);
+
+  for (auto view : pyramidViews_) {
+    vkDestroyImageView(device, view, nullptr);
+  }
+  pyramidViews_.clear();
+  pyramid_.destroyTexture();
+
+  for (uint32 i = 0; i < objectBuffers_.size(); i++) {
+    objectBuffers_[i].destroyBuffer();
+    cullUniforms_[i].destroyBuffer();
+    indirectBuffers_[i].destroyBuffer();
+    countBuffers_[i].destroyBuffer();
+  }
+  context_ = nullptr;
+}
+
+/*******************************************************************************/
+
+GPUObject* vkdev::GPUCulling::getObjects(uint32 index)
+{
+  return (GPUObject*)objectBuffers_[index].mapped_;
+}
+
+void vkdev::GPUCulling::update(uint32 index, uint32 object_count, const glm::vec4* planes, const glm::mat4& view_projection,
+                               const glm::vec2& pyramid_scale)
+{
+  objectCounts_[index] = object_count;
+
+  CullUniform* cull_data = (CullUniform*)cullUniforms_[index].mapped_;
+  for (uint32 i = 0; i < 6; i++) {
+    cull_data->planes[i] = planes[i];
+  }
+  cull_data->viewProjection = view_projection;
+  cull_data->pyramidSize = glm::vec4(pyramid_.width_, pyramid_.height_, pyramid_.mipLevels_, 0.0f);
+  cull_data->pyramidScale = pyramid_scale;
+  cull_data->objectCount = object_count;
+  cull_data->compact = compact_;
+  cull_data->occlusion = pyramidReady_;
+  cull_data->drawsPerMaterial = kMaxInstance;
+}
+
+CullingStats vkdev::GPUCulling::getStats(uint32 index)
+{
+  //Counts written by the last submission of this image, its fence has been waited
+  const uint32* counts = (const uint32*)countBuffers_[index].mapped_;
+  CullingStats stats{};
+  for (uint32 i = 0; i < (uint32)MaterialType::kMaterialType_MAX; i++) {
+    stats.visible += counts[i];
+  }
+  stats.culled = objectCounts_[index] - std::min(stats.visible, objectCounts_[index]);
+
+  return stats;
+}
+
+/*******************************************************************************/
+
+void vkdev::GPUCulling::cull(VkCommandBuffer cmd_buffer, uint32 index)
+{
+  vkCmdFillBuffer(cmd_buffer, countBuffers_[index].buffer_, 0, VK_WHOLE_SIZE, 0);
+  //Without the count draw every object keeps its slot, culled ones get instanceCount 0
+  if (!compact_) {
+    vkCmdFillBuffer(cmd_buffer, indirectBuffers_[index].buffer_, 0, VK_WHOLE_SIZE, 0);
+  }
+
+  VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline_);
+  vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullLayout_, 0, 1, &cullSets_[index], 0, nullptr);
+  vkCmdDispatch(cmd_buffer, (objectCounts_[index] + kCullGroupSize - 1) / kCullGroupSize, 1, 1);
+
+  //Counts are read back by getStats once the fence of this image is signaled
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void vkdev::GPUCulling::drawIndirect(VkCommandBuffer cmd_buffer, uint32 index, uint32 material_type, uint32 max_draws)
+{
+  uint32 stride = sizeof(VkDrawIndexedIndirectCommand);
+  VkDeviceSize offset = (VkDeviceSize)material_type * kMaxInstance * stride;
+  if (compact_) {
+    drawIndexedIndirectCount_(cmd_buffer, indirectBuffers_[index].buffer_, offset,
+                              countBuffers_[index].buffer_, material_type * sizeof(uint32), max_draws, stride);
+  }
+  else {
+    vkCmdDrawIndexedIndirect(cmd_buffer, indirectBuffers_[index].buffer_, offset, max_draws, stride);
+  }
+}
+
+void vkdev::GPUCulling::buildDepthPyramid(VkCommandBuffer cmd_buffer)
+{
+  //Depth in DEPTH_STENCIL_READ_ONLY and the pyramid free of the cull pass reads, both waited by the graph
+  VkMemoryBarrier pyramid_barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+  vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipeline_);
+
+  glm::ivec2 source_size = glm::ivec2(pyramid_.width_, pyramid_.height_);
+  for (uint32 i = 0; i < pyramid_.mipLevels_; i++) {
+    glm::ivec2 level_size = glm::ivec2(std::max(pyramid_.width_ >> i, 1u), std::max(pyramid_.height_ >> i, 1u));
+    glm::ivec4 sizes = glm::ivec4(source_size, level_size);
+
+    vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidLayout_, 0, 1, &pyramidSets_[i], 0, nullptr);
+    vkCmdPushConstants(cmd_buffer, pyramidLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(glm::ivec4), &sizes);
+    vkCmdDispatch(cmd_buffer, (level_size.x + kPyramidGroupSize - 1) / kPyramidGroupSize,
+                  (level_size.y + kPyramidGroupSize - 1) / kPyramidGroupSize, 1);
+
+    //Next level reads what has just been written
+    pyramid_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    pyramid_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &pyramid_barrier, 0, nullptr, 0, nullptr);
+    source_size = level_size;
+  }
+
+  pyramidReady_ = true;
+}
+
+VkImage vkdev::GPUCulling::getPyramidImage()
+{
+  return pyramid_.image_;
+}
+
+uint32 vkdev::GPUCulling::getPyramidLevels()
+{
+  return pyramid_.mipLevels_;
+}
+
+VkBuffer vkdev::GPUCulling::getIndirectBuffer(uint32 index)
+{
+  return indirectBuffers_[index].buffer_;
+}
+
+VkBuffer vkdev::GPUCulling::getCountBuffer(uint32 index)
+{
+  return countBuffers_[index].buffer_;
+}
@@ -0,0 +1,102 @@
+#ifndef __VKDEV_GPU_CULLING__
+#define __VKDEV_GPU_CULLING__ 1
+
+#include "glm/glm.hpp"
+#include "common_def.h"
+#include "draw_cmd.h"
+#include "dev/buffer.h"
+#include "dev/vktexture.h"
+
+const uint32 kCullGroupSize = 64;
+const uint32 kPyramidGroupSize = 8;
+const uint32 kObjectFlag_AlwaysVisible = 1;
+
+//Same layout as ObjectBounds in cull.comp
+struct GPUObject {
+  //World space bounding sphere
+  glm::vec4 sphere;
+  uint32 materialType;
+  uint32 firstInstance;
+  uint32 firstIndex;
+  uint32 indexCount;
+  int32 vertexOffset;
+  uint32 flags;
+  uint32 padding[2];
+};
+
+//Same layout as CullUniform in cull.comp
+struct CullUniform {
+  glm::vec4 planes[6];
+  glm::mat4 viewProjection;
+  //x: width, y: height, z: levels of the depth pyramid
+  glm::vec4 pyramidSize;
+  //Scaled region of the depth attachment it was built from
+  glm::vec2 pyramidScale;
+  uint32 objectCount;
+  uint32 compact;
+  uint32 occlusion;
+  uint32 drawsPerMaterial;
+};
+
+struct Context;
+namespace vkdev {
+  //Frustum and Hi-Z occlusion culling in a compute pass, writes the indirect draws of every material.
+  //The depth pyramid is built from the depth attachment of the previous frame.
+  //Barriers against the passes around them come from the frame render graph
+  class GPUCulling {
+  public:
+    GPUCulling();
+    ~GPUCulling(){}
+
+    void create(Context* context, VkTexture* depth, uint32 image_count);
+    void destroy();
+
+    GPUObject* getObjects(uint32 index);
+    void update(uint32 index, uint32 object_count, const glm::vec4* planes, const glm::mat4& view_projection,
+                const glm::vec2& pyramid_scale);
+    CullingStats getStats(uint32 index);
+
+    void cull(VkCommandBuffer cmd_buffer, uint32 index);
+    void drawIndirect(VkCommandBuffer cmd_buffer, uint32 index, uint32 material_type, uint32 max_draws);
+    void buildDepthPyramid(VkCommandBuffer cmd_buffer);
+
+    VkImage getPyramidImage();
+    uint32 getPyramidLevels();
+    VkBuffer getIndirectBuffer(uint32 index);
+    VkBuffer getCountBuffer(uint32 index);
+
+  private:
+    GPUCulling(const GPUCulling&);
+    void createBuffers(uint32 image_count);
+    void createDepthPyramid(VkTexture* depth);
+    void createPipelines();
+    void createDescriptorSets(VkTexture* depth);
+
+    Context* context_;
+    bool compact_;
+    bool pyramidReady_;
+
+    VkTexture pyramid_;
+    std::vector<VkImageView> pyramidViews_;
+
+    std::vector<Buffer> objectBuffers_;
+    std::vector<Buffer> cullUniforms_;
+    std::vector<Buffer> indirectBuffers_;
+    std::vector<Buffer> countBuffers_;
+    std::vector<uint32> objectCounts_;
+
+    VkDescriptorSetLayout cullSetLayout_;
+    VkDescriptorSetLayout pyramidSetLayout_;
+    VkPipelineLayout cullLayout_;
+    VkPipelineLayout pyramidLayout_;
+    VkPipeline cullPipeline_;
+    VkPipeline pyramidPipeline_;
+    VkDescriptorPool descriptorPool_;
+    std::vector<VkDescriptorSet> cullSets_;
+    std::vector<VkDescriptorSet> pyramidSets_;
+
+    PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount_;
+  };
+}
+
+#endif
@@ -0,0 +1,279 @@
+#include "dev/gpu_profiler.h"
+#include "dev/static_helpers.h"
+#include "internal.h"
+#include <algorithm>
+
+
+vkdev::GPUProfiler::GPUProfiler()
+{
+  context_ = nullptr;
+  statistics_ = false;
+  timestampPeriod_ = 1.0f;
+  timestampMask_ = ~0ull;
+  current_ = 0;
+  open_ = false;
+  frameCount_ = 0;
+  csvCreated_ = false;
+  frameMs_ = 0.0f;
+}
+
+bool vkdev::GPUProfiler::isSupported(VkPhysicalDevice physical_device, uint32 queue_family)
+{
+  uint32 family_count;
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+  std::vector<VkQueueFamilyProperties> families(family_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+  return queue_family < family_count && families[queue_family].timestampValidBits > 0;
+}
+
+void vkdev::GPUProfiler::create(Context* context, uint32 frame_count)
+{
+  if (!context->caps.gpuProfiler) return;
+  context_ = context;
+  statistics_ = context->caps.pipelineStatistics;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(context->physDevice_, &properties);
+  timestampPeriod_ = properties.limits.timestampPeriod;
+
+  QueueFamilyIndices indices = dev::StaticHelpers::findQueueFamilies(context->physDevice_, context->surface);
+  uint32 family_count;
+  vkGetPhysicalDeviceQueueFamilyProperties(context->physDevice_, &family_count, nullptr);
+  std::vector<VkQueueFamilyProperties> families(family_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(context->physDevice_, &family_count, families.data());
+  uint32 valid_bits = families[indices.graphicsFamily].timestampValidBits;
+  timestampMask_ = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+  //One more slot for the single time command buffers
+  frames_.resize(frame_count + 1);
+  for (FrameQueries& frame : frames_) {
+    VkQueryPoolCreateInfo pool_info{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    pool_info.queryCount = kMaxProfileScopes * 2;
+    assert(vkCreateQueryPool(context->logDevice_, &pool_info, nullptr, &frame.timestamps) == VK_SUCCESS);
+
+    frame.statistics = VK_NULL_HANDLE;
+    if (statistics_) {
+      pool_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+      pool_info.queryCount = kMaxProfileScopes;
+      pool_info.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                     VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                     VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+                                     VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+      assert(vkCreateQueryPool(context->logDevice_, &pool_info, nullptr, &frame.statistics) == VK_SUCCESS);
+    }
+  }
+}
+
+void vkdev::GPUProfiler::destroy()
+{
+  if (!context_) return;
+  for (FrameQueries& frame : frames_) {
+    vkDestroyQueryPool(context_->logDevice_, frame.timestamps, nullptr);
+    if (frame.statistics != VK_NULL_HANDLE) vkDestroyQueryPool(context_->logDevice_, frame.statistics, nullptr);
+  }
+
+  frames_.clear();
+  history_.clear();
+  scopeIndex_.clear();
+  context_ = nullptr;
+}
+
+bool vkdev::GPUProfiler::isEnabled()
+{
+  return context_ != nullptr;
+}
+
+
+/*******************************************************************************/
+
+void vkdev::GPUProfiler::beginFrame(VkCommandBuffer cmd_buffer, uint32 frame)
+{
+  if (!context_) return;
+  collect(frame);
+
+  current_ = frame;
+  vkCmdResetQueryPool(cmd_buffer, frames_[frame].timestamps, 0, kMaxProfileScopes * 2);
+  if (statistics_) vkCmdResetQueryPool(cmd_buffer, frames_[frame].statistics, 0, kMaxProfileScopes);
+}
+
+void vkdev::GPUProfiler::beginScope(VkCommandBuffer cmd_buffer, const char* name)
+{
+  if (!context_) return;
+  FrameQueries* frame = &frames_[current_];
+  assert(!open_);
+  if (frame->scopes.size() >= kMaxProfileScopes) return;
+
+  auto found = scopeIndex_.find(name);
+  uint32 scope;
+  if (found == scopeIndex_.end()) {
+    scope = static_cast<uint32>(history_.size());
+    scopeIndex_[name] = scope;
+    history_.push_back({ name, {}, 0, {}, 0 });
+  }
+  else {
+    scope = found->second;
+  }
+
+  uint32 query = static_cast<uint32>(frame->scopes.size());
+  frame->scopes.push_back(scope);
+  open_ = true;
+
+  vkCmdWriteTimestamp(cmd_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame->timestamps, query * 2);
+  if (statistics_) vkCmdBeginQuery(cmd_buffer, frame->statistics, query, 0);
+}
+
+void vkdev::GPUProfiler::endScope(VkCommandBuffer cmd_buffer)
+{
+  if (!context_ || !open_) return;
+  FrameQueries* frame = &frames_[current_];
+  uint32 query = static_cast<uint32>(frame->scopes.size() - 1);
+  open_ = false;
+
+  if (statistics_) vkCmdEndQuery(cmd_buffer, frame->statistics, query);
+  vkCmdWriteTimestamp(cmd_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame->timestamps, query * 2 + 1);
+}
+
+void vkdev::GPUProfiler::collect(uint32 frame)
+{
+  if (!context_) return;
+  FrameQueries* queries = &frames_[frame];
+  uint32 count = static_cast<uint32>(queries->scopes.size());
+  if (count == 0) return;
+
+  //The submission of this slot is done, nothing to wait for
+  uint64_t timestamps[kMaxProfileScopes * 2];
+  VkResult result = vkGetQueryPoolResults(context_->logDevice_, queries->timestamps, 0, count * 2,
+                                          sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  PipelineStats stats[kMaxProfileScopes];
+  bool has_stats = statistics_ &&
+                   vkGetQueryPoolResults(context_->logDevice_, queries->statistics, 0, count, sizeof(stats), stats,
+                                         sizeof(PipelineStats), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+
+  if (result == VK_SUCCESS) {
+    //Single time command buffers are not frames
+    if (frame + 1 < frames_.size()) {
+      uint64_t ticks = (timestamps[count * 2 - 1] - timestamps[0]) & timestampMask_;
+      frameMs_ = static_cast<float>(ticks * static_cast<double>(timestampPeriod_) / 1000000.0);
+    }
+    for (uint32 i = 0; i < count; i++) {
+      ScopeHistory* history = &history_[queries->scopes[i]];
+      uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask_;
+      float ms = static_cast<float>(ticks * static_cast<double>(timestampPeriod_) / 1000000.0);
+
+      if (history->samples.size() < kProfileHistory) {
+        history->samples.push_back(ms);
+      }
+      else {
+        history->samples[history->next] = ms;
+        history->next = (history->next + 1) % kProfileHistory;
+      }
+
+      if (has_stats) {
+        history->total.vertexInvocations += stats[i].vertexInvocations;
+        history->total.clippingPrimitives += stats[i].clippingPrimitives;
+        history->total.fragmentInvocations += stats[i].fragmentInvocations;
+        history->total.computeInvocations += stats[i].computeInvocations;
+        ++history->statSamples;
+      }
+    }
+  }
+
+  queries->scopes.clear();
+}
+
+void vkdev::GPUProfiler::beginImmediate(VkCommandBuffer cmd_buffer, const char* name)
+{
+  if (!context_) return;
+  beginFrame(cmd_buffer, static_cast<uint32>(frames_.size() - 1));
+  beginScope(cmd_buffer, name);
+}
+
+void vkdev::GPUProfiler::collectImmediate()
+{
+  if (!context_) return;
+  collect(static_cast<uint32>(frames_.size() - 1));
+}
+
+
+/*******************************************************************************/
+
+std::vector<ProfileScope> vkdev::GPUProfiler::getScopes()
+{
+  std::vector<ProfileScope> scopes;
+  std::vector<float> sorted;
+  for (ScopeHistory& history : history_) {
+    if (history.samples.empty()) continue;
+
+    ProfileScope scope{};
+    scope.name = history.name;
+    scope.samples = static_cast<uint32>(history.samples.size());
+
+    sorted = history.samples;
+    std::sort(sorted.begin(), sorted.end());
+    float sum = 0.0f;
+    for (float sample : sorted) {
+      sum += sample;
+    }
+    scope.minMs = sorted.front();
+    scope.avgMs = sum / sorted.size();
+    scope.p99Ms = sorted[(sorted.size() * 99 + 99) / 100 - 1];
+
+    if (history.statSamples > 0) {
+      scope.stats.vertexInvocations = history.total.vertexInvocations / history.statSamples;
+      scope.stats.clippingPrimitives = history.total.clippingPrimitives / history.statSamples;
+      scope.stats.fragmentInvocations = history.total.fragmentInvocations / history.statSamples;
+      scope.stats.computeInvocations = history.total.computeInvocations / history.statSamples;
+    }
+    scopes.push_back(scope);
+  }
+
+  return scopes;
+}
+
+float vkdev::GPUProfiler::getFrameTime()
+{
+  return frameMs_;
+}
+
+void vkdev::GPUProfiler::update()
+{
+  if (!context_ || kProfileLogFrames == 0) return;
+  if (++frameCount_ % kProfileLogFrames != 0) return;
+
+  log();
+  writeCsv(kProfileCsvPath);
+}
+
+void vkdev::GPUProfiler::log()
+{
+  std::vector<ProfileScope> scopes = getScopes();
+  printf("\nGPU profile, frame %u\n", frameCount_);
+  for (ProfileScope& scope : scopes) {
+    printf("  %-24s min: %7.3f ms  avg: %7.3f ms  p99: %7.3f ms  vs: %9llu  prims: %9llu  fs: %10llu  cs: %9llu\n",
+           scope.name.c_str(), scope.minMs, scope.avgMs, scope.p99Ms,
+           (unsigned long long)scope.stats.vertexInvocations, (unsigned long long)scope.stats.clippingPrimitives,
+           (unsigned long long)scope.stats.fragmentInvocations, (unsigned long long)scope.stats.computeInvocations);
+  }
+}
+
+void vkdev::GPUProfiler::writeCsv(const char* path)
+{
+  //Rewritten on the first report of the run, appended afterwards
+  FILE* file = fopen(path, csvCreated_ ? "a" : "w");
+  if (!file) return;
+  if (!csvCreated_) {
+    fprintf(file, "frame,scope,samples,min_ms,avg_ms,p99_ms,vs_invocations,clipping_primitives,fs_invocations,cs_invocations\n");
+    csvCreated_ = true;
+  }
+
+  std::vector<ProfileScope> scopes = getScopes();
+  for (ProfileScope& scope : scopes) {
+    fprintf(file, "%u,%s,%u,%.4f,%.4f,%.4f,%llu,%llu,%llu,%llu\n", frameCount_, scope.name.c_str(), scope.samples,
+            scope.minMs, scope.avgMs, scope.p99Ms,
+            (unsigned long long)scope.stats.vertexInvocations, (unsigned long long)scope.stats.clippingPrimitives,
+            (unsigned long long)scope.stats.fragmentInvocations, (unsigned long long)scope.stats.computeInvocations);
+  }
+  fclose(file);
+}
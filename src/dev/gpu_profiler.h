@@ -0,0 +1,99 @@
+#ifndef __VKDEV_GPU_PROFILER__
+#define __VKDEV_GPU_PROFILER__ 1
+
+#include "vulkan/vulkan.h"
+#include "common_def.h"
+#include <string>
+#include <map>
+
+const uint32 kMaxProfileScopes = 64;
+//Samples kept per scope for the min/avg/p99
+const uint32 kProfileHistory = 256;
+//Frames between two reports, 0 disables them
+const uint32 kProfileLogFrames = 600;
+const char* const kProfileCsvPath = "gpu_profile.csv";
+
+//Same order as the statistics the query pool is created with
+struct PipelineStats {
+  uint64_t vertexInvocations;
+  uint64_t clippingPrimitives;
+  uint64_t fragmentInvocations;
+  uint64_t computeInvocations;
+};
+
+struct ProfileScope {
+  std::string name;
+  uint32 samples;
+  float minMs;
+  float avgMs;
+  float p99Ms;
+  //Average over the samples
+  PipelineStats stats;
+};
+
+struct Context;
+namespace vkdev {
+  //Timestamps and pipeline statistics around named scopes. Every frame slot has its own query pools,
+  //they are read when the slot comes back, after its fence, so reading never stalls.
+  //Scopes don't nest, the statistics query of a scope must end before the next begins
+  class GPUProfiler {
+  public:
+    GPUProfiler();
+    ~GPUProfiler(){}
+
+    static bool isSupported(VkPhysicalDevice physical_device, uint32 queue_family);
+
+    void create(Context* context, uint32 frame_count);
+    void destroy();
+    bool isEnabled();
+
+    //Collects the scopes last recorded in this slot and resets its queries
+    void beginFrame(VkCommandBuffer cmd_buffer, uint32 frame);
+    void beginScope(VkCommandBuffer cmd_buffer, const char* name);
+    void endScope(VkCommandBuffer cmd_buffer);
+    void collect(uint32 frame);
+
+    //Single time command buffers, collected once the queue is idle
+    void beginImmediate(VkCommandBuffer cmd_buffer, const char* name);
+    void collectImmediate();
+
+    std::vector<ProfileScope> getScopes();
+    //First to last timestamp of the last frame collected, 0 before any
+    float getFrameTime();
+    //Counts frames, prints and writes the csv every kProfileLogFrames
+    void update();
+    void log();
+    void writeCsv(const char* path);
+
+  private:
+    GPUProfiler(const GPUProfiler&);
+    struct FrameQueries {
+      VkQueryPool timestamps;
+      VkQueryPool statistics;
+      std::vector<uint32> scopes;
+    };
+    struct ScopeHistory {
+      std::string name;
+      std::vector<float> samples;
+      uint32 next;
+      PipelineStats total;
+      uint64_t statSamples;
+    };
+
+    Context* context_;
+    bool statistics_;
+    float timestampPeriod_;
+    uint64_t timestampMask_;
+    uint32 current_;
+    bool open_;
+    uint32 frameCount_;
+    bool csvCreated_;
+    float frameMs_;
+
+    std::vector<FrameQueries> frames_;
+    std::vector<ScopeHistory> history_;
+    std::map<std::string, uint32> scopeIndex_;
+  };
+}
+
+#endif
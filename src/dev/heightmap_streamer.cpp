@@ -0,0 +1,399 @@
+#include "dev/heightmap_streamer.h"
+#include "internal.h"
+#include "static_helpers.h"
+#include "perlin_noise.h"
+#include "dev/noise_generator.h"
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+const uint32 kInvalidTile = 0xFFFFFFFF;
+
+
+vkdev::HeightmapStreamer::HeightmapStreamer()
+{
+  context_ = nullptr;
+  header_ = {};
+  streaming_ = false;
+  tileSamples_ = 1;
+  tileBytes_ = 0;
+  cameraTile_ = glm::ivec2(0);
+  frame_ = 0;
+  exit_ = false;
+}
+
+bool vkdev::HeightmapStreamer::writeTiles(const char* path, const uint16* samples, uint32 width, uint32 height, uint32 tile_cells)
+{
+  if (width < 2 || height < 2 || !tile_cells) return false;
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file) return false;
+
+  HeightmapHeader header{};
+  header.magic = kHeightmapMagic;
+  header.version = kHeightmapVersion;
+  header.tileCells = tile_cells;
+  header.tilesX = (width - 2) / tile_cells + 1;
+  header.tilesY = (height - 2) / tile_cells + 1;
+  file.write((const char*)&header, sizeof(header));
+
+  //Samples past the heightfield repeat its last row and column
+  uint32 side = tile_cells + 1;
+  std::vector<uint16> tile(side * side);
+  for (uint32 ty = 0; ty < header.tilesY; ty++) {
+    for (uint32 tx = 0; tx < header.tilesX; tx++) {
+      for (uint32 i = 0; i < side; i++) {
+        uint32 y = std::min(ty * tile_cells + i, height - 1);
+        for (uint32 j = 0; j < side; j++) {
+          uint32 x = std::min(tx * tile_cells + j, width - 1);
+          tile[i * side + j] = samples[(size_t)y * width + x];
+        }
+      }
+      file.write((const char*)tile.data(), tile.size() * sizeof(uint16));
+    }
+  }
+
+  return file.good();
+}
+
+bool vkdev::HeightmapStreamer::writeNoiseTiles(const char* path, uint32 size, uint32 tile_cells)
+{
+  PerlinNoise perlin_noise(kNoiseSeed);
+  FractalNoise fractal(perlin_noise);
+
+  //Same scale and period as updateNoiseTexture, only more samples per lattice cell
+  std::vector<float> values((size_t)size * size);
+  fractal.noiseImage(size, size, static_cast<float>(kNoiseScale), kNoiseScale, values.data());
+  std::vector<uint16> samples(values.size());
+  for (size_t i = 0; i < values.size(); i++) {
+    float n = values[i] - floor(values[i]);
+    samples[i] = static_cast<uint16>(floor(n * 65535.0f));
+  }
+
+  return writeTiles(path, samples.data(), size, size, tile_cells);
+}
+
+bool vkdev::HeightmapStreamer::openFile(const char* path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+
+  file.read((char*)&header_, sizeof(header_));
+  if (!file || header_.magic != kHeightmapMagic || header_.version != kHeightmapVersion ||
+      !header_.tileCells || !header_.tilesX || !header_.tilesY) {
+    header_ = {};
+    return false;
+  }
+
+  path_ = path;
+  return true;
+}
+
+void vkdev::HeightmapStreamer::create(Context* context, const char* path, uint32 image_count)
+{
+  context_ = context;
+  streaming_ = openFile(path);
+  tileSamples_ = streaming_ ? header_.tileCells + 1 : 1;
+  tileBytes_ = (VkDeviceSize)tileSamples_ * tileSamples_ * sizeof(uint16);
+
+  createResources(image_count);
+
+  if (streaming_) {
+    layerTile_.assign(kHeightmapResidentTiles, kInvalidTile);
+    layerUsed_.assign(kHeightmapResidentTiles, 0);
+    exit_ = false;
+    loader_ = std::thread(&HeightmapStreamer::loadTiles, this);
+  }
+}
+
+void vkdev::HeightmapStreamer::createResources(uint32 image_count)
+{
+  //A single texel layer keeps the descriptors valid when there is nothing to stream
+  uint32 layers = streaming_ ? kHeightmapResidentTiles : 1;
+  tiles_.device_ = context_->logDevice_;
+  tiles_.width_ = tileSamples_;
+  tiles_.height_ = tileSamples_;
+  tiles_.mipLevels_ = 1;
+  tiles_.layerCount_ = layers;
+  tiles_.createImage(context_->physDevice_, VK_FORMAT_R16_UNORM,
+                     VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, layers, 0);
+  tiles_.view_ = dev::StaticHelpers::createTextureImageView(context_->logDevice_, tiles_.image_, VK_FORMAT_R16_UNORM,
+                                                            VK_IMAGE_VIEW_TYPE_2D_ARRAY, 1, layers,
+                                                            VK_IMAGE_ASPECT_COLOR_BIT);
+  tiles_.sampler_ = dev::StaticHelpers::createTextureSampler(context_, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                                                             VK_COMPARE_OP_NEVER, 0,
+                                                             VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE, VK_FALSE);
+  tiles_.layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  tiles_.descriptor_ = { tiles_.sampler_, tiles_.view_, tiles_.layout_ };
+
+  VkImageSubresourceRange subresource_range{};
+  subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  subresource_range.baseMipLevel = 0;
+  subresource_range.levelCount = 1;
+  subresource_range.layerCount = layers;
+
+  VkCommandBuffer cmd_buffer = dev::StaticHelpers::beginSingleTimeCommands(context_);
+  tiles_.setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_UNDEFINED, tiles_.layout_, subresource_range);
+  dev::StaticHelpers::endSingleTimeCommands(context_, cmd_buffer);
+
+  VkMemoryPropertyFlags host_props = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  VkDeviceSize page_size = sizeof(HeightmapPageHeader) + sizeof(int32) * kHeightmapWindow * kHeightmapWindow;
+  pageTables_.resize(image_count);
+  for (uint32 i = 0; i < image_count; i++) {
+    pageTables_[i].createBuffer(context_, page_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host_props);
+    vkMapMemory(context_->logDevice_, pageTables_[i].memory_, 0, page_size, 0, &pageTables_[i].mapped_);
+
+    HeightmapPageHeader* page_header = (HeightmapPageHeader*)pageTables_[i].mapped_;
+    page_header->window = glm::ivec4(0, 0, kHeightmapWindow, streaming_ ? 1 : 0);
+    page_header->tile = glm::vec4((float)header_.tileCells, 1.0f / (float)tileSamples_, 0.0f, 0.0f);
+    int32* layers_data = (int32*)(page_header + 1);
+    std::fill(layers_data, layers_data + kHeightmapWindow * kHeightmapWindow, -1);
+  }
+
+  if (!streaming_) return;
+
+  staging_.resize(image_count);
+  for (uint32 i = 0; i < image_count; i++) {
+    staging_[i].createBuffer(context_, tileBytes_ * kHeightmapUploadsPerFrame, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, host_props);
+    vkMapMemory(context_->logDevice_, staging_[i].memory_, 0, tileBytes_ * kHeightmapUploadsPerFrame, 0, &staging_[i].mapped_);
+  }
+}
+
+void vkdev::HeightmapStreamer::destroy()
+{
+  if (!context_) return;
+
+  if (loader_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exit_ = true;
+    }
+    condition_.notify_all();
+    loader_.join();
+  }
+  requests_.clear();
+  loaded_.clear();
+  pending_.clear();
+  residentLayer_.clear();
+
+  tiles_.destroyTexture();
+  for (auto& buffer : pageTables_) {
+    buffer.destroyBuffer();
+  }
+  for (auto& buffer : staging_) {
+    buffer.destroyBuffer();
+  }
+  pageTables_.clear();
+  staging_.clear();
+  context_ = nullptr;
+}
+
+/*******************************************************************************/
+
+bool vkdev::HeightmapStreamer::isStreaming()
+{
+  return streaming_;
+}
+
+uint32 vkdev::HeightmapStreamer::getTerrainSize()
+{
+  return std::max(header_.tilesX, header_.tilesY) * header_.tileCells;
+}
+
+VkDescriptorImageInfo* vkdev::HeightmapStreamer::getTilesDescriptor()
+{
+  return &tiles_.descriptor_;
+}
+
+VkBuffer vkdev::HeightmapStreamer::getPageTable(uint32 index)
+{
+  return pageTables_[index].buffer_;
+}
+
+/*******************************************************************************/
+
+void vkdev::HeightmapStreamer::loadTiles()
+{
+  PROFILE_THREAD("heightmap loader");
+  std::ifstream file(path_, std::ios::binary);
+  while (true) {
+    uint32 tile;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return exit_ || !requests_.empty(); });
+      if (exit_) return;
+      tile = requests_.front();
+      requests_.pop_front();
+    }
+
+    PROFILE_ZONE("load heightmap tile");
+    LoadedTile loaded;
+    loaded.tile = tile;
+    loaded.samples.resize(tileSamples_ * tileSamples_);
+    std::streamoff offset = (std::streamoff)sizeof(HeightmapHeader) + (std::streamoff)tile * (std::streamoff)tileBytes_;
+    file.seekg(offset);
+    file.read((char*)loaded.samples.data(), tileBytes_);
+    //Truncated files give flat tiles instead of stalling the request
+    if (!file) {
+      file.clear();
+      std::fill(loaded.samples.begin(), loaded.samples.end(), (uint16)0x7FFF);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    loaded_.push_back(std::move(loaded));
+  }
+}
+
+bool vkdev::HeightmapStreamer::isWanted(uint32 tile)
+{
+  int32 x = (int32)(tile % header_.tilesX) - cameraTile_.x;
+  int32 y = (int32)(tile / header_.tilesX) - cameraTile_.y;
+  return (uint32)std::max(abs(x), abs(y)) <= kHeightmapStreamRadius;
+}
+
+void vkdev::HeightmapStreamer::update(const glm::vec3& camera_position)
+{
+  if (!streaming_) return;
+  ++frame_;
+
+  float cells = (float)header_.tileCells;
+  cameraTile_ = glm::ivec2((int32)floor(camera_position.x / cells), (int32)floor(camera_position.z / cells));
+
+  //Closest tiles are requested first
+  int32 radius = (int32)kHeightmapStreamRadius;
+  std::vector<std::pair<int32, uint32>> missing;
+  for (int32 y = -radius; y <= radius; y++) {
+    for (int32 x = -radius; x <= radius; x++) {
+      int32 tile_x = cameraTile_.x + x;
+      int32 tile_y = cameraTile_.y + y;
+      if (tile_x < 0 || tile_y < 0 || tile_x >= (int32)header_.tilesX || tile_y >= (int32)header_.tilesY) continue;
+
+      uint32 tile = (uint32)tile_y * header_.tilesX + (uint32)tile_x;
+      auto resident = residentLayer_.find(tile);
+      if (resident != residentLayer_.end()) {
+        layerUsed_[resident->second] = frame_;
+      }
+      else if (pending_.find(tile) == pending_.end()) {
+        missing.push_back({ x * x + y * y, tile });
+      }
+    }
+  }
+  std::sort(missing.begin(), missing.end());
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    //Requests the camera moved away from before they were read are dropped
+    for (auto it = requests_.begin(); it != requests_.end();) {
+      if (isWanted(*it)) {
+        ++it;
+        continue;
+      }
+      pending_.erase(*it);
+      it = requests_.erase(it);
+    }
+    for (auto& request : missing) {
+      requests_.push_back(request.second);
+      pending_.insert(request.second);
+    }
+  }
+  if (!missing.empty()) condition_.notify_one();
+}
+
+int32 vkdev::HeightmapStreamer::acquireLayer()
+{
+  int32 oldest = -1;
+  for (uint32 i = 0; i < kHeightmapResidentTiles; i++) {
+    if (layerTile_[i] == kInvalidTile) return (int32)i;
+    //Tiles around the camera this frame are never evicted
+    if (layerUsed_[i] < frame_ && (oldest < 0 || layerUsed_[i] < layerUsed_[oldest])) oldest = (int32)i;
+  }
+
+  if (oldest >= 0) {
+    residentLayer_.erase(layerTile_[oldest]);
+    layerTile_[oldest] = kInvalidTile;
+  }
+  return oldest;
+}
+
+void vkdev::HeightmapStreamer::upload(VkCommandBuffer cmd_buffer, uint32 index)
+{
+  if (!streaming_) return;
+
+  std::vector<LoadedTile> ready;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!loaded_.empty() && ready.size() < kHeightmapUploadsPerFrame) {
+      ready.push_back(std::move(loaded_.front()));
+      loaded_.pop_front();
+    }
+  }
+
+  uint8* staging = (uint8*)staging_[index].mapped_;
+  std::vector<VkBufferImageCopy> copies;
+  std::vector<VkImageMemoryBarrier> barriers;
+  for (auto& loaded : ready) {
+    pending_.erase(loaded.tile);
+    if (!isWanted(loaded.tile)) continue;
+    int32 layer = acquireLayer();
+    if (layer < 0) continue;
+
+    layerTile_[layer] = loaded.tile;
+    layerUsed_[layer] = frame_;
+    residentLayer_[loaded.tile] = (uint32)layer;
+
+    VkDeviceSize offset = tileBytes_ * copies.size();
+    memcpy(staging + offset, loaded.samples.data(), tileBytes_);
+
+    VkBufferImageCopy copy_region{};
+    copy_region.bufferOffset = offset;
+    copy_region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, (uint32)layer, 1 };
+    copy_region.imageExtent = { tileSamples_, tileSamples_, 1 };
+    copies.push_back(copy_region);
+
+    VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = tiles_.image_;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, (uint32)layer, 1 };
+    barriers.push_back(barrier);
+  }
+
+  if (!copies.empty()) {
+    //Frames still in flight may sample the evicted layers, the copy waits for their vertex shaders
+    vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, static_cast<uint32>(barriers.size()), barriers.data());
+    vkCmdCopyBufferToImage(cmd_buffer, staging_[index].buffer_, tiles_.image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32>(copies.size()), copies.data());
+
+    for (auto& barrier : barriers) {
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, static_cast<uint32>(barriers.size()), barriers.data());
+  }
+
+  //Window centered on the camera tile, tiles not resident yet get -1
+  HeightmapPageHeader* page_header = (HeightmapPageHeader*)pageTables_[index].mapped_;
+  glm::ivec2 origin = cameraTile_ - glm::ivec2(kHeightmapWindow / 2);
+  page_header->window = glm::ivec4(origin, kHeightmapWindow, 1);
+  int32* layers_data = (int32*)(page_header + 1);
+  for (uint32 y = 0; y < kHeightmapWindow; y++) {
+    for (uint32 x = 0; x < kHeightmapWindow; x++) {
+      int32 tile_x = origin.x + (int32)x;
+      int32 tile_y = origin.y + (int32)y;
+      int32 layer = -1;
+      if (tile_x >= 0 && tile_y >= 0 && tile_x < (int32)header_.tilesX && tile_y < (int32)header_.tilesY) {
+        auto resident = residentLayer_.find((uint32)tile_y * header_.tilesX + (uint32)tile_x);
+        if (resident != residentLayer_.end()) layer = (int32)resident->second;
+      }
+      layers_data[y * kHeightmapWindow + x] = layer;
+    }
+  }
+}
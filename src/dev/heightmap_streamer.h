@@ -0,0 +1,120 @@
+#ifndef __VKDEV_HEIGHTMAP_STREAMER__
+#define __VKDEV_HEIGHTMAP_STREAMER__ 1
+
+#include "glm/glm.hpp"
+#include "common_def.h"
+#include "dev/buffer.h"
+#include "dev/vktexture.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+//Terrain heights are streamed from this file when it exists, otherwise the noise texture is used
+const char* const kHeightmapPath = "./../../data/terrain/heightmap.tiles";
+const uint32 kHeightmapMagic = 0x4C544D48;
+const uint32 kHeightmapVersion = 1;
+//Default cells per tile side for writeTiles, a tile stores one more sample per side
+const uint32 kHeightmapTileCells = 256;
+//Cells per side of the heightfield writeNoiseTiles generates, 16 x 16 tiles
+const uint32 kHeightmapNoiseSize = 4096;
+//Layers of the tile array, bounds the GPU memory used
+const uint32 kHeightmapResidentTiles = 64;
+//Tiles around the camera tile kept resident, (2r + 1)^2 must fit in the array
+const uint32 kHeightmapStreamRadius = 3;
+//Side of the page table window centered on the camera tile
+const uint32 kHeightmapWindow = 16;
+const uint32 kHeightmapUploadsPerFrame = 4;
+
+//File header, followed by tilesX * tilesY tiles in row order of
+//(tileCells + 1)^2 uint16 heights each. Border samples are repeated in the neighbour tiles
+struct HeightmapHeader {
+  uint32 magic;
+  uint32 version;
+  uint32 tileCells;
+  uint32 tilesX;
+  uint32 tilesY;
+  uint32 padding[3];
+};
+
+//Same layout as HeightmapPages in noise.vert, followed by the layer of every window tile
+struct HeightmapPageHeader {
+  //xy: first tile of the window, z: window side, w: 1 when streaming
+  glm::ivec4 window;
+  //x: cells per tile, y: 1 / samples per tile side
+  glm::vec4 tile;
+};
+
+struct Context;
+namespace vkdev {
+  //Pages heightmap tiles in around the camera, a loader thread reads them from disk and
+  //the render thread copies them to the layers of a texture array, evicting the least recently used
+  class HeightmapStreamer {
+  public:
+    HeightmapStreamer();
+    ~HeightmapStreamer(){}
+
+    //Splits a width x height heightfield into the tiled file format
+    static bool writeTiles(const char* path, const uint16* samples, uint32 width, uint32 height, uint32 tile_cells);
+    //size x size heightfield of the CPU fractal noise, the heights of the noise texture at a higher resolution
+    static bool writeNoiseTiles(const char* path, uint32 size, uint32 tile_cells);
+
+    //Without a valid file the resources are still created, the shader then reads the noise texture
+    void create(Context* context, const char* path, uint32 image_count);
+    void destroy();
+
+    bool isStreaming();
+    uint32 getTerrainSize();
+    VkDescriptorImageInfo* getTilesDescriptor();
+    VkBuffer getPageTable(uint32 index);
+
+    //Camera position in terrain space, requests the missing tiles around it
+    void update(const glm::vec3& camera_position);
+    //Copies the tiles loaded since the last frame and writes the page table of this image
+    void upload(VkCommandBuffer cmd_buffer, uint32 index);
+
+  private:
+    HeightmapStreamer(const HeightmapStreamer&);
+    struct LoadedTile {
+      uint32 tile;
+      std::vector<uint16> samples;
+    };
+
+    bool openFile(const char* path);
+    void createResources(uint32 image_count);
+    void loadTiles();
+    bool isWanted(uint32 tile);
+    int32 acquireLayer();
+
+    Context* context_;
+    HeightmapHeader header_;
+    std::string path_;
+    bool streaming_;
+    uint32 tileSamples_;
+    VkDeviceSize tileBytes_;
+
+    VkTexture tiles_;
+    std::vector<Buffer> pageTables_;
+    std::vector<Buffer> staging_;
+
+    glm::ivec2 cameraTile_;
+    uint64_t frame_;
+    std::unordered_map<uint32, uint32> residentLayer_;
+    std::vector<uint32> layerTile_;
+    std::vector<uint64_t> layerUsed_;
+    std::unordered_set<uint32> pending_;
+
+    //Shared with the loader thread
+    std::thread loader_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool exit_;
+    std::deque<uint32> requests_;
+    std::deque<LoadedTile> loaded_;
+  };
+}
+
+#endif
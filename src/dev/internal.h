@@ -12,6 +12,21 @@
 #include "buffer.h"
 #include "dev/ptr_alloc.h"
 #include "dev/vktexture.h"
+#include "dev/light_clusters.h"
+#include "dev/frustum_culling.h"
+#include "dev/occlusion_culling.h"
+#include "dev/gpu_culling.h"
+#include "dev/terrain_quadtree.h"
+#include "dev/noise_generator.h"
+#include "dev/heightmap_streamer.h"
+#include "dev/texture_streamer.h"
+#include "dev/staging_arena.h"
+#include "dev/shader_cache.h"
+#include "dev/pipeline_state_cache.h"
+#include "dev/render_graph.h"
+#include "dev/gpu_profiler.h"
+#include "dev/dynamic_resolution.h"
+#include "dev/cpu_profiler.h"
 #include <queue>
 
 class Entity;
@@ -20,9 +35,27 @@ class Texture;
 
 const uint32 kMaxInstance = 500;
 const uint32 kMaxMaterial = 500;
-const uint32 kMaxTexture = 20;
+const uint32 kMaxTexture = 512;
 const uint32 kTexturePerShader = 10;
-const uint32 kMaxLights = 25;
+const uint32 kMinLightCapacity = 64;
+//Stride of the per object storage buffers, shaders pad their blocks to it
+const uint32 kObjectStride = 128;
+const uint32 kMaxBindlessTextures = 4096;
+const uint32 kMaxLodLevels = 4;
+//Meshes below this index count keep a single level
+const uint32 kLodMinIndices = 768;
+//Screen height fraction covered by the bounds under which level i + 1 is used
+const float kLodScreenSize[kMaxLodLevels - 1] = { 0.25f, 0.12f, 0.05f };
+//Margin around each threshold before switching back, avoids popping
+const float kLodHysteresis = 0.15f;
+//Image based lighting bakes, the sample counts are specialization constants of their shaders
+const uint32 kPrefilteredCubeSize = 512;
+const uint32 kPrefilteredSamples = 32;
+const uint32 kBRDFSamples = 1024;
+const float kIrradianceDeltaPhi = (2.0f * PI) / 180.0f;
+const float kIrradianceDeltaTheta = (0.5f * PI) / 64.0f;
+const char* const kGrassTexturePath = "./../../data/textures/grass.jpg";
+const char* const kRockTexturePath = "./../../data/textures/mountain_rock.jpg";
 
 struct Scene {
   static Camera camera;
@@ -52,11 +85,38 @@ enum class VertexDescriptor {
   kVertexDescriptor_Pos_Norm_UV = 3,
 };
 
+//Draw candidate large enough on screen to hide the ones behind it
+struct Occluder {
+  glm::mat4 model;
+  uint32 candidate;
+  float size;
+};
+
+//Pipelines of one material and render state, looked up once per frame for every draw using them
+struct VariantPipelines {
+  int32 materialType;
+  uint32 renderState;
+  VkPipeline pipeline;
+  VkPipeline depthPipeline;
+};
+
+//Index range of one level of detail, relative to index_offset
+struct LodLevel {
+  uint32 firstIndex;
+  uint32 indexCount;
+};
+
 struct InternalVertexData {
   std::vector<Vertex> vertex;
   std::vector<uint32> indices;
   uint32 offset;
   uint32 index_offset;
+  //Object space bounds, computed when the vertex buffer is created
+  glm::vec3 aabbMin;
+  glm::vec3 aabbMax;
+  glm::vec4 sphere;
+  //Level 0 is the source mesh, simplified levels are appended to indices
+  std::vector<LodLevel> lods;
 
   static VkVertexInputBindingDescription getBindingDescription() {
     VkVertexInputBindingDescription bindingDescription{};
@@ -137,24 +197,33 @@ union UniformBlocks {
   SkyboxUniform skyboxBlock;
   IBLUniform pbriblBlock;
   NoiseBlock noiseBlock;
+  glm::vec4 objectStride[kObjectStride / sizeof(glm::vec4)];
 };
+//The shaders index the object blocks by gl_InstanceIndex with this stride
+static_assert(sizeof(UniformBlocks) == kObjectStride, "material blocks must fit in kObjectStride");
 
 struct LightParams {
+  //xyz: position, w: radius
   glm::vec4 lightPosition;
+  //rgb: color, w: intensity
   glm::vec4 lilghtColor;
 };
 
+//Lights live in a storage buffer (binding 5) culled per cluster
 struct SceneUniformBuffer {
   glm::mat4 projection;
   glm::mat4 view;
-  std::array<LightParams, kMaxLights> lights;
   glm::vec3 cameraPosition;
   uint32 lightNumber;
+  glm::uvec4 clusterGrid;
+  //x: slice scale, y: slice bias, z: 1 / tile width, w: 1 / tile height
+  glm::vec4 clusterParams;
 };
 
 struct UpdateData {
   glm::mat4 model;
   SceneUniformBuffer sceneBuffer;
+  std::vector<LightParams>* lights;
   DrawCallData drawCall;
 };
 
@@ -165,14 +234,17 @@ enum LayoutType {
   kLayoutType_Texture_Cubemap,
   kLayoutType_PBRIBL,
   kLayoutType_Noise,
+  kLayoutType_Texture_Bindless,
   kLayoutType_MAX
 };
 
 struct InternalMaterial {
   VkPipeline matPipeline;
+  VkPipeline depthPipeline = VK_NULL_HANDLE;
   VkDescriptorPool matDesciptorPool;
   std::vector<VkDescriptorSet> matDescriptorSet;
   LayoutType layout;
+  RenderQueue queue = kRenderQueue_Opaque;
   uint32 entitiesReferenced = 0;
   std::vector<uint32> texturesReferenced;
   std::vector<vkdev::Buffer> dynamicUniform;
@@ -186,25 +258,70 @@ struct PipelineSettings {
   VkDescriptorSetLayout descriptor;
 };
 
+//Global set (set = 1) holding every 2D texture loaded, indexed by texture id
+struct BindlessTextureSet {
+  VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+  VkDescriptorPool pool = VK_NULL_HANDLE;
+  VkDescriptorSet set = VK_NULL_HANDLE;
+  uint32 capacity = 0;
+};
+
+//Passes of a frame, built once. Resources bound to the swapchain image or per image buffers are rebound every frame
+struct FrameGraph {
+  vkdev::RenderGraph graph;
+  uint32 frameIndex = 0;
+  uint32 swapchain = 0;
+  uint32 depth = 0;
+  uint32 pyramid = 0;
+  uint32 indirect = 0;
+  uint32 count = 0;
+  //Target of the scene passes when it is upscaled to the swapchain
+  uint32 color = 0;
+};
+
 struct Resources {
   std::vector<InternalVertexData> vertex_data;
   vkdev::Buffer vertexBuffer;
   vkdev::Buffer indicesBuffer;
   std::vector<vkdev::Buffer> staticUniform;
 
+  std::vector<LightParams> sceneLights;
+  vkdev::LightClusters lightClusters;
+  std::vector<vkdev::Buffer> lightStorage;
+  std::vector<uint32> lightCapacity;
+  std::vector<vkdev::Buffer> clusterStorage;
+  std::vector<vkdev::Buffer> lightIndexStorage;
+
   std::array<PipelineSettings, kLayoutType_MAX> layouts;
+  BindlessTextureSet bindless;
 
   std::array<InternalMaterial, (int32)MaterialType::kMaterialType_MAX> internalMaterials;
   std::vector<vkdev::VkTexture> itextures;
+  vkdev::TextureStreamer textureStreamer;
   vkdev::VkTexture depthAttachment;
-  std::queue<DrawCallData> draw_calls;
+  std::vector<DrawCallData> draw_calls;
+  std::vector<DrawCallData> drawCandidates;
+  vkdev::FrustumCulling culling;
+  vkdev::OcclusionCulling occlusion;
+  std::vector<Occluder> occluders;
+  std::vector<VariantPipelines> variantPipelines;
+  vkdev::GPUCulling gpuCulling;
+  FrameGraph frameGraph;
+  vkdev::GPUProfiler gpuProfiler;
+  vkdev::DynamicResolution dynamicResolution;
+  std::array<uint8, kMaxInstance> entityLod{};
+  vkdev::TerrainQuadtree terrain;
+  vkdev::HeightmapStreamer heightmap;
+  CullingStats cullingStats;
   vkdev::VkTexture brdf;
   vkdev::VkTexture irradianceCube;
   vkdev::VkTexture prefilteredCube;
   vkdev::VkTexture noiseTexture;
+  vkdev::NoiseGenerator noiseGenerator;
   vkdev::VkTexture rockTerrainTexture;
   vkdev::VkTexture grassTerrainTexture;
   VkPipelineCache pipelineCache;
+  vkdev::PipelineStateCache pipelineStates;
 };
 
 
@@ -217,6 +334,18 @@ struct SwapchainDimension {
   float aspect = 0.0f;
 };
 
+struct DeviceCapabilities {
+  bool descriptorIndexing = false;
+  bool gpuCulling = false;
+  bool drawIndirectCount = false;
+  bool gpuNoise = false;
+  bool textureStreaming = false;
+  bool gpuProfiler = false;
+  bool pipelineStatistics = false;
+  bool wireframe = false;
+  bool dynamicResolution = false;
+};
+
 struct FrameData {
   VkFence submitFence;
   VkCommandPool primaryCommandPool;
@@ -237,11 +366,16 @@ struct Context {
   SwapchainDimension swapchainDimensions;
   VkSurfaceKHR surface;
   std::vector<VkImageView> swapchainImageViews;
-  std::vector<VkFramebuffer> swapchainFramebuffers;
+  std::vector<VkImage> swapchainImages;
   VkRenderPass renderPass;
+  //Depth attachment only, depth pre-pass pipelines are built against it
+  VkRenderPass depthRenderPass;
   std::vector<VkSemaphore> recycledSemaphores;
   std::vector<FrameData> perFrame;
   VkCommandPool transferCommandPool;
+  vkdev::StagingArena stagingArena;
+  vkdev::ShaderCache shaderCache;
+  DeviceCapabilities caps;
 };
 
 /***************************************************/
@@ -0,0 +1,153 @@
+#include "dev/light_clusters.h"
+#include "internal.h"
+#include <algorithm>
+
+
+vkdev::LightClusters::LightClusters()
+{
+  width_ = 0;
+  height_ = 0;
+  tileWidth_ = 1;
+  tileHeight_ = 1;
+  near_ = 0.1f;
+  far_ = 100.0f;
+  sliceScale_ = 0.0f;
+  sliceBias_ = 0.0f;
+}
+
+void vkdev::LightClusters::setGrid(uint32 width, uint32 height, float near_plane, float far_plane)
+{
+  width_ = width;
+  height_ = height;
+  tileWidth_ = (width + kClusterGridX - 1) / kClusterGridX;
+  tileHeight_ = (height + kClusterGridY - 1) / kClusterGridY;
+  near_ = near_plane;
+  far_ = far_plane;
+
+  //Exponential slices: slice = log(z) * scale + bias
+  float log_ratio = log(far_ / near_);
+  sliceScale_ = kClusterGridZ / log_ratio;
+  sliceBias_ = -(kClusterGridZ * log(near_)) / log_ratio;
+
+  clusters_.resize(kClusterCount);
+  counts_.resize(kClusterCount);
+  indices_.resize(kMaxClusterLightIndices);
+}
+
+uint32 vkdev::LightClusters::getSlice(float depth)
+{
+  float slice = log(depth) * sliceScale_ + sliceBias_;
+  return std::min((uint32)std::max(slice, 0.0f), kClusterGridZ - 1);
+}
+
+uint32 vkdev::LightClusters::build(const glm::mat4& view, const glm::mat4& projection,
+                                   const LightParams* lights, uint32 light_count)
+{
+  bounds_.resize(light_count);
+  std::fill(counts_.begin(), counts_.end(), 0);
+
+  for (uint32 i = 0; i < light_count; i++) {
+    LightBounds* bounds = &bounds_[i];
+    glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(lights[i].lightPosition), 1.0f));
+    float radius = lights[i].lightPosition.w;
+    float min_depth = -center.z - radius;
+    float max_depth = -center.z + radius;
+    bounds->visible = max_depth > near_ && min_depth < far_;
+    if (!bounds->visible) continue;
+
+    bounds->min.z = getSlice(std::max(min_depth, near_));
+    bounds->max.z = getSlice(std::min(max_depth, far_));
+
+    //Crossing the near plane, the projection of the sphere can cover the whole screen
+    if (min_depth <= near_) {
+      bounds->min.x = 0;
+      bounds->min.y = 0;
+      bounds->max.x = kClusterGridX - 1;
+      bounds->max.y = kClusterGridY - 1;
+      continue;
+    }
+
+    glm::vec2 ndc_min = glm::vec2(1.0f);
+    glm::vec2 ndc_max = glm::vec2(-1.0f);
+    for (uint32 corner = 0; corner < 8; corner++) {
+      glm::vec3 offset = { (corner & 1) ? radius : -radius,
+                           (corner & 2) ? radius : -radius,
+                           (corner & 4) ? radius : -radius };
+      glm::vec4 clip = projection * glm::vec4(center + offset, 1.0f);
+      glm::vec2 ndc = glm::vec2(clip) / clip.w;
+      ndc_min = glm::min(ndc_min, ndc);
+      ndc_max = glm::max(ndc_max, ndc);
+    }
+
+    if (ndc_max.x < -1.0f || ndc_max.y < -1.0f || ndc_min.x > 1.0f || ndc_min.y > 1.0f) {
+      bounds->visible = false;
+      continue;
+    }
+
+    ndc_min = glm::clamp(ndc_min * 0.5f + 0.5f, 0.0f, 1.0f);
+    ndc_max = glm::clamp(ndc_max * 0.5f + 0.5f, 0.0f, 1.0f);
+    bounds->min.x = std::min((uint32)(ndc_min.x * width_) / tileWidth_, kClusterGridX - 1);
+    bounds->min.y = std::min((uint32)(ndc_min.y * height_) / tileHeight_, kClusterGridY - 1);
+    bounds->max.x = std::min((uint32)(ndc_max.x * width_) / tileWidth_, kClusterGridX - 1);
+    bounds->max.y = std::min((uint32)(ndc_max.y * height_) / tileHeight_, kClusterGridY - 1);
+  }
+
+  //Count lights per cluster
+  for (uint32 i = 0; i < light_count; i++) {
+    LightBounds* bounds = &bounds_[i];
+    if (!bounds->visible) continue;
+    for (uint32 z = bounds->min.z; z <= bounds->max.z; z++) {
+      for (uint32 y = bounds->min.y; y <= bounds->max.y; y++) {
+        for (uint32 x = bounds->min.x; x <= bounds->max.x; x++) {
+          ++counts_[x + kClusterGridX * (y + kClusterGridY * z)];
+        }
+      }
+    }
+  }
+
+  //Offsets, lights beyond kMaxClusterLights or kMaxClusterLightIndices are dropped
+  uint32 offset = 0;
+  for (uint32 i = 0; i < kClusterCount; i++) {
+    uint32 count = std::min(std::min(counts_[i], kMaxClusterLights), kMaxClusterLightIndices - offset);
+    clusters_[i] = { offset, count };
+    offset += count;
+    counts_[i] = 0;
+  }
+
+  //Fill light indices
+  for (uint32 i = 0; i < light_count; i++) {
+    LightBounds* bounds = &bounds_[i];
+    if (!bounds->visible) continue;
+    for (uint32 z = bounds->min.z; z <= bounds->max.z; z++) {
+      for (uint32 y = bounds->min.y; y <= bounds->max.y; y++) {
+        for (uint32 x = bounds->min.x; x <= bounds->max.x; x++) {
+          uint32 cluster = x + kClusterGridX * (y + kClusterGridY * z);
+          uint32 slot = counts_[cluster]++;
+          if (slot < clusters_[cluster].y) indices_[clusters_[cluster].x + slot] = i;
+        }
+      }
+    }
+  }
+
+  return offset;
+}
+
+glm::uvec4 vkdev::LightClusters::getGrid()
+{
+  return { kClusterGridX, kClusterGridY, kClusterGridZ, 0 };
+}
+
+glm::vec4 vkdev::LightClusters::getParams()
+{
+  return { sliceScale_, sliceBias_, 1.0f / tileWidth_, 1.0f / tileHeight_ };
+}
+
+const glm::uvec2* vkdev::LightClusters::getClusters()
+{
+  return clusters_.data();
+}
+
+const uint32* vkdev::LightClusters::getIndices()
+{
+  return indices_.data();
+}
@@ -0,0 +1,53 @@
+#ifndef __VKDEV_LIGHT_CLUSTERS__
+#define __VKDEV_LIGHT_CLUSTERS__ 1
+
+#include "glm/glm.hpp"
+#include "common_def.h"
+
+//Screen tiles x depth slices, the fragment shaders use the same grid
+const uint32 kClusterGridX = 16;
+const uint32 kClusterGridY = 9;
+const uint32 kClusterGridZ = 24;
+const uint32 kClusterCount = kClusterGridX * kClusterGridY * kClusterGridZ;
+const uint32 kMaxClusterLightIndices = 256 * 1024;
+//Lights shaded per cluster, also the loop bound specialized into the fragment shaders
+const uint32 kMaxClusterLights = 64;
+
+struct LightParams;
+namespace vkdev {
+  class LightClusters {
+  public:
+    LightClusters();
+    ~LightClusters(){}
+
+    void setGrid(uint32 width, uint32 height, float near_plane, float far_plane);
+    uint32 build(const glm::mat4& view, const glm::mat4& projection, const LightParams* lights, uint32 light_count);
+
+    glm::uvec4 getGrid();
+    glm::vec4 getParams();
+    const glm::uvec2* getClusters();
+    const uint32* getIndices();
+
+  private:
+    struct LightBounds {
+      glm::uvec3 min;
+      glm::uvec3 max;
+      bool visible;
+    };
+
+    LightClusters(const LightClusters&);
+    uint32 getSlice(float depth);
+
+    uint32 width_, height_;
+    uint32 tileWidth_, tileHeight_;
+    float near_, far_;
+    float sliceScale_, sliceBias_;
+    //x: offset in indices_, y: number of lights
+    std::vector<glm::uvec2> clusters_;
+    std::vector<uint32> counts_;
+    std::vector<uint32> indices_;
+    std::vector<LightBounds> bounds_;
+  };
+}
+
+#endif
@@ -0,0 +1,183 @@
+#include "dev/mesh_simplifier.h"
+#include <algorithm>
+#include <unordered_map>
+#include <cfloat>
+
+
+void vkdev::MeshSimplifier::computeQuadrics(const std::vector<Vertex>& vertices, const std::vector<uint32>& indices)
+{
+  quadrics_.assign(vertices.size(), Quadric{});
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    glm::vec3 p0 = vertices[indices[i]].vertex;
+    glm::vec3 p1 = vertices[indices[i + 1]].vertex;
+    glm::vec3 p2 = vertices[indices[i + 2]].vertex;
+    glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+    float length = glm::length(normal);
+    if (length <= 0.0f) continue;
+
+    //Plane ax + by + cz + d = 0
+    normal /= length;
+    float a = normal.x, b = normal.y, c = normal.z, d = -glm::dot(normal, p0);
+    float plane[10] = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+    for (uint32 corner = 0; corner < 3; corner++) {
+      Quadric* quadric = &quadrics_[indices[i + corner]];
+      for (uint32 k = 0; k < 10; k++) {
+        quadric->m[k] += plane[k];
+      }
+    }
+  }
+}
+
+void vkdev::MeshSimplifier::lockBorders(const std::vector<uint32>& indices, uint32 vertex_count)
+{
+  //Edges used by a single triangle. Seams have split vertices, so they show up here too
+  std::unordered_map<uint64_t, uint32> edges;
+  edges.reserve(indices.size());
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    for (uint32 e = 0; e < 3; e++) {
+      uint64_t a = indices[i + e];
+      uint64_t b = indices[i + (e + 1) % 3];
+      ++edges[a < b ? (a << 32) | b : (b << 32) | a];
+    }
+  }
+
+  locked_.assign(vertex_count, 0);
+  for (auto& edge : edges) {
+    if (edge.second != 1) continue;
+    locked_[edge.first >> 32] = 1;
+    locked_[edge.first & 0xffffffff] = 1;
+  }
+}
+
+void vkdev::MeshSimplifier::buildAdjacency(const std::vector<uint32>& indices, uint32 vertex_count)
+{
+  adjacencyOffsets_.assign(vertex_count + 1, 0);
+  for (uint32 index : indices) {
+    ++adjacencyOffsets_[index + 1];
+  }
+  for (uint32 i = 0; i < vertex_count; i++) {
+    adjacencyOffsets_[i + 1] += adjacencyOffsets_[i];
+  }
+
+  adjacency_.resize(indices.size());
+  std::vector<uint32> fill(adjacencyOffsets_.begin(), adjacencyOffsets_.end() - 1);
+  for (uint32 i = 0; i < indices.size(); i++) {
+    adjacency_[fill[indices[i]]++] = i / 3;
+  }
+}
+
+float vkdev::MeshSimplifier::collapseError(const std::vector<Vertex>& vertices, uint32 from, uint32 to)
+{
+  const float* a = quadrics_[from].m;
+  const float* b = quadrics_[to].m;
+  float q[10];
+  for (uint32 k = 0; k < 10; k++) {
+    q[k] = a[k] + b[k];
+  }
+
+  glm::vec3 v = vertices[to].vertex;
+  return q[0] * v.x * v.x + 2.0f * q[1] * v.x * v.y + 2.0f * q[2] * v.x * v.z + 2.0f * q[3] * v.x +
+         q[4] * v.y * v.y + 2.0f * q[5] * v.y * v.z + 2.0f * q[6] * v.y +
+         q[7] * v.z * v.z + 2.0f * q[8] * v.z + q[9];
+}
+
+bool vkdev::MeshSimplifier::flipsTriangle(const std::vector<Vertex>& vertices, const std::vector<uint32>& indices,
+                                          uint32 from, uint32 to)
+{
+  for (uint32 i = adjacencyOffsets_[from]; i < adjacencyOffsets_[from + 1]; i++) {
+    const uint32* triangle = &indices[adjacency_[i] * 3];
+    //Triangles on the collapsed edge disappear
+    if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue;
+
+    glm::vec3 p[3], moved[3];
+    for (uint32 corner = 0; corner < 3; corner++) {
+      p[corner] = vertices[triangle[corner]].vertex;
+      moved[corner] = triangle[corner] == from ? vertices[to].vertex : p[corner];
+    }
+    glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+    glm::vec3 new_normal = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+    //Rejects flips and also large rotations, they add up over several passes
+    if (glm::dot(normal, new_normal) <= 0.25f * glm::length(normal) * glm::length(new_normal)) return true;
+  }
+
+  return false;
+}
+
+uint32 vkdev::MeshSimplifier::simplify(const std::vector<Vertex>& vertices, const std::vector<uint32>& indices,
+                                       uint32 target_index_count, std::vector<uint32>* result)
+{
+  uint32 vertex_count = static_cast<uint32>(vertices.size());
+  *result = indices;
+  computeQuadrics(vertices, indices);
+  lockBorders(indices, vertex_count);
+  remap_.resize(vertex_count);
+
+  while (result->size() > target_index_count) {
+    std::vector<uint32>& current = *result;
+    buildAdjacency(current, vertex_count);
+
+    //Each edge is added once, from the triangle where it goes in ascending order
+    collapses_.clear();
+    for (size_t i = 0; i < current.size(); i += 3) {
+      for (uint32 e = 0; e < 3; e++) {
+        uint32 a = current[i + e];
+        uint32 b = current[i + (e + 1) % 3];
+        if (a >= b || (locked_[a] && locked_[b])) continue;
+
+        float error_ab = locked_[a] ? FLT_MAX : collapseError(vertices, a, b);
+        float error_ba = locked_[b] ? FLT_MAX : collapseError(vertices, b, a);
+        if (error_ab <= error_ba) collapses_.push_back({ a, b, error_ab });
+        else collapses_.push_back({ b, a, error_ba });
+      }
+    }
+    std::sort(collapses_.begin(), collapses_.end(),
+              [](const Collapse& l, const Collapse& r) { return l.error < r.error; });
+
+    //Cheapest collapses first, a vertex is only touched once per pass
+    uint32 triangles_to_remove = static_cast<uint32>(current.size() - target_index_count) / 3;
+    uint32 removed = 0;
+    uint32 collapsed = 0;
+    touched_.assign(vertex_count, 0);
+    for (uint32 i = 0; i < vertex_count; i++) {
+      remap_[i] = i;
+    }
+
+    for (const Collapse& collapse : collapses_) {
+      if (removed >= triangles_to_remove) break;
+      if (touched_[collapse.from] || touched_[collapse.to]) continue;
+      if (flipsTriangle(vertices, current, collapse.from, collapse.to)) continue;
+
+      for (uint32 i = adjacencyOffsets_[collapse.from]; i < adjacencyOffsets_[collapse.from + 1]; i++) {
+        const uint32* triangle = &current[adjacency_[i] * 3];
+        touched_[triangle[0]] = 1;
+        touched_[triangle[1]] = 1;
+        touched_[triangle[2]] = 1;
+        if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) ++removed;
+      }
+
+      remap_[collapse.from] = collapse.to;
+      Quadric* quadric = &quadrics_[collapse.to];
+      for (uint32 k = 0; k < 10; k++) {
+        quadric->m[k] += quadrics_[collapse.from].m[k];
+      }
+      ++collapsed;
+    }
+
+    if (!collapsed) break;
+
+    //Remove the triangles that became degenerate
+    size_t write = 0;
+    for (size_t i = 0; i < current.size(); i += 3) {
+      uint32 a = remap_[current[i]];
+      uint32 b = remap_[current[i + 1]];
+      uint32 c = remap_[current[i + 2]];
+      if (a == b || b == c || a == c) continue;
+      current[write++] = a;
+      current[write++] = b;
+      current[write++] = c;
+    }
+    current.resize(write);
+  }
+
+  return static_cast<uint32>(result->size());
+}
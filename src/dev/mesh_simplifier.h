@@ -0,0 +1,50 @@
+#ifndef __VKDEV_MESH_SIMPLIFIER__
+#define __VKDEV_MESH_SIMPLIFIER__ 1
+
+#include "glm/glm.hpp"
+#include "common_def.h"
+#include "vertex_buffer.h"
+
+namespace vkdev {
+  //Quadric error edge collapse. Vertices are collapsed onto one of their neighbours,
+  //so every level indexes the same vertex array. Border and seam vertices are locked
+  class MeshSimplifier {
+  public:
+    MeshSimplifier(){}
+    ~MeshSimplifier(){}
+
+    //Returns the number of indices written to result
+    uint32 simplify(const std::vector<Vertex>& vertices, const std::vector<uint32>& indices,
+                    uint32 target_index_count, std::vector<uint32>* result);
+
+  private:
+    //Symmetric 4x4 matrix: a2 ab ac ad b2 bc bd c2 cd d2
+    struct Quadric {
+      float m[10];
+    };
+
+    struct Collapse {
+      uint32 from;
+      uint32 to;
+      float error;
+    };
+
+    MeshSimplifier(const MeshSimplifier&);
+    void computeQuadrics(const std::vector<Vertex>& vertices, const std::vector<uint32>& indices);
+    void lockBorders(const std::vector<uint32>& indices, uint32 vertex_count);
+    void buildAdjacency(const std::vector<uint32>& indices, uint32 vertex_count);
+    float collapseError(const std::vector<Vertex>& vertices, uint32 from, uint32 to);
+    bool flipsTriangle(const std::vector<Vertex>& vertices, const std::vector<uint32>& indices, uint32 from, uint32 to);
+
+    std::vector<Quadric> quadrics_;
+    std::vector<uint8> locked_;
+    std::vector<uint8> touched_;
+    std::vector<uint32> remap_;
+    //Triangles around each vertex, CSR layout
+    std::vector<uint32> adjacencyOffsets_;
+    std::vector<uint32> adjacency_;
+    std::vector<Collapse> collapses_;
+  };
+}
+
+#endif
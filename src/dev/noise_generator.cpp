@@ -0,0 +1,171 @@
+#include "dev/noise_generator.h"
+#include "internal.h"
+#include "static_helpers.h"
+#include <cstring>
+
+
+vkdev::NoiseGenerator::NoiseGenerator()
+{
+  context_ = nullptr;
+  target_ = nullptr;
+  scale_ = 1.0f;
+  period_ = 256;
+  initialized_ = false;
+  setLayout_ = VK_NULL_HANDLE;
+  pipelineLayout_ = VK_NULL_HANDLE;
+  pipeline_ = VK_NULL_HANDLE;
+  descriptorPool_ = VK_NULL_HANDLE;
+  descriptorSet_ = VK_NULL_HANDLE;
+}
+
+bool vkdev::NoiseGenerator::isSupported(VkPhysicalDevice physical_device)
+{
+  //The shader stores through an r8 image, it needs the extended storage formats
+  VkPhysicalDeviceFeatures features;
+  vkGetPhysicalDeviceFeatures(physical_device, &features);
+
+  VkFormatProperties format_properties;
+  vkGetPhysicalDeviceFormatProperties(physical_device, VK_FORMAT_R8_UNORM, &format_properties);
+
+  return features.shaderStorageImageExtendedFormats &&
+         (format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+}
+
+void vkdev::NoiseGenerator::create(Context* context, VkTexture* target, const uint32* permutations,
+                                   float scale, uint32 period)
+{
+  context_ = context;
+  target_ = target;
+  scale_ = scale;
+  period_ = period;
+  initialized_ = false;
+
+  VkDeviceSize size = sizeof(uint32) * 512;
+  permutations_.createBuffer(context_, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  void* mapped;
+  vkMapMemory(context_->logDevice_, permutations_.memory_, 0, size, 0, &mapped);
+  memcpy(mapped, permutations, size);
+  vkUnmapMemory(context_->logDevice_, permutations_.memory_);
+
+  createPipeline();
+  createDescriptorSet();
+}
+
+void vkdev::NoiseGenerator::createPipeline()
+{
+  std::vector<VkDescriptorSetLayoutBinding> bindings = {
+    dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+    dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1)
+  };
+  VkDescriptorSetLayoutCreateInfo set_info = dev::StaticHelpers::setLayoutCreateInfoInitializer(bindings);
+  assert(vkCreateDescriptorSetLayout(context_->logDevice_, &set_info, nullptr, &setLayout_) == VK_SUCCESS);
+
+  VkPushConstantRange push_range{};
+  push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_range.offset = 0;
+  push_range.size = sizeof(NoiseParams);
+
+  VkPipelineLayoutCreateInfo layout_info{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+  layout_info.setLayoutCount = 1;
+  layout_info.pSetLayouts = &setLayout_;
+  layout_info.pushConstantRangeCount = 1;
+  layout_info.pPushConstantRanges = &push_range;
+  assert(vkCreatePipelineLayout(context_->logDevice_, &layout_info, nullptr, &pipelineLayout_) == VK_SUCCESS);
+
+  pipeline_ = dev::StaticHelpers::createComputePipeline(context_,
+                                                        "./../../src/shaders/spir-v/noise_comp.spv",
+                                                        pipelineLayout_);
+}
+
+void vkdev::NoiseGenerator::createDescriptorSet()
+{
+  std::array<VkDescriptorPoolSize, 2> pool_sizes{};
+  pool_sizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  pool_sizes[0].descriptorCount = 1;
+  pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  pool_sizes[1].descriptorCount = 1;
+
+  VkDescriptorPoolCreateInfo pool_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+  pool_info.poolSizeCount = static_cast<uint32>(pool_sizes.size());
+  pool_info.pPoolSizes = pool_sizes.data();
+  pool_info.maxSets = 1;
+  assert(vkCreateDescriptorPool(context_->logDevice_, &pool_info, nullptr, &descriptorPool_) == VK_SUCCESS);
+
+  VkDescriptorSetAllocateInfo alloc_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+  alloc_info.descriptorPool = descriptorPool_;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &setLayout_;
+  assert(vkAllocateDescriptorSets(context_->logDevice_, &alloc_info, &descriptorSet_) == VK_SUCCESS);
+
+  VkDescriptorBufferInfo permutation_info{ permutations_.buffer_, 0, VK_WHOLE_SIZE };
+  VkDescriptorImageInfo image_info{ VK_NULL_HANDLE, target_->view_, VK_IMAGE_LAYOUT_GENERAL };
+
+  std::array<VkWriteDescriptorSet, 2> writes = {
+    dev::StaticHelpers::descriptorWriteInitializer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, descriptorSet_, &permutation_info),
+    dev::StaticHelpers::descriptorWriteInitializer(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, descriptorSet_, &image_info)
+  };
+  vkUpdateDescriptorSets(context_->logDevice_, static_cast<uint32>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void vkdev::NoiseGenerator::destroy()
+{
+  if (!context_) return;
+  VkDevice device = context_->logDevice_;
+
+  vkDestroyPipeline(device, pipeline_, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayout_, nullptr);
+  vkDestroyDescriptorPool(device, descriptorPool_, nullptr);
+  vkDestroyDescriptorSetLayout(device, setLayout_, nullptr);
+  permutations_.destroyBuffer();
+  context_ = nullptr;
+}
+
+/*******************************************************************************/
+
+bool vkdev::NoiseGenerator::isAnimated()
+{
+  return context_ && kNoiseAnimationSpeed != 0.0f;
+}
+
+void vkdev::NoiseGenerator::generate(VkCommandBuffer cmd_buffer, float offset)
+{
+  //Previous frames may still sample it, the barrier waits for their shader reads
+  VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+  barrier.srcAccessMask = initialized_ ? VK_ACCESS_SHADER_READ_BIT : 0;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.oldLayout = initialized_ ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = target_->image_;
+  barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+  VkPipelineStageFlags read_stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  vkCmdPipelineBarrier(cmd_buffer, initialized_ ? read_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+  NoiseParams params{};
+  params.size = glm::vec2(target_->width_, target_->height_);
+  params.scale = scale_;
+  params.offset = offset;
+  params.octaves = kNoiseOctaves;
+  params.persistence = kNoisePersistence;
+  params.period = period_;
+
+  vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_);
+  vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_, 0, 1, &descriptorSet_, 0, nullptr);
+  vkCmdPushConstants(cmd_buffer, pipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(NoiseParams), &params);
+  vkCmdDispatch(cmd_buffer, (target_->width_ + kNoiseGroupSize - 1) / kNoiseGroupSize,
+                (target_->height_ + kNoiseGroupSize - 1) / kNoiseGroupSize, 1);
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, read_stages,
+                       0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+  target_->layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  initialized_ = true;
+}
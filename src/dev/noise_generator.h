@@ -0,0 +1,68 @@
+#ifndef __VKDEV_NOISE_GENERATOR__
+#define __VKDEV_NOISE_GENERATOR__ 1
+
+#include "glm/glm.hpp"
+#include "common_def.h"
+#include "dev/buffer.h"
+#include "dev/vktexture.h"
+
+const uint32 kNoiseGroupSize = 8;
+const uint32 kNoiseOctaves = 6;
+const float kNoisePersistence = 0.5f;
+//Fixed seed so the terrain is the same on every run
+const uint32 kNoiseSeed = 1337;
+//Lattice cells across the texture, also the period so the texture tiles
+const uint32 kNoiseScale = 8;
+//Side of the noise texture when it is generated on the GPU, the CPU path keeps 512
+const uint32 kGPUNoiseResolution = 2048;
+//Offset along z per second, 0 keeps the terrain static and generates it only once
+const float kNoiseAnimationSpeed = 0.0f;
+
+//Same layout as NoiseParams in noise.comp
+struct NoiseParams {
+  glm::vec2 size;
+  float scale;
+  float offset;
+  uint32 octaves;
+  float persistence;
+  uint32 period;
+};
+
+struct Context;
+namespace vkdev {
+  //Fractal perlin noise written by a compute pass straight into the noise texture,
+  //the permutation table is uploaded once to a storage buffer
+  class NoiseGenerator {
+  public:
+    NoiseGenerator();
+    ~NoiseGenerator(){}
+
+    static bool isSupported(VkPhysicalDevice physical_device);
+
+    void create(Context* context, VkTexture* target, const uint32* permutations, float scale, uint32 period);
+    void destroy();
+
+    bool isAnimated();
+    void generate(VkCommandBuffer cmd_buffer, float offset);
+
+  private:
+    NoiseGenerator(const NoiseGenerator&);
+    void createPipeline();
+    void createDescriptorSet();
+
+    Context* context_;
+    VkTexture* target_;
+    float scale_;
+    uint32 period_;
+    bool initialized_;
+
+    Buffer permutations_;
+    VkDescriptorSetLayout setLayout_;
+    VkPipelineLayout pipelineLayout_;
+    VkPipeline pipeline_;
+    VkDescriptorPool descriptorPool_;
+    VkDescriptorSet descriptorSet_;
+  };
+}
+
+#endif
@@ -0,0 +1,193 @@
+#include "dev/occlusion_culling.h"
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cfloat>
+
+
+vkdev::OcclusionCulling::OcclusionCulling()
+{
+  near_ = 0.1f;
+  triangles_ = 0;
+}
+
+void vkdev::OcclusionCulling::begin(const glm::mat4& view, const glm::mat4& projection, float near_plane)
+{
+  view_ = view;
+  projection_ = projection;
+  near_ = near_plane;
+  triangles_ = 0;
+  //0 is infinitely far, nothing is occluded
+  depth_.assign(kOcclusionWidth * kOcclusionHeight, 0.0f);
+  tiles_.assign(kOcclusionTilesX * kOcclusionTilesY, 0.0f);
+}
+
+void vkdev::OcclusionCulling::addOccluder(const glm::mat4& model, const float* positions, uint32 stride,
+                                          const uint32* indices, uint32 index_count)
+{
+  glm::mat4 mvp = projection_ * view_ * model;
+  const uint8* base = reinterpret_cast<const uint8*>(positions);
+  for (uint32 i = 0; i + 2 < index_count; i += 3) {
+    glm::vec4 clip[3];
+    bool behind = false;
+    for (uint32 v = 0; v < 3; v++) {
+      const float* p = reinterpret_cast<const float*>(base + indices[i + v] * stride);
+      clip[v] = mvp * glm::vec4(p[0], p[1], p[2], 1.0f);
+      behind |= clip[v].w < near_;
+    }
+    //Dropping an occluder only hides less
+    if (behind) continue;
+    rasterize(clip);
+  }
+}
+
+void vkdev::OcclusionCulling::rasterize(const glm::vec4* clip)
+{
+  float x[3], y[3], z[3];
+  for (uint32 v = 0; v < 3; v++) {
+    x[v] = (clip[v].x / clip[v].w * 0.5f + 0.5f) * kOcclusionWidth;
+    y[v] = (clip[v].y / clip[v].w * 0.5f + 0.5f) * kOcclusionHeight;
+    //1 / w is linear in screen space
+    z[v] = 1.0f / clip[v].w;
+  }
+
+  float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+  if (fabs(area) < 1e-6f) return;
+  //Both windings, counter clockwise from here
+  if (area < 0.0f) {
+    std::swap(x[1], x[2]);
+    std::swap(y[1], y[2]);
+    std::swap(z[1], z[2]);
+    area = -area;
+  }
+
+  int32 min_x = std::max((int32)floor(std::min(x[0], std::min(x[1], x[2]))), 0);
+  int32 max_x = std::min((int32)ceil(std::max(x[0], std::max(x[1], x[2]))), (int32)kOcclusionWidth - 1);
+  int32 min_y = std::max((int32)floor(std::min(y[0], std::min(y[1], y[2]))), 0);
+  int32 max_y = std::min((int32)ceil(std::max(y[0], std::max(y[1], y[2]))), (int32)kOcclusionHeight - 1);
+  if (min_x > max_x || min_y > max_y) return;
+  ++triangles_;
+
+  //Edge i is opposite to vertex i: e = a * px + b * py + c, positive inside
+  float a[3], b[3], c[3];
+  for (uint32 e = 0; e < 3; e++) {
+    uint32 v0 = (e + 1) % 3;
+    uint32 v1 = (e + 2) % 3;
+    a[e] = y[v0] - y[v1];
+    b[e] = x[v1] - x[v0];
+    c[e] = x[v0] * y[v1] - x[v1] * y[v0];
+  }
+
+  //Depth plane from the barycentric weights
+  float inv_area = 1.0f / area;
+  float depth_a = (a[0] * z[0] + a[1] * z[1] + a[2] * z[2]) * inv_area;
+  float depth_b = (b[0] * z[0] + b[1] * z[1] + b[2] * z[2]) * inv_area;
+  float depth_c = (c[0] * z[0] + c[1] * z[1] + c[2] * z[2]) * inv_area;
+
+  __m128 edge_a[3], edge_b[3], edge_c[3];
+  for (uint32 e = 0; e < 3; e++) {
+    edge_a[e] = _mm_set1_ps(a[e]);
+    edge_b[e] = _mm_set1_ps(b[e]);
+    edge_c[e] = _mm_set1_ps(c[e]);
+  }
+  __m128 plane_a = _mm_set1_ps(depth_a);
+  __m128 plane_row;
+  __m128 zero = _mm_setzero_ps();
+
+  //Pixel centers, 4 aligned columns at a time, the buffer width is a multiple of 4
+  int32 start_x = min_x & ~3;
+  for (int32 py = min_y; py <= max_y; py++) {
+    __m128 center_y = _mm_set1_ps(py + 0.5f);
+    plane_row = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depth_b), center_y), _mm_set1_ps(depth_c));
+    float* row = &depth_[py * kOcclusionWidth];
+
+    for (int32 px = start_x; px <= max_x; px += 4) {
+      __m128 center_x = _mm_add_ps(_mm_set1_ps((float)px), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+      __m128 inside = _mm_cmpeq_ps(zero, zero);
+      for (uint32 e = 0; e < 3; e++) {
+        __m128 edge = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge_a[e], center_x), _mm_mul_ps(edge_b[e], center_y)),
+                                 edge_c[e]);
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+      }
+      if (!_mm_movemask_ps(inside)) continue;
+
+      //Keeps the nearest, the largest 1 / w
+      __m128 depth = _mm_add_ps(_mm_mul_ps(plane_a, center_x), plane_row);
+      __m128 current = _mm_loadu_ps(row + px);
+      __m128 nearest = _mm_max_ps(current, depth);
+      _mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+    }
+  }
+}
+
+void vkdev::OcclusionCulling::end()
+{
+  for (uint32 ty = 0; ty < kOcclusionTilesY; ty++) {
+    for (uint32 tx = 0; tx < kOcclusionTilesX; tx++) {
+      float farthest = FLT_MAX;
+      for (uint32 py = ty * kOcclusionTileSize; py < (ty + 1) * kOcclusionTileSize; py++) {
+        const float* row = &depth_[py * kOcclusionWidth + tx * kOcclusionTileSize];
+        for (uint32 px = 0; px < kOcclusionTileSize; px++) {
+          farthest = std::min(farthest, row[px]);
+        }
+      }
+      tiles_[ty * kOcclusionTilesX + tx] = farthest;
+    }
+  }
+}
+
+bool vkdev::OcclusionCulling::isVisible(const glm::vec4& world_sphere)
+{
+  glm::vec3 center = glm::vec3(view_ * glm::vec4(glm::vec3(world_sphere), 1.0f));
+  float radius = world_sphere.w;
+  float nearest = -center.z - radius;
+  if (nearest < near_) return true;
+  float object_depth = 1.0f / nearest;
+
+  //Screen rectangle of the box around the sphere, all of it in front of the near plane
+  glm::vec2 ndc_min = glm::vec2(FLT_MAX);
+  glm::vec2 ndc_max = glm::vec2(-FLT_MAX);
+  for (uint32 corner = 0; corner < 8; corner++) {
+    glm::vec3 offset = { (corner & 1) ? radius : -radius,
+                         (corner & 2) ? radius : -radius,
+                         (corner & 4) ? radius : -radius };
+    glm::vec4 clip = projection_ * glm::vec4(center + offset, 1.0f);
+    glm::vec2 ndc = glm::vec2(clip) / clip.w;
+    ndc_min = glm::min(ndc_min, ndc);
+    ndc_max = glm::max(ndc_max, ndc);
+  }
+  int32 min_x = std::max((int32)floor((ndc_min.x * 0.5f + 0.5f) * kOcclusionWidth), 0);
+  int32 max_x = std::min((int32)floor((ndc_max.x * 0.5f + 0.5f) * kOcclusionWidth), (int32)kOcclusionWidth - 1);
+  int32 min_y = std::max((int32)floor((ndc_min.y * 0.5f + 0.5f) * kOcclusionHeight), 0);
+  int32 max_y = std::min((int32)floor((ndc_max.y * 0.5f + 0.5f) * kOcclusionHeight), (int32)kOcclusionHeight - 1);
+  //Out of the screen is left to the frustum test
+  if (min_x > max_x || min_y > max_y) return true;
+
+  for (int32 ty = min_y / kOcclusionTileSize; ty <= max_y / (int32)kOcclusionTileSize; ty++) {
+    for (int32 tx = min_x / kOcclusionTileSize; tx <= max_x / (int32)kOcclusionTileSize; tx++) {
+      //The whole tile is nearer than the object
+      if (tiles_[ty * kOcclusionTilesX + tx] > object_depth) continue;
+
+      int32 x0 = std::max(min_x, tx * (int32)kOcclusionTileSize);
+      int32 x1 = std::min(max_x, (tx + 1) * (int32)kOcclusionTileSize - 1);
+      int32 y0 = std::max(min_y, ty * (int32)kOcclusionTileSize);
+      int32 y1 = std::min(max_y, (ty + 1) * (int32)kOcclusionTileSize - 1);
+      for (int32 py = y0; py <= y1; py++) {
+        for (int32 px = x0; px <= x1; px++) {
+          if (depth_[py * kOcclusionWidth + px] <= object_depth) return true;
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
+const float* vkdev::OcclusionCulling::getDepth()
+{
+  return depth_.data();
+}
+
+uint32 vkdev::OcclusionCulling::getTriangleCount()
+{
+  return triangles_;
+}
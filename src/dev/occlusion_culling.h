@@ -0,0 +1,51 @@
+#ifndef __VKDEV_OCCLUSION_CULLING__
+#define __VKDEV_OCCLUSION_CULLING__ 1
+
+#include "glm/glm.hpp"
+#include "common_def.h"
+
+//Depth buffer the occluders are rasterized into, independent of the swapchain size
+const uint32 kOcclusionWidth = 256;
+const uint32 kOcclusionHeight = 128;
+//Pixels per side of the tiles keeping the farthest depth of the buffer
+const uint32 kOcclusionTileSize = 8;
+const uint32 kOcclusionTilesX = kOcclusionWidth / kOcclusionTileSize;
+const uint32 kOcclusionTilesY = kOcclusionHeight / kOcclusionTileSize;
+//Largest entities on screen become occluders, same size measure as the levels of detail
+const float kOccluderScreenSize = 0.2f;
+const uint32 kMaxOccluders = 32;
+
+namespace vkdev {
+  //Occluder triangles rasterized on the CPU, 4 pixels at a time, into a small buffer of 1 / view depth.
+  //Bounding spheres are tested against the farthest depth of the tiles they cover, then per pixel.
+  //Only float math on the calling thread, the result doesn't depend on the device
+  class OcclusionCulling {
+  public:
+    OcclusionCulling();
+    ~OcclusionCulling(){}
+
+    void begin(const glm::mat4& view, const glm::mat4& projection, float near_plane);
+    //Positions strided by stride bytes, triangles crossing the near plane are skipped
+    void addOccluder(const glm::mat4& model, const float* positions, uint32 stride,
+                     const uint32* indices, uint32 index_count);
+    //Builds the tiles, call after the last occluder
+    void end();
+    bool isVisible(const glm::vec4& world_sphere);
+
+    const float* getDepth();
+    uint32 getTriangleCount();
+
+  private:
+    OcclusionCulling(const OcclusionCulling&);
+    void rasterize(const glm::vec4* clip);
+
+    glm::mat4 view_;
+    glm::mat4 projection_;
+    float near_;
+    uint32 triangles_;
+    std::vector<float> depth_;
+    std::vector<float> tiles_;
+  };
+}
+
+#endif
@@ -0,0 +1,229 @@
+#include "dev/pipeline_state_cache.h"
+#include "dev/static_helpers.h"
+#include "dev/task_graph.h"
+#include "internal.h"
+#include <thread>
+#include <cstring>
+#include <algorithm>
+
+
+vkdev::PipelineStateCache::PipelineStateCache()
+{
+  context_ = nullptr;
+  pipelineCache_ = VK_NULL_HANDLE;
+  base_ = VK_NULL_HANDLE;
+  exit_ = false;
+}
+
+uint64_t vkdev::PipelineStateCache::hashDesc(const PipelineDesc& desc)
+{
+  //FNV-1a over the shader paths and the state
+  uint64_t hash = 14695981039346656037ull;
+  auto combine = [&hash](uint64_t value) {
+    for (uint32 i = 0; i < 8; i++) {
+      hash ^= (value >> (i * 8)) & 0xff;
+      hash *= 1099511628211ull;
+    }
+  };
+  for (const char* c = desc.vertPath; *c; c++) combine((uint8)*c);
+  for (const char* c = desc.fragPath; c && *c; c++) combine((uint8)*c);
+  combine((uint64_t)desc.layout);
+  combine(desc.cullMode);
+  combine(desc.polygonMode);
+  combine(desc.depthTest);
+  combine(desc.depthWrite);
+  combine(desc.depthCompare);
+  combine(desc.vertexDesc);
+  for (uint32 i = 0; i < desc.specCount; i++) combine(desc.specData[i]);
+
+  return hash;
+}
+
+bool vkdev::PipelineStateCache::equalDesc(const PipelineDesc& a, const PipelineDesc& b)
+{
+  bool same_frag = a.fragPath && b.fragPath ? !strcmp(a.fragPath, b.fragPath) : a.fragPath == b.fragPath;
+  return !strcmp(a.vertPath, b.vertPath) && same_frag && a.layout == b.layout &&
+         a.cullMode == b.cullMode && a.polygonMode == b.polygonMode && a.depthTest == b.depthTest &&
+         a.depthWrite == b.depthWrite && a.depthCompare == b.depthCompare && a.vertexDesc == b.vertexDesc &&
+         a.specCount == b.specCount &&
+         !memcmp(a.specData, b.specData, a.specCount * sizeof(uint32));
+}
+
+void vkdev::PipelineStateCache::create(Context* context, VkPipelineCache pipeline_cache)
+{
+  context_ = context;
+  pipelineCache_ = pipeline_cache;
+  builder_ = std::thread(&PipelineStateCache::buildVariants, this);
+}
+
+void vkdev::PipelineStateCache::destroy()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exit_ = true;
+  }
+  condition_.notify_all();
+  if (builder_.joinable()) builder_.join();
+  requests_.clear();
+  pending_.clear();
+
+  for (auto& bucket : variants_) {
+    for (Variant& variant : bucket.second) {
+      vkDestroyPipeline(context_->logDevice_, variant.pipeline, nullptr);
+    }
+  }
+  variants_.clear();
+  used_.clear();
+  base_ = VK_NULL_HANDLE;
+}
+
+void vkdev::PipelineStateCache::setMaterial(uint32 material_type, const PipelineDesc& desc)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (materials_.size() <= material_type) {
+    materials_.resize(material_type + 1);
+    depthShaders_.resize(material_type + 1);
+  }
+  materials_[material_type] = desc;
+  depthShaders_[material_type] = desc;
+}
+
+void vkdev::PipelineStateCache::setDepthShader(uint32 material_type, const char* vert_path, uint8 vertex_desc)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  depthShaders_[material_type].vertPath = vert_path;
+  depthShaders_[material_type].vertexDesc = vertex_desc;
+}
+
+PipelineDesc vkdev::PipelineStateCache::getDesc(uint32 material_type, uint32 render_state)
+{
+  PipelineDesc desc = materials_[material_type];
+  if (render_state & kRenderState_DoubleSided) {
+    desc.cullMode = VK_CULL_MODE_NONE;
+  }
+  if ((render_state & kRenderState_Wireframe) && context_->caps.wireframe) {
+    desc.polygonMode = VK_POLYGON_MODE_LINE;
+  }
+  if (render_state & kRenderState_NoDepth) {
+    desc.depthTest = VK_FALSE;
+    desc.depthWrite = VK_FALSE;
+  }
+  if (render_state & kRenderState_DepthOnly) {
+    desc.vertPath = depthShaders_[material_type].vertPath;
+    desc.vertexDesc = depthShaders_[material_type].vertexDesc;
+    desc.fragPath = nullptr;
+    desc.specCount = 0;
+  }
+  //Depth is already written by the pre-pass
+  if ((render_state & kRenderState_DepthEqual) && desc.depthTest) {
+    desc.depthCompare = VK_COMPARE_OP_EQUAL;
+    desc.depthWrite = VK_FALSE;
+  }
+
+  return desc;
+}
+
+VkPipeline vkdev::PipelineStateCache::findVariant(const PipelineDesc& desc, uint64_t hash)
+{
+  auto found = variants_.find(hash);
+  if (found == variants_.end()) return VK_NULL_HANDLE;
+  for (Variant& variant : found->second) {
+    if (equalDesc(variant.desc, desc)) return variant.pipeline;
+  }
+  return VK_NULL_HANDLE;
+}
+
+VkPipeline vkdev::PipelineStateCache::getPipeline(uint32 material_type, uint32 render_state)
+{
+  PipelineDesc desc;
+  uint64_t hash;
+  VkPipeline base;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    used_.insert({ material_type, render_state });
+    desc = getDesc(material_type, render_state);
+    hash = hashDesc(desc);
+    VkPipeline found = findVariant(desc, hash);
+    if (found != VK_NULL_HANDLE) return found;
+    base = base_;
+  }
+
+  //Built outside the lock, two threads asking for the same variant keep the first one
+  VkPipeline pipeline = dev::StaticHelpers::createPipeline(context_, pipelineCache_, desc, base);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Variant>* bucket = &variants_[hash];
+  for (Variant& variant : *bucket) {
+    if (!equalDesc(variant.desc, desc)) continue;
+    vkDestroyPipeline(context_->logDevice_, pipeline, nullptr);
+    return variant.pipeline;
+  }
+  bucket->push_back({ desc, pipeline });
+  if (base_ == VK_NULL_HANDLE) base_ = pipeline;
+
+  return pipeline;
+}
+
+VkPipeline vkdev::PipelineStateCache::findPipeline(uint32 material_type, uint32 render_state)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  used_.insert({ material_type, render_state });
+  PipelineDesc desc = getDesc(material_type, render_state);
+  VkPipeline pipeline = findVariant(desc, hashDesc(desc));
+  if (pipeline == VK_NULL_HANDLE && pending_.insert({ material_type, render_state }).second) {
+    requests_.push_back({ material_type, render_state });
+    condition_.notify_one();
+  }
+  return pipeline;
+}
+
+void vkdev::PipelineStateCache::buildVariants()
+{
+  PROFILE_THREAD("pipeline builder");
+  while (true) {
+    std::pair<uint32, uint32> variant;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return exit_ || !requests_.empty(); });
+      if (exit_) return;
+      variant = requests_.front();
+      requests_.pop_front();
+    }
+
+    PROFILE_ZONE("build pipeline variant");
+    getPipeline(variant.first, variant.second);
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.erase(variant);
+  }
+}
+
+void vkdev::PipelineStateCache::warm(const char* path)
+{
+  std::vector<std::pair<uint32, uint32>> list;
+  FILE* file = fopen(path, "r");
+  if (file) {
+    uint32 material_type, render_state;
+    while (fscanf(file, "%u %u", &material_type, &render_state) == 2) {
+      if (material_type < materials_.size()) list.push_back({ material_type, render_state });
+    }
+    fclose(file);
+  }
+
+  TaskGraph builds;
+  for (auto& variant : list) {
+    builds.addTask("pipeline variant", [this, variant]() { getPipeline(variant.first, variant.second); });
+  }
+  builds.run(std::max(std::thread::hardware_concurrency(), 2u));
+}
+
+void vkdev::PipelineStateCache::save(const char* path)
+{
+  FILE* file = fopen(path, "w");
+  if (!file) return;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& variant : used_) {
+    fprintf(file, "%u %u\n", variant.first, variant.second);
+  }
+  fclose(file);
+}
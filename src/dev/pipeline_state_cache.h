@@ -0,0 +1,97 @@
+#ifndef __VKDEV_PIPELINE_STATE_CACHE__
+#define __VKDEV_PIPELINE_STATE_CACHE__ 1
+
+#include "vulkan/vulkan.h"
+#include "common_def.h"
+#include <mutex>
+#include <set>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+
+//Variants built in a run, read back at the next startup to build them before the first frame
+const char* const kPipelineVariantsPath = "pipeline_variants.txt";
+
+const uint32 kMaxSpecConstants = 4;
+//Added by the renderer to the render state of the material
+const uint32 kRenderState_DepthOnly = 1u << 16;
+const uint32 kRenderState_DepthEqual = 1u << 17;
+
+//Everything a graphics pipeline of the main pass is built from,
+//without fragment shader it is a depth only pipeline of the depth render pass
+struct PipelineDesc {
+  const char* vertPath;
+  const char* fragPath;
+  VkPipelineLayout layout;
+  VkCullModeFlags cullMode;
+  VkPolygonMode polygonMode;
+  VkBool32 depthTest;
+  VkBool32 depthWrite;
+  VkCompareOp depthCompare;
+  uint8 vertexDesc;
+  //Fragment shader specialization constants, 32 bit values with constant_id 0..specCount - 1
+  uint32 specCount;
+  uint32 specData[kMaxSpecConstants];
+};
+
+struct Context;
+namespace vkdev {
+  //Pipelines by hashed description. Each material type registers its description, the render state
+  //of an entity changes it and the variant is built by a builder thread the first time it's drawn, then reused
+  class PipelineStateCache {
+  public:
+    PipelineStateCache();
+    ~PipelineStateCache(){}
+
+    static uint64_t hashDesc(const PipelineDesc& desc);
+    static bool equalDesc(const PipelineDesc& a, const PipelineDesc& b);
+
+    void create(Context* context, VkPipelineCache pipeline_cache);
+    void destroy();
+
+    void setMaterial(uint32 material_type, const PipelineDesc& desc);
+    //Vertex shader of the depth only variants, the one of the material if not set
+    void setDepthShader(uint32 material_type, const char* vert_path, uint8 vertex_desc);
+    PipelineDesc getDesc(uint32 material_type, uint32 render_state);
+    //Thread safe, the first pipeline built is the base the rest derive from
+    VkPipeline getPipeline(uint32 material_type, uint32 render_state);
+    //Never builds, a missing variant is queued for the builder thread and VK_NULL_HANDLE returned until it's ready
+    VkPipeline findPipeline(uint32 material_type, uint32 render_state);
+
+    //Builds the variants listed in the file in parallel
+    void warm(const char* path);
+    void save(const char* path);
+
+  private:
+    PipelineStateCache(const PipelineStateCache&);
+    struct Variant {
+      PipelineDesc desc;
+      VkPipeline pipeline;
+    };
+
+    //Call with the mutex locked
+    VkPipeline findVariant(const PipelineDesc& desc, uint64_t hash);
+    void buildVariants();
+
+    Context* context_;
+    VkPipelineCache pipelineCache_;
+    VkPipeline base_;
+
+    std::mutex mutex_;
+    std::vector<PipelineDesc> materials_;
+    std::vector<PipelineDesc> depthShaders_;
+    std::unordered_map<uint64_t, std::vector<Variant>> variants_;
+    //Material type and render state of every variant asked for
+    std::set<std::pair<uint32, uint32>> used_;
+
+    //Shared with the builder thread
+    std::thread builder_;
+    std::condition_variable condition_;
+    bool exit_;
+    std::deque<std::pair<uint32, uint32>> requests_;
+    std::set<std::pair<uint32, uint32>> pending_;
+  };
+}
+
+#endif
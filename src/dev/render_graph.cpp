@@ -0,0 +1,639 @@
+#include "dev/render_graph.h"
+#include "dev/static_helpers.h"
+#include "dev/gpu_profiler.h"
+#include "internal.h"
+#include <algorithm>
+
+
+static VkDeviceSize alignOffset(VkDeviceSize offset, VkDeviceSize alignment)
+{
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+vkdev::RenderGraph::RenderGraph()
+{
+  context_ = nullptr;
+  profiler_ = nullptr;
+  compiled_ = false;
+}
+
+void vkdev::RenderGraph::create(Context* context)
+{
+  context_ = context;
+  compiled_ = false;
+}
+
+void vkdev::RenderGraph::destroy()
+{
+  if (!context_) return;
+  VkDevice device = context_->logDevice_;
+
+  for (auto& framebuffer : framebuffers_) {
+    vkDestroyFramebuffer(device, framebuffer.second, nullptr);
+  }
+  for (auto& render_pass : renderPasses_) {
+    vkDestroyRenderPass(device, render_pass.second, nullptr);
+  }
+  for (GraphResource& resource : resources_) {
+    if (!resource.transient) continue;
+    if (resource.view != VK_NULL_HANDLE) vkDestroyImageView(device, resource.view, nullptr);
+    if (resource.image != VK_NULL_HANDLE) vkDestroyImage(device, resource.image, nullptr);
+  }
+  for (GraphMemory& memory : memories_) {
+    vkFreeMemory(device, memory.memory, nullptr);
+  }
+
+  framebuffers_.clear();
+  renderPasses_.clear();
+  resources_.clear();
+  passes_.clear();
+  memories_.clear();
+  compiled_ = false;
+  context_ = nullptr;
+}
+
+
+/*****************************************************************************************************************/
+//Declaration
+
+uint32 vkdev::RenderGraph::importImage(const char* name, VkFormat format, VkImageAspectFlags aspect, uint32 levels,
+                                       uint32 layers, VkImageLayout final_layout, bool persistent)
+{
+  GraphResource resource{};
+  resource.name = name;
+  resource.isImage = true;
+  resource.persistent = persistent;
+  resource.format = format;
+  resource.aspect = aspect;
+  resource.levels = levels;
+  resource.layers = layers;
+  resource.finalLayout = final_layout;
+  resource.memory = -1;
+  resource.firstPass = -1;
+  resource.lastPass = -1;
+  resetState(&resource);
+  resources_.push_back(resource);
+
+  return static_cast<uint32>(resources_.size() - 1);
+}
+
+uint32 vkdev::RenderGraph::createImage(const char* name, VkFormat format, VkImageAspectFlags aspect, uint32 width,
+                                       uint32 height, VkImageUsageFlags usage)
+{
+  GraphResource resource{};
+  resource.name = name;
+  resource.isImage = true;
+  resource.transient = true;
+  resource.format = format;
+  resource.aspect = aspect;
+  resource.levels = 1;
+  resource.layers = 1;
+  resource.width = width;
+  resource.height = height;
+  resource.usage = usage;
+  resource.memory = -1;
+  resource.firstPass = -1;
+  resource.lastPass = -1;
+  resetState(&resource);
+  resources_.push_back(resource);
+
+  return static_cast<uint32>(resources_.size() - 1);
+}
+
+uint32 vkdev::RenderGraph::importBuffer(const char* name)
+{
+  GraphResource resource{};
+  resource.name = name;
+  resource.persistent = true;
+  resource.memory = -1;
+  resource.firstPass = -1;
+  resource.lastPass = -1;
+  resetState(&resource);
+  resources_.push_back(resource);
+
+  return static_cast<uint32>(resources_.size() - 1);
+}
+
+void vkdev::RenderGraph::bindImage(uint32 resource, VkImage image, VkImageView view, uint32 width, uint32 height)
+{
+  GraphResource* graph_resource = &resources_[resource];
+  assert(graph_resource->isImage && !graph_resource->transient);
+
+  //A different image has none of the state of the previous one
+  if (graph_resource->persistent && graph_resource->image != image) resetState(graph_resource);
+  graph_resource->image = image;
+  graph_resource->view = view;
+  graph_resource->width = width;
+  graph_resource->height = height;
+}
+
+void vkdev::RenderGraph::bindBuffer(uint32 resource, VkBuffer buffer)
+{
+  assert(!resources_[resource].isImage);
+  resources_[resource].buffer = buffer;
+}
+
+void vkdev::RenderGraph::markOutput(uint32 resource)
+{
+  resources_[resource].output = true;
+}
+
+VkImage vkdev::RenderGraph::getImage(uint32 resource)
+{
+  return resources_[resource].image;
+}
+
+VkImageView vkdev::RenderGraph::getView(uint32 resource)
+{
+  return resources_[resource].view;
+}
+
+uint32 vkdev::RenderGraph::addPass(const char* name, RenderPassType type, ExecuteFunction execute)
+{
+  assert(!compiled_);
+  GraphPass pass{};
+  pass.name = name;
+  pass.type = type;
+  pass.execute = execute;
+  pass.depth = -1;
+  pass.renderPass = VK_NULL_HANDLE;
+  passes_.push_back(pass);
+
+  return static_cast<uint32>(passes_.size() - 1);
+}
+
+void vkdev::RenderGraph::addAccess(uint32 pass, const GraphAccess& access)
+{
+  GraphResource* resource = &resources_[access.resource];
+  if (resource->isImage && access.layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+    throw std::runtime_error("\nRender graph image accessed without a layout: " + resource->name);
+  }
+
+  //Every resource is accessed once per pass, with the stages and access of all its uses
+  for (GraphAccess& current : passes_[pass].accesses) {
+    if (current.resource != access.resource) continue;
+    if (resource->isImage && current.layout != access.layout) {
+      throw std::runtime_error("\nRender graph image used with two layouts in pass " + passes_[pass].name);
+    }
+    current.stages |= access.stages;
+    current.access |= access.access;
+    current.read = current.read || access.read;
+    current.write = current.write || access.write;
+    current.discard = current.discard && access.discard;
+    return;
+  }
+  passes_[pass].accesses.push_back(access);
+}
+
+void vkdev::RenderGraph::read(uint32 pass, uint32 resource, VkPipelineStageFlags stages, VkAccessFlags access,
+                              VkImageLayout layout)
+{
+  addAccess(pass, { resource, stages, access, layout, true, false, false });
+}
+
+void vkdev::RenderGraph::write(uint32 pass, uint32 resource, VkPipelineStageFlags stages, VkAccessFlags access,
+                               VkImageLayout layout)
+{
+  addAccess(pass, { resource, stages, access, layout, false, true, false });
+}
+
+void vkdev::RenderGraph::writeColor(uint32 pass, uint32 resource, const VkClearValue* clear)
+{
+  assert(passes_[pass].type == kRenderPassType_Graphics);
+  GraphAttachment attachment{};
+  attachment.resource = resource;
+  attachment.clear = clear != nullptr;
+  if (clear) attachment.clearValue = *clear;
+  passes_[pass].colors.push_back(attachment);
+
+  VkAccessFlags access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  if (!clear) access |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+  addAccess(pass, { resource, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, access,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, !clear, true, attachment.clear });
+}
+
+void vkdev::RenderGraph::writeDepth(uint32 pass, uint32 resource, const VkClearValue* clear)
+{
+  assert(passes_[pass].type == kRenderPassType_Graphics && passes_[pass].depth < 0);
+  GraphAttachment attachment{};
+  attachment.resource = resource;
+  attachment.clear = clear != nullptr;
+  if (clear) attachment.clearValue = *clear;
+  passes_[pass].depth = 0;
+  passes_[pass].depthAttachment = attachment;
+
+  addAccess(pass, { resource, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, !clear, true, attachment.clear });
+}
+
+void vkdev::RenderGraph::setSideEffects(uint32 pass)
+{
+  passes_[pass].sideEffects = true;
+}
+
+void vkdev::RenderGraph::setProfiler(GPUProfiler* profiler)
+{
+  profiler_ = profiler;
+}
+
+
+/*****************************************************************************************************************/
+//Compilation
+
+void vkdev::RenderGraph::compile()
+{
+  assert(!compiled_);
+  cullPasses();
+
+  for (uint32 i = 0; i < passes_.size(); i++) {
+    if (passes_[i].culled) continue;
+    for (GraphAccess& access : passes_[i].accesses) {
+      GraphResource* resource = &resources_[access.resource];
+      if (resource->firstPass < 0) resource->firstPass = i;
+      resource->lastPass = i;
+    }
+  }
+
+  allocateTransients();
+
+  for (GraphPass& pass : passes_) {
+    if (!pass.culled && pass.type == kRenderPassType_Graphics) createRenderPass(&pass);
+  }
+
+  compiled_ = true;
+}
+
+void vkdev::RenderGraph::cullPasses()
+{
+  std::vector<bool> needed(resources_.size(), false);
+  for (uint32 i = 0; i < resources_.size(); i++) {
+    needed[i] = resources_[i].output;
+  }
+
+  //Walking backwards, a pass survives when it writes something a later pass or the caller needs
+  for (int32 i = static_cast<int32>(passes_.size()) - 1; i >= 0; i--) {
+    GraphPass* pass = &passes_[i];
+    bool used = pass->sideEffects;
+    for (GraphAccess& access : pass->accesses) {
+      if (access.write && needed[access.resource]) used = true;
+    }
+
+    pass->culled = !used;
+    if (pass->culled) continue;
+    for (GraphAccess& access : pass->accesses) {
+      if (access.read) needed[access.resource] = true;
+    }
+  }
+}
+
+void vkdev::RenderGraph::allocateTransients()
+{
+  VkDevice device = context_->logDevice_;
+  std::vector<uint32> transients;
+  std::vector<VkMemoryRequirements> requirements(resources_.size());
+
+  for (uint32 i = 0; i < resources_.size(); i++) {
+    GraphResource* resource = &resources_[i];
+    if (!resource->transient || resource->firstPass < 0) continue;
+
+    VkImageCreateInfo image_info{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = resource->format;
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.extent = { resource->width, resource->height, 1 };
+    image_info.usage = resource->usage;
+    assert(vkCreateImage(device, &image_info, nullptr, &resource->image) == VK_SUCCESS);
+
+    vkGetImageMemoryRequirements(device, resource->image, &requirements[i]);
+    transients.push_back(i);
+  }
+
+  //Largest first, every image takes the lowest offset not used by an image alive at the same time
+  std::sort(transients.begin(), transients.end(), [&requirements](uint32 a, uint32 b) {
+    return requirements[a].size > requirements[b].size;
+  });
+
+  std::vector<uint32> placed;
+  for (uint32 index : transients) {
+    GraphResource* resource = &resources_[index];
+    VkMemoryRequirements* req = &requirements[index];
+    uint32 type_index = dev::StaticHelpers::findMemoryType(context_->physDevice_, req->memoryTypeBits,
+                                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    int32 memory = -1;
+    for (uint32 m = 0; m < memories_.size(); m++) {
+      if (memories_[m].typeIndex == type_index) memory = m;
+    }
+    if (memory < 0) {
+      memories_.push_back({ VK_NULL_HANDLE, type_index, 0 });
+      memory = static_cast<int32>(memories_.size() - 1);
+    }
+
+    VkDeviceSize offset = 0;
+    bool overlap = true;
+    while (overlap) {
+      overlap = false;
+      for (uint32 other_index : placed) {
+        GraphResource* other = &resources_[other_index];
+        if (other->memory != memory) continue;
+        if (other->lastPass < resource->firstPass || other->firstPass > resource->lastPass) continue;
+
+        VkDeviceSize other_end = other->offset + requirements[other_index].size;
+        if (offset < other_end && other->offset < offset + req->size) {
+          offset = alignOffset(other_end, req->alignment);
+          overlap = true;
+        }
+      }
+    }
+
+    resource->memory = memory;
+    resource->offset = offset;
+    memories_[memory].size = std::max(memories_[memory].size, offset + req->size);
+    placed.push_back(index);
+  }
+
+  for (GraphMemory& memory : memories_) {
+    VkMemoryAllocateInfo alloc_info{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    alloc_info.allocationSize = memory.size;
+    alloc_info.memoryTypeIndex = memory.typeIndex;
+    assert(vkAllocateMemory(device, &alloc_info, nullptr, &memory.memory) == VK_SUCCESS);
+  }
+
+  for (uint32 index : transients) {
+    GraphResource* resource = &resources_[index];
+    vkBindImageMemory(device, resource->image, memories_[resource->memory].memory, resource->offset);
+
+    VkImageViewCreateInfo view_info{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    view_info.image = resource->image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = resource->format;
+    view_info.subresourceRange = { resource->aspect, 0, 1, 0, 1 };
+    assert(vkCreateImageView(device, &view_info, nullptr, &resource->view) == VK_SUCCESS);
+  }
+}
+
+void vkdev::RenderGraph::createRenderPass(GraphPass* pass)
+{
+  uint32 pass_index = static_cast<uint32>(pass - passes_.data());
+  std::vector<GraphAttachment> attachments = pass->colors;
+  if (pass->depth >= 0) {
+    pass->depth = static_cast<int32>(attachments.size());
+    attachments.push_back(pass->depthAttachment);
+  }
+
+  std::vector<VkAttachmentDescription> descriptions;
+  std::vector<uint32> key;
+  key.push_back(pass->depth + 1);
+  for (GraphAttachment& attachment : attachments) {
+    GraphResource* resource = &resources_[attachment.resource];
+    bool undefined = resource->firstPass == static_cast<int32>(pass_index) && !resource->persistent;
+    bool stored = !resource->transient || resource->lastPass > static_cast<int32>(pass_index) || resource->output;
+    bool depth = resource->aspect & VK_IMAGE_ASPECT_DEPTH_BIT;
+
+    VkAttachmentDescription description{};
+    description.format = resource->format;
+    description.samples = VK_SAMPLE_COUNT_1_BIT;
+    description.loadOp = attachment.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR :
+                         (undefined ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_LOAD);
+    description.storeOp = stored ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    //Transitions are recorded as barriers around the render pass
+    description.initialLayout = depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL :
+                                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    description.finalLayout = description.initialLayout;
+    descriptions.push_back(description);
+
+    key.push_back(description.format);
+    key.push_back(description.loadOp);
+    key.push_back(description.storeOp);
+  }
+
+  auto cached = renderPasses_.find(key);
+  if (cached != renderPasses_.end()) {
+    pass->renderPass = cached->second;
+    return;
+  }
+
+  std::vector<VkAttachmentReference> color_refs;
+  for (uint32 i = 0; i < pass->colors.size(); i++) {
+    color_refs.push_back({ i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+  }
+  VkAttachmentReference depth_ref{ static_cast<uint32>(pass->depth), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = static_cast<uint32>(color_refs.size());
+  subpass.pColorAttachments = color_refs.data();
+  subpass.pDepthStencilAttachment = pass->depth >= 0 ? &depth_ref : nullptr;
+
+  VkRenderPassCreateInfo render_pass_info{ VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+  render_pass_info.attachmentCount = static_cast<uint32>(descriptions.size());
+  render_pass_info.pAttachments = descriptions.data();
+  render_pass_info.subpassCount = 1;
+  render_pass_info.pSubpasses = &subpass;
+  assert(vkCreateRenderPass(context_->logDevice_, &render_pass_info, nullptr, &pass->renderPass) == VK_SUCCESS);
+
+  renderPasses_[key] = pass->renderPass;
+}
+
+VkFramebuffer vkdev::RenderGraph::getFramebuffer(GraphPass* pass, uint32* width, uint32* height)
+{
+  std::vector<VkImageView> views;
+  for (GraphAttachment& attachment : pass->colors) {
+    views.push_back(resources_[attachment.resource].view);
+  }
+  uint32 first = pass->colors.empty() ? pass->depthAttachment.resource : pass->colors[0].resource;
+  if (pass->depth >= 0) views.push_back(resources_[pass->depthAttachment.resource].view);
+  *width = resources_[first].width;
+  *height = resources_[first].height;
+
+  std::vector<uint64_t> key;
+  key.push_back((uint64_t)pass->renderPass);
+  key.push_back(((uint64_t)*width << 32) | *height);
+  for (VkImageView view : views) {
+    key.push_back((uint64_t)view);
+  }
+
+  auto cached = framebuffers_.find(key);
+  if (cached != framebuffers_.end()) return cached->second;
+
+  VkFramebufferCreateInfo framebuffer_info{ VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+  framebuffer_info.renderPass = pass->renderPass;
+  framebuffer_info.attachmentCount = static_cast<uint32>(views.size());
+  framebuffer_info.pAttachments = views.data();
+  framebuffer_info.width = *width;
+  framebuffer_info.height = *height;
+  framebuffer_info.layers = 1;
+
+  VkFramebuffer framebuffer;
+  assert(vkCreateFramebuffer(context_->logDevice_, &framebuffer_info, nullptr, &framebuffer) == VK_SUCCESS);
+  framebuffers_[key] = framebuffer;
+
+  return framebuffer;
+}
+
+bool vkdev::RenderGraph::isCulled(uint32 pass)
+{
+  assert(compiled_);
+  return passes_[pass].culled;
+}
+
+VkRenderPass vkdev::RenderGraph::getRenderPass(uint32 pass)
+{
+  assert(compiled_);
+  return passes_[pass].renderPass;
+}
+
+
+/*****************************************************************************************************************/
+//Execution
+
+void vkdev::RenderGraph::resetState(GraphResource* resource)
+{
+  resource->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  resource->writeStages = 0;
+  resource->writeAccess = 0;
+  resource->readStages = 0;
+  resource->touched = false;
+  //Memory of a transient may still be in use by the image aliased before it
+  if (resource->transient) {
+    resource->writeStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    resource->writeAccess = VK_ACCESS_MEMORY_WRITE_BIT;
+  }
+}
+
+void vkdev::RenderGraph::execute(VkCommandBuffer cmd_buffer)
+{
+  assert(compiled_);
+  for (GraphResource& resource : resources_) {
+    if (!resource.persistent) resetState(&resource);
+  }
+
+  std::vector<VkImageMemoryBarrier> image_barriers;
+  std::vector<VkClearValue> clear_values;
+  for (GraphPass& pass : passes_) {
+    if (pass.culled) continue;
+
+    VkPipelineStageFlags src_stages = 0, dst_stages = 0;
+    VkMemoryBarrier memory_barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    image_barriers.clear();
+
+    for (GraphAccess& access : pass.accesses) {
+      GraphResource* resource = &resources_[access.resource];
+      bool layout_change = resource->isImage && resource->layout != access.layout;
+      bool read_after_write = resource->writeStages && (access.write || (access.stages & ~resource->readStages));
+      bool write_after_read = access.write && resource->readStages;
+
+      if (layout_change || read_after_write || write_after_read) {
+        VkPipelineStageFlags src = resource->writeStages | resource->readStages;
+        VkAccessFlags src_access = resource->writeAccess;
+        //Imported images without contents wait on the stages of their first use, after the acquire semaphore
+        if (!resource->persistent && !resource->transient && !resource->touched) {
+          src = access.stages;
+          src_access = 0;
+        }
+        if (!src) src = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        src_stages |= src;
+        dst_stages |= access.stages;
+
+        if (resource->isImage) {
+          VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+          barrier.srcAccessMask = src_access;
+          barrier.dstAccessMask = access.access;
+          barrier.oldLayout = access.discard ? VK_IMAGE_LAYOUT_UNDEFINED : resource->layout;
+          barrier.newLayout = access.layout;
+          barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+          barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+          barrier.image = resource->image;
+          barrier.subresourceRange = { resource->aspect, 0, resource->levels, 0, resource->layers };
+          image_barriers.push_back(barrier);
+        }
+        else {
+          memory_barrier.srcAccessMask |= src_access;
+          memory_barrier.dstAccessMask |= access.access;
+        }
+      }
+
+      resource->layout = access.layout;
+      resource->touched = true;
+      if (access.write) {
+        resource->writeStages = access.stages;
+        resource->writeAccess = access.access;
+        resource->readStages = 0;
+      }
+      else {
+        resource->readStages |= access.stages;
+      }
+    }
+
+    if (src_stages) {
+      bool memory = memory_barrier.srcAccessMask || memory_barrier.dstAccessMask;
+      vkCmdPipelineBarrier(cmd_buffer, src_stages, dst_stages, 0,
+                           memory ? 1 : 0, &memory_barrier, 0, nullptr,
+                           static_cast<uint32>(image_barriers.size()), image_barriers.data());
+    }
+
+    if (profiler_) profiler_->beginScope(cmd_buffer, pass.name.c_str());
+    if (pass.type != kRenderPassType_Graphics) {
+      pass.execute(cmd_buffer);
+      if (profiler_) profiler_->endScope(cmd_buffer);
+      continue;
+    }
+
+    clear_values.clear();
+    for (GraphAttachment& attachment : pass.colors) {
+      clear_values.push_back(attachment.clearValue);
+    }
+    if (pass.depth >= 0) clear_values.push_back(pass.depthAttachment.clearValue);
+
+    VkRenderPassBeginInfo begin_info{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+    begin_info.renderPass = pass.renderPass;
+    begin_info.framebuffer = getFramebuffer(&pass, &begin_info.renderArea.extent.width,
+                                            &begin_info.renderArea.extent.height);
+    begin_info.clearValueCount = static_cast<uint32>(clear_values.size());
+    begin_info.pClearValues = clear_values.data();
+
+    vkCmdBeginRenderPass(cmd_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    pass.execute(cmd_buffer);
+    vkCmdEndRenderPass(cmd_buffer);
+    if (profiler_) profiler_->endScope(cmd_buffer);
+  }
+
+  //Imported images are left in the layout the rest of the frame expects
+  image_barriers.clear();
+  VkPipelineStageFlags src_stages = 0;
+  for (GraphResource& resource : resources_) {
+    if (!resource.isImage || resource.transient || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED) continue;
+    if (resource.layout == resource.finalLayout || resource.layout == VK_IMAGE_LAYOUT_UNDEFINED) continue;
+
+    VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    barrier.srcAccessMask = resource.writeAccess;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.oldLayout = resource.layout;
+    barrier.newLayout = resource.finalLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = resource.image;
+    barrier.subresourceRange = { resource.aspect, 0, resource.levels, 0, resource.layers };
+    image_barriers.push_back(barrier);
+    src_stages |= resource.writeStages | resource.readStages;
+
+    resource.layout = resource.finalLayout;
+    resource.writeStages = 0;
+    resource.writeAccess = 0;
+    resource.readStages = 0;
+  }
+
+  if (!image_barriers.empty()) {
+    vkCmdPipelineBarrier(cmd_buffer, src_stages ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr,
+                         static_cast<uint32>(image_barriers.size()), image_barriers.data());
+  }
+}
@@ -0,0 +1,149 @@
+#ifndef __VKDEV_RENDER_GRAPH__
+#define __VKDEV_RENDER_GRAPH__ 1
+
+#include "vulkan/vulkan.h"
+#include "common_def.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <map>
+
+enum RenderPassType {
+  kRenderPassType_Graphics = 0,
+  kRenderPassType_Compute,
+  kRenderPassType_Transfer,
+};
+
+struct Context;
+namespace vkdev {
+  class GPUProfiler;
+
+  //Passes declare the resources they read and write, the graph culls the passes that lead to no output,
+  //places transient images in shared memory when their lifetimes don't overlap, builds the render passes
+  //of the graphics passes and records the barriers and layout transitions between passes.
+  //Passes run in the order they are added
+  class RenderGraph {
+  public:
+    typedef std::function<void(VkCommandBuffer)> ExecuteFunction;
+
+    RenderGraph();
+    ~RenderGraph(){}
+
+    void create(Context* context);
+    void destroy();
+
+    //Images owned elsewhere, bound before every execute. Persistent images keep their contents and
+    //state between executions, the rest start undefined. The final layout is set after the last pass
+    uint32 importImage(const char* name, VkFormat format, VkImageAspectFlags aspect, uint32 levels, uint32 layers,
+                       VkImageLayout final_layout, bool persistent);
+    //Created by compile, contents only live between the first and the last pass using them
+    uint32 createImage(const char* name, VkFormat format, VkImageAspectFlags aspect, uint32 width, uint32 height,
+                       VkImageUsageFlags usage);
+    uint32 importBuffer(const char* name);
+    void bindImage(uint32 resource, VkImage image, VkImageView view, uint32 width, uint32 height);
+    void bindBuffer(uint32 resource, VkBuffer buffer);
+    //Read after the graph executes, passes not leading to an output are culled
+    void markOutput(uint32 resource);
+    VkImage getImage(uint32 resource);
+    VkImageView getView(uint32 resource);
+
+    uint32 addPass(const char* name, RenderPassType type, ExecuteFunction execute);
+    void read(uint32 pass, uint32 resource, VkPipelineStageFlags stages, VkAccessFlags access,
+              VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+    void write(uint32 pass, uint32 resource, VkPipelineStageFlags stages, VkAccessFlags access,
+               VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+    //Attachments of a graphics pass, cleared when a clear value is given and loaded otherwise
+    void writeColor(uint32 pass, uint32 resource, const VkClearValue* clear = nullptr);
+    void writeDepth(uint32 pass, uint32 resource, const VkClearValue* clear = nullptr);
+    //Kept even without outputs, for uploads and host readbacks
+    void setSideEffects(uint32 pass);
+
+    //Every pass recorded inside a profiler scope with its name
+    void setProfiler(GPUProfiler* profiler);
+
+    void compile();
+    bool isCulled(uint32 pass);
+    //Render pass compatible with the pipelines drawn in the pass
+    VkRenderPass getRenderPass(uint32 pass);
+    void execute(VkCommandBuffer cmd_buffer);
+
+  private:
+    RenderGraph(const RenderGraph&);
+    struct GraphResource {
+      std::string name;
+      bool isImage;
+      bool transient;
+      bool persistent;
+      bool output;
+      VkFormat format;
+      VkImageAspectFlags aspect;
+      uint32 levels, layers;
+      uint32 width, height;
+      VkImageUsageFlags usage;
+      VkImageLayout finalLayout;
+      VkImage image;
+      VkImageView view;
+      VkBuffer buffer;
+      int32 memory;
+      VkDeviceSize offset;
+      int32 firstPass, lastPass;
+      //Synchronization state after the last recorded access
+      VkImageLayout layout;
+      VkPipelineStageFlags writeStages;
+      VkAccessFlags writeAccess;
+      VkPipelineStageFlags readStages;
+      bool touched;
+    };
+    struct GraphAccess {
+      uint32 resource;
+      VkPipelineStageFlags stages;
+      VkAccessFlags access;
+      VkImageLayout layout;
+      bool read;
+      bool write;
+      //Whole contents are overwritten, the previous layout can be discarded
+      bool discard;
+    };
+    struct GraphAttachment {
+      uint32 resource;
+      bool clear;
+      VkClearValue clearValue;
+    };
+    struct GraphPass {
+      std::string name;
+      RenderPassType type;
+      ExecuteFunction execute;
+      std::vector<GraphAccess> accesses;
+      std::vector<GraphAttachment> colors;
+      int32 depth;
+      GraphAttachment depthAttachment;
+      bool sideEffects;
+      bool culled;
+      VkRenderPass renderPass;
+    };
+    struct GraphMemory {
+      VkDeviceMemory memory;
+      uint32 typeIndex;
+      VkDeviceSize size;
+    };
+
+    void addAccess(uint32 pass, const GraphAccess& access);
+    void cullPasses();
+    void allocateTransients();
+    void createRenderPass(GraphPass* pass);
+    VkFramebuffer getFramebuffer(GraphPass* pass, uint32* width, uint32* height);
+    void resetState(GraphResource* resource);
+
+    Context* context_;
+    GPUProfiler* profiler_;
+    bool compiled_;
+    std::vector<GraphResource> resources_;
+    std::vector<GraphPass> passes_;
+    std::vector<GraphMemory> memories_;
+    //Passes with the same attachments share render passes, framebuffers are kept per set of views
+    std::map<std::vector<uint32>, VkRenderPass> renderPasses_;
+    std::map<std::vector<uint64_t>, VkFramebuffer> framebuffers_;
+  };
+}
+
+#endif
@@ -0,0 +1,31 @@
+#include "dev/shader_cache.h"
+#include "dev/static_helpers.h"
+
+
+VkShaderModule vkdev::ShaderCache::getModule(VkDevice device, const char* path)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = modules_.find(path);
+    if (found != modules_.end()) return found->second;
+  }
+
+  //Loaded outside the lock, two threads asking for the same file keep the first module
+  auto code = dev::StaticHelpers::loadShader(path);
+  VkShaderModule module = dev::StaticHelpers::createShaderModule(device, code);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto inserted = modules_.insert({ path, module });
+  if (!inserted.second) vkDestroyShaderModule(device, module, nullptr);
+
+  return inserted.first->second;
+}
+
+void vkdev::ShaderCache::destroy(VkDevice device)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& module : modules_) {
+    vkDestroyShaderModule(device, module.second, nullptr);
+  }
+  modules_.clear();
+}
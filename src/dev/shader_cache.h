@@ -0,0 +1,29 @@
+#ifndef __VKDEV_SHADER_CACHE__
+#define __VKDEV_SHADER_CACHE__ 1
+
+#include "vulkan/vulkan.h"
+#include "common_def.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace vkdev {
+  //Shader modules by SPIR-V path, each file is read and created once and shared by every pipeline using it.
+  //Safe to call from the threads building pipelines
+  class ShaderCache {
+  public:
+    ShaderCache(){}
+    ~ShaderCache(){}
+
+    VkShaderModule getModule(VkDevice device, const char* path);
+    void destroy(VkDevice device);
+
+  private:
+    ShaderCache(const ShaderCache&);
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, VkShaderModule> modules_;
+  };
+}
+
+#endif
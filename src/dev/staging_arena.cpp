@@ -0,0 +1,36 @@
+#include "dev/staging_arena.h"
+#include "internal.h"
+#include <algorithm>
+
+
+vkdev::StagingArena::StagingArena()
+{
+  capacity_ = 0;
+}
+
+void* vkdev::StagingArena::acquire(Context* context, VkDeviceSize size)
+{
+  if (size > capacity_) {
+    //Previous contents are not kept, every upload waits for the queue before the next
+    buffer_.destroyBuffer();
+    capacity_ = std::max(capacity_, kStagingArenaMinSize);
+    while (capacity_ < size) capacity_ *= 2;
+
+    buffer_.createBuffer(context, capacity_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    vkMapMemory(context->logDevice_, buffer_.memory_, 0, capacity_, 0, &buffer_.mapped_);
+  }
+
+  return buffer_.mapped_;
+}
+
+VkBuffer vkdev::StagingArena::getBuffer()
+{
+  return buffer_.buffer_;
+}
+
+void vkdev::StagingArena::destroy()
+{
+  buffer_.destroyBuffer();
+  capacity_ = 0;
+}
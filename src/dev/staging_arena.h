@@ -0,0 +1,33 @@
+#ifndef __VKDEV_STAGING_ARENA__
+#define __VKDEV_STAGING_ARENA__ 1
+
+#include "vulkan/vulkan.h"
+#include "common_def.h"
+#include "dev/buffer.h"
+
+//Smallest size the arena is created with
+const VkDeviceSize kStagingArenaMinSize = 4ull * 1024ull * 1024ull;
+
+struct Context;
+namespace vkdev {
+  //Persistently mapped staging buffer shared by the uploads that wait for the queue,
+  //it grows to the largest upload instead of allocating one buffer per load
+  class StagingArena {
+  public:
+    StagingArena();
+    ~StagingArena(){}
+
+    //Mapped memory of at least size bytes, reused by the next call
+    void* acquire(Context* context, VkDeviceSize size);
+    VkBuffer getBuffer();
+    void destroy();
+
+  private:
+    StagingArena(const StagingArena&);
+
+    Buffer buffer_;
+    VkDeviceSize capacity_;
+  };
+}
+
+#endif
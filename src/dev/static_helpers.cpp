@@ -160,18 +160,14 @@ SwapChainSupportDetails dev::StaticHelpers::querySwapChain(VkPhysicalDevice devi
 /***************************************************************************************************/
 
 VkPipeline dev::StaticHelpers::createPipeline(Context* context, 
-                                              const char* vert_path, 
-                                              const char* frag_path, 
-                                              VkPipelineLayout pipeline_layout, 
-                                              VkCullModeFlags cull_mode, 
-                                              VkBool32 depth_test,
-                                              uint8 vertex_desc)
+                                              VkPipelineCache pipeline_cache,
+                                              const PipelineDesc& desc,
+                                              VkPipeline base_pipeline)
 {
-  auto vertex_shader = dev::StaticHelpers::loadShader(vert_path);
-  auto fragment_shader = dev::StaticHelpers::loadShader(frag_path);
-
-  VkShaderModule vert_module = dev::StaticHelpers::createShaderModule(context->logDevice_, vertex_shader);
-  VkShaderModule frag_module = dev::StaticHelpers::createShaderModule(context->logDevice_, fragment_shader);
+  VkShaderModule vert_module = context->shaderCache.getModule(context->logDevice_, desc.vertPath);
+  bool depth_only = desc.fragPath == nullptr;
+  VkShaderModule frag_module = depth_only ? VK_NULL_HANDLE :
+                               context->shaderCache.getModule(context->logDevice_, desc.fragPath);
 
   VkPipelineShaderStageCreateInfo vertexShaderInfo{};
   vertexShaderInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -179,11 +175,15 @@ VkPipeline dev::StaticHelpers::createPipeline(Context* context,
   vertexShaderInfo.module = vert_module;
   vertexShaderInfo.pName = "main";
 
+  VkSpecializationMapEntry spec_entries[kMaxSpecConstants];
+  VkSpecializationInfo spec_info = specializationInfo(desc.specData, desc.specCount, spec_entries);
+
   VkPipelineShaderStageCreateInfo fragmentShaderInfo{};
   fragmentShaderInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   fragmentShaderInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   fragmentShaderInfo.module = frag_module;
   fragmentShaderInfo.pName = "main";
+  fragmentShaderInfo.pSpecializationInfo = desc.specCount ? &spec_info : nullptr;
 
   VkPipelineShaderStageCreateInfo shaderInfo[]{ vertexShaderInfo, fragmentShaderInfo };
 
@@ -193,7 +193,7 @@ VkPipeline dev::StaticHelpers::createPipeline(Context* context,
   vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
   vertexInputInfo.vertexBindingDescriptionCount = 1;
   vertexInputInfo.pVertexBindingDescriptions = &InternalVertexData::getBindingDescription();
-  std::vector<VkVertexInputAttributeDescription> attributeDescription = InternalVertexData::getAttributeDescription((VertexDescriptor)vertex_desc);
+  std::vector<VkVertexInputAttributeDescription> attributeDescription = InternalVertexData::getAttributeDescription((VertexDescriptor)desc.vertexDesc);
   vertexInputInfo.vertexAttributeDescriptionCount = attributeDescription.size();
   vertexInputInfo.pVertexAttributeDescriptions = attributeDescription.data();
 
@@ -204,35 +204,26 @@ VkPipeline dev::StaticHelpers::createPipeline(Context* context,
   inputAssembly.primitiveRestartEnable = VK_FALSE;
 
   /*Viewport and scissors*/
-  VkViewport viewport{};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = (float)context->swapchainDimensions.width;
-  viewport.height = (float)context->swapchainDimensions.height;
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  VkRect2D scissor{};
-  scissor.offset = { 0, 0 };
-  scissor.extent.width = context->swapchainDimensions.width;
-  scissor.extent.height = context->swapchainDimensions.height;
-
+  //Dynamic, the scene is drawn at the render scale of dynamic resolution
   VkPipelineViewportStateCreateInfo viewportState{};
   viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
   viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
+
+  VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+  VkPipelineDynamicStateCreateInfo dynamicState{};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = 2;
+  dynamicState.pDynamicStates = dynamicStates;
 
   /*Rasterizer*/
   VkPipelineRasterizationStateCreateInfo rasterizer{};
   rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
   rasterizer.depthClampEnable = VK_FALSE;
   rasterizer.rasterizerDiscardEnable = VK_FALSE;
-  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-                           //VK_POLYGON_MODE_LINE;
+  rasterizer.polygonMode = desc.polygonMode;
   rasterizer.lineWidth = 1.0f;
-  rasterizer.cullMode = cull_mode;
+  rasterizer.cullMode = desc.cullMode;
   rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 
   rasterizer.depthBiasEnable = VK_FALSE;
@@ -268,7 +259,7 @@ VkPipeline dev::StaticHelpers::createPipeline(Context* context,
   blendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
   blendState.logicOpEnable = VK_FALSE;
   blendState.logicOp = VK_LOGIC_OP_COPY;
-  blendState.attachmentCount = 1;
+  blendState.attachmentCount = depth_only ? 0 : 1;
   blendState.pAttachments = &blendAttachment;
   blendState.blendConstants[0] = 0.0f;
   blendState.blendConstants[1] = 0.0f;
@@ -277,9 +268,9 @@ VkPipeline dev::StaticHelpers::createPipeline(Context* context,
 
   VkPipelineDepthStencilStateCreateInfo depth_stencil{};
   depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-  depth_stencil.depthTestEnable = depth_test;
-  depth_stencil.depthWriteEnable = depth_test;
-  depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
+  depth_stencil.depthTestEnable = desc.depthTest;
+  depth_stencil.depthWriteEnable = desc.depthWrite;
+  depth_stencil.depthCompareOp = desc.depthCompare;
   depth_stencil.depthBoundsTestEnable = VK_FALSE;
   depth_stencil.minDepthBounds = 0.0f;
   depth_stencil.maxDepthBounds = 1.0f;
@@ -290,7 +281,7 @@ VkPipeline dev::StaticHelpers::createPipeline(Context* context,
 
   VkGraphicsPipelineCreateInfo pipelineInfo{};
   pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount = 2;
+  pipelineInfo.stageCount = depth_only ? 1 : 2;
   pipelineInfo.pStages = shaderInfo;
 
   pipelineInfo.pVertexInputState = &vertexInputInfo;
@@ -300,22 +291,64 @@ VkPipeline dev::StaticHelpers::createPipeline(Context* context,
   pipelineInfo.pMultisampleState = &multisampler;
   pipelineInfo.pDepthStencilState = &depth_stencil;
   pipelineInfo.pColorBlendState = &blendState;
-  pipelineInfo.pDynamicState = nullptr;
+  pipelineInfo.pDynamicState = &dynamicState;
 
-  pipelineInfo.layout = pipeline_layout;
+  pipelineInfo.layout = desc.layout;
 
-  pipelineInfo.renderPass = context->renderPass;
+  pipelineInfo.renderPass = depth_only ? context->depthRenderPass : context->renderPass;
   pipelineInfo.subpass = 0;
 
-  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+  pipelineInfo.flags = base_pipeline == VK_NULL_HANDLE ? VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT
+                                                      : VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+  pipelineInfo.basePipelineHandle = base_pipeline;
   pipelineInfo.basePipelineIndex = -1;
 
   VkPipeline new_pipeline;
-  assert(vkCreateGraphicsPipelines(context->logDevice_, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &new_pipeline) == VK_SUCCESS);
+  assert(vkCreateGraphicsPipelines(context->logDevice_, pipeline_cache, 1, &pipelineInfo, nullptr, &new_pipeline) == VK_SUCCESS);
   //vkCreateGraphicsPipelines(context->logDevice_, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &new_pipeline);
 
-  vkDestroyShaderModule(context->logDevice_, frag_module, nullptr);
-  vkDestroyShaderModule(context->logDevice_, vert_module, nullptr);
+  return new_pipeline;
+}
+
+/***************************************************************************************************/
+
+VkSpecializationInfo dev::StaticHelpers::specializationInfo(const void* data, uint32 count, VkSpecializationMapEntry* entries)
+{
+  for (uint32 i = 0; i < count; i++) {
+    entries[i].constantID = i;
+    entries[i].offset = i * sizeof(uint32);
+    entries[i].size = sizeof(uint32);
+  }
+
+  VkSpecializationInfo spec_info{};
+  spec_info.mapEntryCount = count;
+  spec_info.pMapEntries = entries;
+  spec_info.dataSize = count * sizeof(uint32);
+  spec_info.pData = data;
+  return spec_info;
+}
+
+/***************************************************************************************************/
+
+VkPipeline dev::StaticHelpers::createComputePipeline(Context* context, const char* comp_path, VkPipelineLayout pipeline_layout)
+{
+  VkShaderModule comp_module = context->shaderCache.getModule(context->logDevice_, comp_path);
+
+  VkPipelineShaderStageCreateInfo computeShaderInfo{};
+  computeShaderInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  computeShaderInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  computeShaderInfo.module = comp_module;
+  computeShaderInfo.pName = "main";
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage = computeShaderInfo;
+  pipelineInfo.layout = pipeline_layout;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+  pipelineInfo.basePipelineIndex = -1;
+
+  VkPipeline new_pipeline;
+  assert(vkCreateComputePipelines(context->logDevice_, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &new_pipeline) == VK_SUCCESS);
 
   return new_pipeline;
 }
@@ -518,9 +551,9 @@ VkWriteDescriptorSet dev::StaticHelpers::descriptorWriteInitializer(uint32 bindi
 
 /***************************************************************************************************/
 
+//The pipeline belongs to the pipeline state cache
 void dev::StaticHelpers::destroyMaterial(Context* context, InternalMaterial* material)
 {
-  vkDestroyPipeline(context->logDevice_, material->matPipeline, nullptr);
   for (auto& buffer : material->dynamicUniform) {
     buffer.destroyBuffer();
   }
@@ -10,6 +10,7 @@ struct SwapChainSupportDetails;
 struct Context;
 struct InternalMaterial;
 struct InternalTexture;
+struct PipelineDesc;
 class Texture;
 enum class TextureFormat;
 
@@ -32,13 +33,16 @@ namespace dev {
 
     SwapChainSupportDetails querySwapChain(VkPhysicalDevice device, VkSurfaceKHR surface);
 
+    //Without a base the pipeline allows derivatives, with one it is created as its derivative
     VkPipeline createPipeline(Context* context, 
-                              const char* vert_path, 
-                              const char* frag_path, 
-                              VkPipelineLayout pipeline_layout, 
-                              VkCullModeFlags cull_mode, 
-                              VkBool32 depth_test, 
-                              uint8 vertex_desc = 3);
+                              VkPipelineCache pipeline_cache,
+                              const PipelineDesc& desc,
+                              VkPipeline base_pipeline = VK_NULL_HANDLE);
+
+    //Consecutive 32 bit constants with constant_id 0..count - 1, entries must hold count elements
+    VkSpecializationInfo specializationInfo(const void* data, uint32 count, VkSpecializationMapEntry* entries);
+
+    VkPipeline createComputePipeline(Context* context, const char* comp_path, VkPipelineLayout pipeline_layout);
 
 
     VkFormat getTextureFormat(TextureFormat format);
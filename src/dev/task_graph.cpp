@@ -0,0 +1,173 @@
+#include "dev/task_graph.h"
+#include "dev/cpu_profiler.h"
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cassert>
+
+
+vkdev::TaskGraph::TaskGraph()
+{
+  remaining_ = 0;
+  for (uint32 i = 0; i < kTaskLaneCount; i++) {
+    laneBusy_[i] = false;
+    laneLast_[i] = -1;
+  }
+  start_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double vkdev::TaskGraph::elapsed()
+{
+  int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+  return (now - start_) / 1000000.0;
+}
+
+uint32 vkdev::TaskGraph::addTask(const char* name, TaskFunction function, std::initializer_list<uint32> dependencies,
+                                 int32 lane)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  Task task{};
+  task.name = name;
+  task.function = function;
+  task.lane = lane;
+  task.blocker = -1;
+  uint32 index = static_cast<uint32>(tasks_.size());
+  tasks_.push_back(task);
+
+  for (uint32 dependency : dependencies) {
+    if (tasks_[dependency].done) continue;
+    tasks_[dependency].dependents.push_back(index);
+    ++tasks_[index].pending;
+  }
+  if (tasks_[index].pending == 0) ready_.push_back(index);
+  ++remaining_;
+  condition_.notify_all();
+
+  return index;
+}
+
+void vkdev::TaskGraph::addDependency(uint32 task, uint32 dependency)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (tasks_[dependency].done) return;
+  //Only tasks that haven't been made ready can gain dependencies
+  assert(tasks_[task].pending > 0);
+  tasks_[dependency].dependents.push_back(task);
+  ++tasks_[task].pending;
+}
+
+bool vkdev::TaskGraph::popReady(uint32* task)
+{
+  for (uint32 i = 0; i < ready_.size(); i++) {
+    int32 lane = tasks_[ready_[i]].lane;
+    if (lane != kTaskLane_None && laneBusy_[lane]) continue;
+
+    *task = ready_[i];
+    ready_.erase(ready_.begin() + i);
+    if (lane != kTaskLane_None) laneBusy_[lane] = true;
+    return true;
+  }
+  return false;
+}
+
+void vkdev::TaskGraph::work(uint32 thread)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    uint32 index;
+    condition_.wait(lock, [this, &index]() { return remaining_ == 0 || error_ || popReady(&index); });
+    if (remaining_ == 0 || error_) return;
+
+    Task* task = &tasks_[index];
+    task->thread = thread;
+    task->begin = elapsed();
+    if (task->lane != kTaskLane_None) {
+      int32 previous = laneLast_[task->lane];
+      if (previous >= 0 && (task->blocker < 0 || tasks_[previous].end > tasks_[task->blocker].end)) {
+        task->blocker = previous;
+      }
+    }
+    TaskFunction function = task->function;
+    const char* name = task->name;
+    lock.unlock();
+
+    std::exception_ptr error;
+    try {
+      PROFILE_ZONE(name);
+      function();
+    }
+    catch (...) {
+      error = std::current_exception();
+    }
+
+    lock.lock();
+    //Tasks may have been added while this one ran, the vector can have moved
+    task = &tasks_[index];
+    task->end = elapsed();
+    task->done = true;
+    if (error && !error_) error_ = error;
+    if (task->lane != kTaskLane_None) {
+      laneBusy_[task->lane] = false;
+      laneLast_[task->lane] = index;
+    }
+
+    for (uint32 dependent : task->dependents) {
+      Task* next = &tasks_[dependent];
+      if (next->blocker < 0 || tasks_[next->blocker].end <= task->end) next->blocker = index;
+      if (--next->pending == 0) ready_.push_back(dependent);
+    }
+    --remaining_;
+    condition_.notify_all();
+  }
+}
+
+void vkdev::TaskGraph::run(uint32 thread_count)
+{
+  thread_count = std::max(thread_count, 1u);
+  std::vector<std::thread> threads;
+  for (uint32 i = 1; i < thread_count; i++) {
+    threads.push_back(std::thread(&TaskGraph::work, this, i));
+  }
+  work(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void vkdev::TaskGraph::report()
+{
+  double total = 0.0, busy = 0.0;
+  int32 last = -1;
+  printf("\nStartup tasks\n");
+  for (uint32 i = 0; i < tasks_.size(); i++) {
+    Task* task = &tasks_[i];
+    if (!task->done) continue;
+    printf("  %-28s thread %2u  start: %8.2f ms  time: %8.2f ms\n",
+           task->name, task->thread, task->begin, task->end - task->begin);
+    busy += task->end - task->begin;
+    if (task->end > total) {
+      total = task->end;
+      last = i;
+    }
+  }
+
+  std::vector<uint32> path;
+  for (int32 i = last; i >= 0; i = tasks_[i].blocker) {
+    path.push_back(i);
+  }
+  std::reverse(path.begin(), path.end());
+
+  printf("Critical path, %.2f ms of %.2f ms of task time\n", total, busy);
+  for (uint32 index : path) {
+    Task* task = &tasks_[index];
+    printf("  %-28s %8.2f ms\n", task->name, task->end - task->begin);
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef __VKDEV_TASK_GRAPH__
+#define __VKDEV_TASK_GRAPH__ 1
+
+#include "common_def.h"
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <initializer_list>
+
+//Tasks sharing a lane never run at the same time
+const int32 kTaskLane_None = -1;
+//Queue submissions, the single time command pool and the staging arena
+const int32 kTaskLane_Queue = 0;
+const uint32 kTaskLaneCount = 1;
+
+namespace vkdev {
+  //Work run on worker threads as soon as its dependencies are done. A running task can add new tasks,
+  //and dependencies to the tasks that wait on it, they are run by the same call to run
+  class TaskGraph {
+  public:
+    typedef std::function<void()> TaskFunction;
+
+    TaskGraph();
+    ~TaskGraph(){}
+
+    uint32 addTask(const char* name, TaskFunction function, std::initializer_list<uint32> dependencies = {},
+                   int32 lane = kTaskLane_None);
+    void addDependency(uint32 task, uint32 dependency);
+    //Blocks until every task is done, the calling thread runs tasks too.
+    //The first exception thrown by a task stops the graph and is rethrown here
+    void run(uint32 thread_count);
+    //Time of every task and the chain of tasks that bounded the total
+    void report();
+
+  private:
+    TaskGraph(const TaskGraph&);
+    struct Task {
+      //Literal, also the name of the profiler zone
+      const char* name;
+      TaskFunction function;
+      std::vector<uint32> dependents;
+      int32 lane;
+      uint32 pending;
+      bool done;
+      uint32 thread;
+      double begin, end;
+      //Task whose end let this one start, a dependency or the previous task of the lane
+      int32 blocker;
+    };
+
+    void work(uint32 thread);
+    bool popReady(uint32* task);
+    double elapsed();
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::vector<Task> tasks_;
+    std::vector<uint32> ready_;
+    uint32 remaining_;
+    bool laneBusy_[kTaskLaneCount];
+    int32 laneLast_[kTaskLaneCount];
+    std::exception_ptr error_;
+    int64_t start_;
+  };
+}
+
+#endif
@@ -0,0 +1,139 @@
+#include "dev/terrain_quadtree.h"
+#include <algorithm>
+
+
+vkdev::TerrainQuadtree::TerrainQuadtree()
+{
+  setSize(kTerrainSize);
+
+  camera_ = glm::vec3(0.0f);
+  height_ = 0.0f;
+  instance_ = 0;
+  nodes_.reserve(kMaxTerrainNodes);
+}
+
+void vkdev::TerrainQuadtree::setSize(uint32 size)
+{
+  rootLevel_ = 0;
+  while ((kTerrainPatchSize << rootLevel_) < size) ++rootLevel_;
+  size_ = kTerrainPatchSize << rootLevel_;
+
+  ranges_.resize(rootLevel_ + 1);
+  for (uint32 i = 0; i <= rootLevel_; i++) {
+    ranges_[i] = kTerrainLodRange * (float)(1 << i);
+  }
+}
+
+void vkdev::TerrainQuadtree::clear()
+{
+  nodes_.clear();
+}
+
+void vkdev::TerrainQuadtree::select(const glm::mat4& model, const glm::vec3& camera_position,
+                                    const glm::vec4* frustum_planes, float amplitude, uint32 instance)
+{
+  camera_ = glm::vec3(glm::inverse(model) * glm::vec4(camera_position, 1.0f));
+  //Planes as row vectors: p * (M * x) = (M^T * p) * x
+  glm::mat4 model_t = glm::transpose(model);
+  for (uint32 i = 0; i < 6; i++) {
+    planes_[i] = model_t * frustum_planes[i];
+  }
+  //Heights go from -amplitude / 2 to amplitude / 2, see noise.vert
+  height_ = amplitude * 0.5f;
+  instance_ = instance;
+
+  //Camera too far for the root range, the whole terrain uses the coarsest level
+  if (!selectNode(0.0f, 0.0f, rootLevel_)) {
+    float size = (float)(kTerrainPatchSize << rootLevel_);
+    if (insideFrustum(glm::vec3(0.0f, -height_, 0.0f), glm::vec3(size, height_, size))) {
+      addNode(0.0f, 0.0f, rootLevel_);
+    }
+  }
+}
+
+bool vkdev::TerrainQuadtree::selectNode(float x, float z, uint32 level)
+{
+  float size = (float)(kTerrainPatchSize << level);
+  glm::vec3 min = { x, -height_, z };
+  glm::vec3 max = { x + size, height_, z + size };
+
+  if (!inRange(min, max, ranges_[level])) return false;
+  //Outside the frustum, handled but nothing to draw
+  if (!insideFrustum(min, max)) return true;
+
+  if (level == 0 || !inRange(min, max, ranges_[level - 1])) {
+    addNode(x, z, level);
+    return true;
+  }
+
+  //Children out of their range are drawn at their size but fully morphed,
+  //which matches the resolution of this level
+  float half = size * 0.5f;
+  for (uint32 child = 0; child < 4; child++) {
+    float child_x = x + (child & 1) * half;
+    float child_z = z + (child >> 1) * half;
+    if (selectNode(child_x, child_z, level - 1)) continue;
+
+    glm::vec3 child_min = { child_x, -height_, child_z };
+    glm::vec3 child_max = { child_x + half, height_, child_z + half };
+    if (insideFrustum(child_min, child_max)) addNode(child_x, child_z, level - 1);
+  }
+
+  return true;
+}
+
+void vkdev::TerrainQuadtree::addNode(float x, float z, uint32 level)
+{
+  if (nodes_.size() >= kMaxTerrainNodes) return;
+
+  float morph_end = ranges_[level];
+  float previous = level ? ranges_[level - 1] : 0.0f;
+  float morph_start = previous + (morph_end - previous) * kTerrainMorphStart;
+
+  TerrainPatch patch;
+  patch.constants.node = glm::vec4(x, z, (float)(1 << level), 1.0f / (float)size_);
+  patch.constants.morph = glm::vec4(morph_start, morph_end, 1.0f / (morph_end - morph_start), 0.0f);
+  patch.constants.camera = glm::vec4(camera_, 0.0f);
+  patch.instance = instance_;
+  nodes_.push_back(patch);
+}
+
+bool vkdev::TerrainQuadtree::inRange(const glm::vec3& min, const glm::vec3& max, float range)
+{
+  glm::vec3 closest = glm::clamp(camera_, min, max);
+  glm::vec3 offset = closest - camera_;
+  return glm::dot(offset, offset) <= range * range;
+}
+
+bool vkdev::TerrainQuadtree::insideFrustum(const glm::vec3& min, const glm::vec3& max)
+{
+  //Corner farthest along the plane normal
+  for (uint32 i = 0; i < 6; i++) {
+    glm::vec3 corner = { planes_[i].x >= 0.0f ? max.x : min.x,
+                         planes_[i].y >= 0.0f ? max.y : min.y,
+                         planes_[i].z >= 0.0f ? max.z : min.z };
+    if (glm::dot(glm::vec3(planes_[i]), corner) + planes_[i].w < 0.0f) return false;
+  }
+
+  return true;
+}
+
+uint32 vkdev::TerrainQuadtree::getNodeCount()
+{
+  return static_cast<uint32>(nodes_.size());
+}
+
+const TerrainPatch& vkdev::TerrainQuadtree::getNode(uint32 index)
+{
+  return nodes_[index];
+}
+
+TerrainConstants vkdev::TerrainQuadtree::meshConstants()
+{
+  TerrainConstants constants;
+  constants.node = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+  constants.morph = glm::vec4(0.0f);
+  constants.camera = glm::vec4(0.0f);
+
+  return constants;
+}
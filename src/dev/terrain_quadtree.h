@@ -0,0 +1,69 @@
+#ifndef __VKDEV_TERRAIN_QUADTREE__
+#define __VKDEV_TERRAIN_QUADTREE__ 1
+
+#include "glm/glm.hpp"
+#include "common_def.h"
+
+//Cells per side of the shared grid patch and of the default terrain
+const uint32 kTerrainPatchSize = 32;
+const uint32 kTerrainSize = 2048;
+//Distance covered by the finest level, doubled on every level above
+const float kTerrainLodRange = 96.0f;
+//Fraction of a level range where the vertices start morphing to the next level
+const float kTerrainMorphStart = 0.7f;
+//Bounds the vertex count: kMaxTerrainNodes * (kTerrainPatchSize + 1)^2
+const uint32 kMaxTerrainNodes = 512;
+
+//Push constants of the noise pipeline, same layout as TerrainNode in noise.vert
+struct TerrainConstants {
+  //xy: patch origin, z: cell size, w: 1 / terrain size (0 for regular meshes)
+  glm::vec4 node;
+  //x: morph start, y: morph end, z: 1 / (end - start)
+  glm::vec4 morph;
+  //xyz: camera position in terrain space
+  glm::vec4 camera;
+};
+
+struct TerrainPatch {
+  TerrainConstants constants;
+  uint32 instance;
+};
+
+namespace vkdev {
+  //CDLOD quadtree, every selected node is drawn with the same grid patch.
+  //Selection and culling are done in terrain space
+  class TerrainQuadtree {
+  public:
+    TerrainQuadtree();
+    ~TerrainQuadtree(){}
+
+    //Cells per side covered by the root, rounded up to the patch size times a power of two
+    void setSize(uint32 size);
+    void clear();
+    void select(const glm::mat4& model, const glm::vec3& camera_position, const glm::vec4* frustum_planes,
+                float amplitude, uint32 instance);
+    uint32 getNodeCount();
+    const TerrainPatch& getNode(uint32 index);
+
+    //Constants for meshes drawn with the noise material that aren't the terrain
+    static TerrainConstants meshConstants();
+
+  private:
+    TerrainQuadtree(const TerrainQuadtree&);
+    bool selectNode(float x, float z, uint32 level);
+    void addNode(float x, float z, uint32 level);
+    bool inRange(const glm::vec3& min, const glm::vec3& max, float range);
+    bool insideFrustum(const glm::vec3& min, const glm::vec3& max);
+
+    uint32 rootLevel_;
+    uint32 size_;
+    std::vector<float> ranges_;
+    glm::vec4 planes_[6];
+    glm::vec3 camera_;
+    float height_;
+    uint32 instance_;
+    std::vector<TerrainPatch> nodes_;
+  };
+}
+
+#endif
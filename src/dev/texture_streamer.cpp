@@ -0,0 +1,580 @@
+#include "dev/texture_streamer.h"
+#include "dev/buffer.h"
+#include "internal.h"
+#include "static_helpers.h"
+#include "ktxvulkan.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <cstring>
+
+const uint32 kNoSlot = 0xFFFFFFFF;
+
+
+static bool isKtxPath(const std::string& path)
+{
+  return path.size() > 4 && path.compare(path.size() - 4, 4, ".ktx") == 0;
+}
+
+static bool isRGBA8(VkFormat format)
+{
+  return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+static uint32 getLevelSide(uint32 side, uint32 level)
+{
+  return std::max(side >> level, 1u);
+}
+
+//2x2 box filter of a rgba8 level, odd sides repeat their last texel
+static void downsample(const uint8* src, uint32 width, uint32 height, uint8* dst)
+{
+  uint32 dst_width = std::max(width / 2, 1u);
+  uint32 dst_height = std::max(height / 2, 1u);
+  for (uint32 y = 0; y < dst_height; y++) {
+    size_t row0 = (size_t)std::min(y * 2, height - 1) * width;
+    size_t row1 = (size_t)std::min(y * 2 + 1, height - 1) * width;
+    for (uint32 x = 0; x < dst_width; x++) {
+      uint32 x0 = std::min(x * 2, width - 1);
+      uint32 x1 = std::min(x * 2 + 1, width - 1);
+      for (uint32 c = 0; c < 4; c++) {
+        uint32 sum = src[(row0 + x0) * 4 + c] + src[(row0 + x1) * 4 + c] +
+                     src[(row1 + x0) * 4 + c] + src[(row1 + x1) * 4 + c];
+        dst[((size_t)y * dst_width + x) * 4 + c] = (uint8)((sum + 2) / 4);
+      }
+    }
+  }
+}
+
+
+vkdev::TextureStreamer::TextureStreamer()
+{
+  context_ = nullptr;
+  bindlessSet_ = VK_NULL_HANDLE;
+  streaming_ = false;
+  frame_ = 0;
+  retireFrames_ = 1;
+  budget_ = kTextureStreamBudget;
+  residentBytes_ = 0;
+  exit_ = false;
+}
+
+void vkdev::TextureStreamer::create(Context* context, uint32 texture_count, uint32 image_count)
+{
+  context_ = context;
+  streaming_ = true;
+  frame_ = 0;
+  //The frame retiring an image still draws with it
+  retireFrames_ = image_count + 1;
+  residentBytes_ = 0;
+  streamedIndex_.assign(texture_count, -1);
+
+  exit_ = false;
+  loader_ = std::thread(&TextureStreamer::loadLevels, this);
+}
+
+void vkdev::TextureStreamer::setBindlessSet(VkDescriptorSet bindless_set, uint32 slot_count)
+{
+  bindlessSet_ = bindless_set;
+  freeSlots_.clear();
+  for (uint32 slot = slot_count; slot > streamedIndex_.size(); slot--) {
+    freeSlots_.push_back(slot - 1);
+  }
+}
+
+void vkdev::TextureStreamer::destroy()
+{
+  if (!context_) return;
+
+  if (loader_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exit_ = true;
+    }
+    condition_.notify_all();
+    loader_.join();
+  }
+  requests_.clear();
+  loaded_.clear();
+
+  //Current images belong to the textures and are destroyed with them
+  releaseRetired(true);
+  textures_.clear();
+  streamedIndex_.clear();
+  freeSlots_.clear();
+  streaming_ = false;
+  context_ = nullptr;
+}
+
+/*******************************************************************************/
+
+bool vkdev::TextureStreamer::readLevels(const std::string& path, uint32 first, uint32 last,
+                                        std::vector<uint8>& data, std::vector<VkDeviceSize>& offsets)
+{
+  std::vector<uint8> level;
+  uint32 width, height;
+  if (isKtxPath(path)) {
+    ktxTexture* ktx_texture;
+    if (ktxTexture_CreateFromNamedFile(path.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktx_texture) != KTX_SUCCESS) {
+      return false;
+    }
+
+    ktx_uint8_t* ktx_data = ktxTexture_GetData(ktx_texture);
+    //Stored levels are copied as they are
+    if (ktx_texture->numLevels > 1 || ktx_texture->isCompressed) {
+      bool valid = last <= ktx_texture->numLevels;
+      for (uint32 i = first; valid && i < last; i++) {
+        ktx_size_t offset;
+        ktxTexture_GetImageOffset(ktx_texture, i, 0, 0, &offset);
+        ktx_size_t size = ktxTexture_GetImageSize(ktx_texture, i);
+        offsets.push_back(data.size());
+        data.insert(data.end(), ktx_data + offset, ktx_data + offset + size);
+      }
+      ktxTexture_Destroy(ktx_texture);
+      return valid;
+    }
+
+    width = ktx_texture->baseWidth;
+    height = ktx_texture->baseHeight;
+    level.assign(ktx_data, ktx_data + ktxTexture_GetImageSize(ktx_texture, 0));
+    ktxTexture_Destroy(ktx_texture);
+  }
+  else {
+    int32 tex_width, tex_height, tex_channels;
+    stbi_uc* pixels = stbi_load(path.c_str(), &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
+    if (!pixels) return false;
+
+    width = tex_width;
+    height = tex_height;
+    level.assign(pixels, pixels + (size_t)width * height * 4);
+    stbi_image_free(pixels);
+  }
+
+  //Generated chain, each level is filtered from the previous one
+  std::vector<uint8> next;
+  for (uint32 i = 0; i < last; i++) {
+    if (i >= first) {
+      offsets.push_back(data.size());
+      data.insert(data.end(), level.begin(), level.end());
+    }
+    if (i + 1 == last) break;
+
+    next.resize((size_t)getLevelSide(width, i + 1) * getLevelSide(height, i + 1) * 4);
+    downsample(level.data(), getLevelSide(width, i), getLevelSide(height, i), next.data());
+    level.swap(next);
+  }
+
+  return true;
+}
+
+bool vkdev::TextureStreamer::addTexture(uint32 id, VkTexture* texture, const char* path, VkFormat format)
+{
+  if (!streaming_ || id >= streamedIndex_.size()) return false;
+
+  StreamedTexture streamed{};
+  streamed.id = id;
+  streamed.texture = texture;
+  streamed.path = path;
+  streamed.format = format;
+
+  bool generated = true;
+  if (isKtxPath(streamed.path)) {
+    ktxTexture* ktx_texture;
+    if (ktxTexture_CreateFromNamedFile(path, KTX_TEXTURE_CREATE_NO_FLAGS, &ktx_texture) != KTX_SUCCESS) return false;
+
+    streamed.format = VkTexture::getKtxFormat(ktx_texture->glInternalformat, format);
+    streamed.width = ktx_texture->baseWidth;
+    streamed.height = ktx_texture->baseHeight;
+    generated = ktx_texture->numLevels == 1 && !ktx_texture->isCompressed;
+    if (!generated) {
+      streamed.levelCount = ktx_texture->numLevels;
+      for (uint32 i = 0; i < streamed.levelCount; i++) {
+        streamed.levelBytes.push_back(ktxTexture_GetImageSize(ktx_texture, i));
+      }
+    }
+    ktxTexture_Destroy(ktx_texture);
+  }
+  else {
+    int32 tex_width, tex_height, tex_channels;
+    if (!stbi_info(path, &tex_width, &tex_height, &tex_channels)) return false;
+    streamed.width = tex_width;
+    streamed.height = tex_height;
+  }
+
+  //Generated chains are filtered on the CPU as rgba8
+  if (generated) {
+    if (!isRGBA8(streamed.format)) return false;
+    streamed.levelCount = static_cast<uint32>(floor(log2(std::max(streamed.width, streamed.height)))) + 1;
+    for (uint32 i = 0; i < streamed.levelCount; i++) {
+      streamed.levelBytes.push_back((VkDeviceSize)getLevelSide(streamed.width, i) *
+                                    getLevelSide(streamed.height, i) * 4);
+    }
+  }
+
+  VkFormatProperties format_properties;
+  vkGetPhysicalDeviceFormatProperties(context_->physDevice_, streamed.format, &format_properties);
+  if (!(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) return false;
+
+  streamed.tailLevel = 0;
+  while (streamed.tailLevel + 1 < streamed.levelCount &&
+         std::max(getLevelSide(streamed.width, streamed.tailLevel),
+                  getLevelSide(streamed.height, streamed.tailLevel)) > kTextureStreamTailSize) {
+    ++streamed.tailLevel;
+  }
+  streamed.residentLevel = streamed.levelCount;
+  streamed.frameLevel = streamed.levelCount;
+  streamed.wantedLevel = streamed.tailLevel;
+  streamed.pendingLevel = streamed.levelCount;
+  streamed.failed = false;
+  streamed.lastUsed = 0;
+  streamed.slot = id;
+
+  LoadedLevels loaded;
+  loaded.index = static_cast<uint32>(textures_.size());
+  loaded.first = streamed.tailLevel;
+  loaded.last = streamed.levelCount;
+  if (!readLevels(streamed.path, loaded.first, loaded.last, loaded.data, loaded.offsets)) return false;
+
+  //The sampler covers the whole chain and is kept by every image of the texture
+  texture->device_ = context_->logDevice_;
+  texture->sampler_ = dev::StaticHelpers::createTextureSampler(context_,
+                                                               VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                                                               VK_COMPARE_OP_ALWAYS,
+                                                               streamed.levelCount,
+                                                               VK_BORDER_COLOR_INT_OPAQUE_BLACK);
+
+  textures_.push_back(streamed);
+  streamedIndex_[id] = static_cast<int32>(loaded.index);
+
+  VkCommandBuffer cmd_buffer = dev::StaticHelpers::beginSingleTimeCommands(context_);
+  swapLevels(cmd_buffer, &textures_.back(), loaded.first, &loaded);
+  dev::StaticHelpers::endSingleTimeCommands(context_, cmd_buffer);
+  //Queue is idle, the staging buffer can go now
+  releaseRetired(true);
+
+  return true;
+}
+
+/*******************************************************************************/
+
+bool vkdev::TextureStreamer::isStreaming()
+{
+  return streaming_;
+}
+
+void vkdev::TextureStreamer::setBudget(VkDeviceSize bytes)
+{
+  budget_ = bytes;
+}
+
+VkDeviceSize vkdev::TextureStreamer::getResidentBytes()
+{
+  return residentBytes_;
+}
+
+uint32 vkdev::TextureStreamer::getSlot(uint32 id)
+{
+  if (!streaming_ || id >= streamedIndex_.size() || streamedIndex_[id] < 0) return id;
+  return textures_[streamedIndex_[id]].slot;
+}
+
+void vkdev::TextureStreamer::requestSize(uint32 id, float screen_pixels)
+{
+  if (!streaming_ || id >= streamedIndex_.size() || streamedIndex_[id] < 0) return;
+
+  //One texel per pixel across the largest side
+  StreamedTexture* streamed = &textures_[streamedIndex_[id]];
+  float side = static_cast<float>(std::max(streamed->width, streamed->height));
+  uint32 level = 0;
+  if (screen_pixels < side) {
+    level = static_cast<uint32>(floor(log2(side / std::max(screen_pixels, 1.0f))));
+  }
+  streamed->frameLevel = std::min(streamed->frameLevel, std::min(level, streamed->tailLevel));
+}
+
+/*******************************************************************************/
+
+void vkdev::TextureStreamer::loadLevels()
+{
+  PROFILE_THREAD("texture loader");
+  while (true) {
+    LoadRequest request;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return exit_ || !requests_.empty(); });
+      if (exit_) return;
+      request = std::move(requests_.front());
+      requests_.pop_front();
+    }
+
+    //Without offsets the load failed and the texture keeps its levels
+    PROFILE_ZONE("load texture levels");
+    LoadedLevels loaded;
+    loaded.index = request.index;
+    loaded.first = request.first;
+    loaded.last = request.last;
+    if (!readLevels(request.path, request.first, request.last, loaded.data, loaded.offsets)) {
+      loaded.data.clear();
+      loaded.offsets.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    loaded_.push_back(std::move(loaded));
+  }
+}
+
+VkDeviceSize vkdev::TextureStreamer::getLevelBytes(const StreamedTexture* streamed, uint32 first)
+{
+  VkDeviceSize bytes = 0;
+  for (uint32 i = first; i < streamed->levelCount; i++) {
+    bytes += streamed->levelBytes[i];
+  }
+  return bytes;
+}
+
+bool vkdev::TextureStreamer::swapLevels(VkCommandBuffer cmd_buffer, StreamedTexture* streamed, uint32 first, const LoadedLevels* loaded)
+{
+  VkTexture* texture = streamed->texture;
+  uint32 old_first = streamed->residentLevel;
+  bool has_old = old_first < streamed->levelCount;
+  //The old image stays bound to its slot until no frame uses it
+  if (has_old && freeSlots_.empty()) return false;
+
+  VkTexture next;
+  next.device_ = context_->logDevice_;
+  next.width_ = getLevelSide(streamed->width, first);
+  next.height_ = getLevelSide(streamed->height, first);
+  next.mipLevels_ = streamed->levelCount - first;
+  next.createImage(context_->physDevice_, streamed->format,
+                   VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                   1, 0);
+  next.view_ = dev::StaticHelpers::createTextureImageView(context_->logDevice_, next.image_, streamed->format,
+                                                          VK_IMAGE_VIEW_TYPE_2D, next.mipLevels_, 1,
+                                                          VK_IMAGE_ASPECT_COLOR_BIT);
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(context_->logDevice_, next.image_, &requirements);
+
+  VkImageSubresourceRange subresource_range{};
+  subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  subresource_range.baseMipLevel = 0;
+  subresource_range.levelCount = next.mipLevels_;
+  subresource_range.layerCount = 1;
+  next.setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_range,
+                      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+  Retired retired{};
+  retired.frame = frame_;
+  retired.slot = kNoSlot;
+
+  if (loaded) {
+    Buffer staging_buffer;
+    staging_buffer.createBuffer(context_, loaded->data.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    void* data;
+    vkMapMemory(context_->logDevice_, staging_buffer.memory_, 0, loaded->data.size(), 0, &data);
+    memcpy(data, loaded->data.data(), loaded->data.size());
+    vkUnmapMemory(context_->logDevice_, staging_buffer.memory_);
+
+    std::vector<VkBufferImageCopy> copy_regions;
+    for (uint32 level = first; level < loaded->last; level++) {
+      VkBufferImageCopy region{};
+      region.bufferOffset = loaded->offsets[level - loaded->first];
+      region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - first, 0, 1 };
+      region.imageExtent = { getLevelSide(streamed->width, level), getLevelSide(streamed->height, level), 1 };
+      copy_regions.push_back(region);
+    }
+    vkCmdCopyBufferToImage(cmd_buffer, staging_buffer.buffer_, next.image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32>(copy_regions.size()), copy_regions.data());
+
+    //Released with the old image, the copy is still pending
+    retired.buffer = staging_buffer.buffer_;
+    retired.bufferMemory = staging_buffer.memory_;
+    staging_buffer.buffer_ = VK_NULL_HANDLE;
+  }
+
+  if (has_old) {
+    VkImageSubresourceRange old_range = subresource_range;
+    old_range.levelCount = texture->mipLevels_;
+    texture->setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            old_range, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    std::vector<VkImageCopy> copy_regions;
+    for (uint32 level = std::max(first, old_first); level < streamed->levelCount; level++) {
+      VkImageCopy region{};
+      region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - old_first, 0, 1 };
+      region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - first, 0, 1 };
+      region.extent = { getLevelSide(streamed->width, level), getLevelSide(streamed->height, level), 1 };
+      copy_regions.push_back(region);
+    }
+    vkCmdCopyImage(cmd_buffer, texture->image_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   next.image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   static_cast<uint32>(copy_regions.size()), copy_regions.data());
+
+    //Draws recorded for this frame still sample the old slot
+    texture->setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                            old_range, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    retired.slot = streamed->slot;
+    retired.image = texture->image_;
+    retired.view = texture->view_;
+    retired.memory = texture->memory_;
+    residentBytes_ -= streamed->memoryBytes;
+  }
+
+  next.setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                      subresource_range, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+  texture->image_ = next.image_;
+  texture->view_ = next.view_;
+  texture->memory_ = next.memory_;
+  texture->width_ = next.width_;
+  texture->height_ = next.height_;
+  texture->mipLevels_ = next.mipLevels_;
+  texture->layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  texture->descriptor_ = { texture->sampler_, texture->view_, texture->layout_ };
+  //Handles now belong to the texture
+  next.device_ = VK_NULL_HANDLE;
+
+  streamed->residentLevel = first;
+  streamed->memoryBytes = requirements.size;
+  residentBytes_ += requirements.size;
+
+  if (has_old) {
+    streamed->slot = freeSlots_.back();
+    freeSlots_.pop_back();
+    writeSlot(streamed);
+  }
+  if (retired.image || retired.buffer) {
+    retired_.push_back(retired);
+  }
+
+  return true;
+}
+
+void vkdev::TextureStreamer::writeSlot(StreamedTexture* streamed)
+{
+  VkWriteDescriptorSet write = dev::StaticHelpers::descriptorWriteInitializer(0,
+                                          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                                     bindlessSet_,
+                                                     &streamed->texture->descriptor_);
+  write.dstArrayElement = streamed->slot;
+  vkUpdateDescriptorSets(context_->logDevice_, 1, &write, 0, nullptr);
+}
+
+void vkdev::TextureStreamer::releaseRetired(bool all)
+{
+  VkDevice device = context_->logDevice_;
+  while (!retired_.empty() && (all || retired_.front().frame + retireFrames_ <= frame_)) {
+    Retired* retired = &retired_.front();
+    if (retired->image) {
+      vkDestroyImageView(device, retired->view, nullptr);
+      vkDestroyImage(device, retired->image, nullptr);
+      vkFreeMemory(device, retired->memory, nullptr);
+    }
+    if (retired->buffer) {
+      vkDestroyBuffer(device, retired->buffer, nullptr);
+      vkFreeMemory(device, retired->bufferMemory, nullptr);
+    }
+    if (retired->slot != kNoSlot) {
+      freeSlots_.push_back(retired->slot);
+    }
+    retired_.pop_front();
+  }
+}
+
+int32 vkdev::TextureStreamer::findEvictable()
+{
+  //Least recently used texture holding levels above the ones it wants
+  int32 evictable = -1;
+  for (uint32 i = 0; i < textures_.size(); i++) {
+    StreamedTexture* streamed = &textures_[i];
+    if (streamed->residentLevel >= streamed->wantedLevel ||
+        streamed->residentLevel >= streamed->tailLevel ||
+        streamed->pendingLevel < streamed->levelCount) continue;
+    if (evictable < 0 || streamed->lastUsed < textures_[evictable].lastUsed) {
+      evictable = static_cast<int32>(i);
+    }
+  }
+  return evictable;
+}
+
+void vkdev::TextureStreamer::update(VkCommandBuffer cmd_buffer)
+{
+  if (!streaming_) return;
+  ++frame_;
+  releaseRetired(false);
+
+  for (auto& streamed : textures_) {
+    if (streamed.frameLevel < streamed.levelCount) {
+      streamed.wantedLevel = streamed.frameLevel;
+      streamed.lastUsed = frame_;
+    }
+    else {
+      streamed.wantedLevel = streamed.tailLevel;
+    }
+    streamed.frameLevel = streamed.levelCount;
+  }
+
+  //Loads finished since the last frame, dropped if the texture changed meanwhile
+  uint32 uploads = 0;
+  while (uploads < kTextureUploadsPerFrame) {
+    LoadedLevels loaded;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (loaded_.empty()) break;
+      loaded = std::move(loaded_.front());
+      loaded_.pop_front();
+    }
+
+    StreamedTexture* streamed = &textures_[loaded.index];
+    streamed->pendingLevel = streamed->levelCount;
+    if (loaded.offsets.empty()) {
+      streamed->failed = true;
+      continue;
+    }
+    if (loaded.last != streamed->residentLevel) continue;
+    if (swapLevels(cmd_buffer, streamed, loaded.first, &loaded)) ++uploads;
+  }
+
+  //Past the budget the highest level of the least recently used textures goes first
+  uint32 evictions = 0;
+  while (residentBytes_ > budget_ && evictions < kTextureEvictionsPerFrame) {
+    int32 evictable = findEvictable();
+    if (evictable < 0) break;
+    StreamedTexture* streamed = &textures_[evictable];
+    if (!swapLevels(cmd_buffer, streamed, streamed->residentLevel + 1, nullptr)) break;
+    ++evictions;
+  }
+
+  //Largest missing ranges are requested first, as far as the budget allows
+  VkDeviceSize reserved = residentBytes_;
+  std::vector<StreamedTexture*> missing;
+  for (auto& streamed : textures_) {
+    if (streamed.pendingLevel < streamed.levelCount) {
+      reserved += getLevelBytes(&streamed, streamed.pendingLevel) - getLevelBytes(&streamed, streamed.residentLevel);
+    }
+    else if (!streamed.failed && streamed.wantedLevel < streamed.residentLevel) {
+      missing.push_back(&streamed);
+    }
+  }
+  std::sort(missing.begin(), missing.end(), [](const StreamedTexture* a, const StreamedTexture* b) {
+    return a->residentLevel - a->wantedLevel > b->residentLevel - b->wantedLevel;
+  });
+
+  bool requested = false;
+  for (auto streamed : missing) {
+    VkDeviceSize resident_bytes = getLevelBytes(streamed, streamed->residentLevel);
+    uint32 level = streamed->wantedLevel;
+    while (level < streamed->residentLevel &&
+           reserved + getLevelBytes(streamed, level) - resident_bytes > budget_) {
+      ++level;
+    }
+    if (level == streamed->residentLevel) continue;
+
+    reserved += getLevelBytes(streamed, level) - resident_bytes;
+    streamed->pendingLevel = level;
+    std::lock_guard<std::mutex> lock(mutex_);
+    requests_.push_back({ static_cast<uint32>(streamed - textures_.data()), level, streamed->residentLevel, streamed->path });
+    requested = true;
+  }
+  if (requested) condition_.notify_one();
+}
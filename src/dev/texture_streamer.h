@@ -0,0 +1,132 @@
+#ifndef __VKDEV_TEXTURE_STREAMER__
+#define __VKDEV_TEXTURE_STREAMER__ 1
+
+#include "common_def.h"
+#include "dev/vktexture.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <string>
+
+//Levels with a side up to this size are loaded up front and never evicted
+const uint32 kTextureStreamTailSize = 64;
+//Default bytes of device memory for the streamed textures, see setBudget
+const VkDeviceSize kTextureStreamBudget = 256ull * 1024ull * 1024ull;
+const uint32 kTextureUploadsPerFrame = 2;
+//Levels dropped per frame while over budget
+const uint32 kTextureEvictionsPerFrame = 4;
+
+struct Context;
+namespace vkdev {
+  //Streams the mip levels of the 2D textures in the bindless array. Textures start with their
+  //mip tail, the screen size of the objects using them decides the highest level wanted, a loader
+  //thread decodes the missing levels and the render thread swaps in a new image with them.
+  //Past the budget the highest levels of the least recently used textures are dropped.
+  //A new image takes a free slot of the bindless array, the old one is released once no frame uses it
+  class TextureStreamer {
+  public:
+    TextureStreamer();
+    ~TextureStreamer(){}
+
+    void create(Context* context, uint32 texture_count, uint32 image_count);
+    void destroy();
+    //Elements past the texture ids are free slots for the new images
+    void setBindlessSet(VkDescriptorSet bindless_set, uint32 slot_count);
+
+    //Loads the mip tail of a stb or ktx image into the texture, returns false when
+    //the file cannot be streamed and has to be fully loaded instead
+    bool addTexture(uint32 id, VkTexture* texture, const char* path, VkFormat format);
+
+    bool isStreaming();
+    void setBudget(VkDeviceSize bytes);
+    VkDeviceSize getResidentBytes();
+    //Element of the bindless array holding the current image of the texture
+    uint32 getSlot(uint32 id);
+
+    //Feedback of one draw, side of the object on screen in pixels
+    void requestSize(uint32 id, float screen_pixels);
+    //Swaps in the levels loaded since the last frame, evicts past the budget and
+    //requests the levels wanted this frame
+    void update(VkCommandBuffer cmd_buffer);
+
+  private:
+    TextureStreamer(const TextureStreamer&);
+    struct StreamedTexture {
+      uint32 id;
+      VkTexture* texture;
+      std::string path;
+      VkFormat format;
+      uint32 width, height;
+      uint32 levelCount;
+      //First level of the tail that is never evicted
+      uint32 tailLevel;
+      //Resident levels are [residentLevel, levelCount)
+      uint32 residentLevel;
+      //Highest level requested this frame, levelCount when not drawn
+      uint32 frameLevel;
+      uint32 wantedLevel;
+      //Level being loaded, levelCount when nothing is pending
+      uint32 pendingLevel;
+      bool failed;
+      uint64_t lastUsed;
+      uint32 slot;
+      VkDeviceSize memoryBytes;
+      std::vector<VkDeviceSize> levelBytes;
+    };
+    struct LoadRequest {
+      uint32 index;
+      uint32 first, last;
+      std::string path;
+    };
+    struct LoadedLevels {
+      uint32 index;
+      uint32 first, last;
+      std::vector<uint8> data;
+      std::vector<VkDeviceSize> offsets;
+    };
+    struct Retired {
+      uint64_t frame;
+      uint32 slot;
+      VkImage image;
+      VkImageView view;
+      VkDeviceMemory memory;
+      VkBuffer buffer;
+      VkDeviceMemory bufferMemory;
+    };
+
+    static bool readLevels(const std::string& path, uint32 first, uint32 last,
+                           std::vector<uint8>& data, std::vector<VkDeviceSize>& offsets);
+    void loadLevels();
+    VkDeviceSize getLevelBytes(const StreamedTexture* streamed, uint32 first);
+    //Replaces the image of the texture by one holding [first, levelCount), levels already
+    //resident are copied from the old image and the rest come from the loaded data
+    bool swapLevels(VkCommandBuffer cmd_buffer, StreamedTexture* streamed, uint32 first, const LoadedLevels* loaded);
+    void writeSlot(StreamedTexture* streamed);
+    void releaseRetired(bool all);
+    int32 findEvictable();
+
+    Context* context_;
+    VkDescriptorSet bindlessSet_;
+    bool streaming_;
+    uint64_t frame_;
+    uint32 retireFrames_;
+    VkDeviceSize budget_;
+    VkDeviceSize residentBytes_;
+
+    std::vector<StreamedTexture> textures_;
+    std::vector<int32> streamedIndex_;
+    std::vector<uint32> freeSlots_;
+    std::deque<Retired> retired_;
+
+    //Shared with the loader thread
+    std::thread loader_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool exit_;
+    std::deque<LoadRequest> requests_;
+    std::deque<LoadedLevels> loaded_;
+  };
+}
+
+#endif
@@ -1,14 +1,59 @@
 #include <stdexcept>
 #include "dev/vktexture.h"
 #include "ktxvulkan.h"
-#include <fstream>
 #include "dev/buffer.h"
 #include "internal.h"
 #include "static_helpers.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include <algorithm>
+#include <cstring>
 
 
+VkFormat vkdev::VkTexture::getKtxFormat(uint32 gl_internal_format, VkFormat fallback)
+{
+  switch (gl_internal_format) {
+    case 0x8058: return VK_FORMAT_R8G8B8A8_UNORM;
+    case 0x8C43: return VK_FORMAT_R8G8B8A8_SRGB;
+    case 0x83F0: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case 0x83F1: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case 0x83F2: return VK_FORMAT_BC2_UNORM_BLOCK;
+    case 0x83F3: return VK_FORMAT_BC3_UNORM_BLOCK;
+    case 0x8C4C: return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    case 0x8C4D: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    case 0x8C4E: return VK_FORMAT_BC2_SRGB_BLOCK;
+    case 0x8C4F: return VK_FORMAT_BC3_SRGB_BLOCK;
+    case 0x8DBB: return VK_FORMAT_BC4_UNORM_BLOCK;
+    case 0x8DBD: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case 0x8E8C: return VK_FORMAT_BC7_UNORM_BLOCK;
+    case 0x8E8D: return VK_FORMAT_BC7_SRGB_BLOCK;
+    case 0x9274: return VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;
+    case 0x9275: return VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK;
+    case 0x9278: return VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+    case 0x9279: return VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK;
+    default: return fallback;
+  }
+}
+
+//Image data is read from the file by the ktx stream straight into the staging arena,
+//there is no copy of it on the heap
+static ktxTexture* loadKtxToStaging(Context* context, const char* filepath)
+{
+  ktxTexture* ktx_texture;
+  if (ktxTexture_CreateFromNamedFile(filepath, KTX_TEXTURE_CREATE_NO_FLAGS, &ktx_texture) != KTX_SUCCESS) {
+    throw std::runtime_error("\nFailed to load ktx texture");
+  }
+
+  ktx_size_t data_size = ktxTexture_GetSize(ktx_texture);
+  void* staging = context->stagingArena.acquire(context, data_size);
+  if (ktxTexture_LoadImageData(ktx_texture, (ktx_uint8_t*)staging, data_size) != KTX_SUCCESS) {
+    ktxTexture_Destroy(ktx_texture);
+    throw std::runtime_error("\nFailed to read ktx image data");
+  }
+
+  return ktx_texture;
+}
+
 vkdev::VkTexture::VkTexture()
 {
   width_ = 0;
@@ -29,29 +74,12 @@ vkdev::VkTexture::~VkTexture()
 
 void vkdev::VkTexture::loadCubemapKtx(Context* context, const char* filepath, VkFormat format, uint32 layer_count, VkImageCreateFlags flags, VkImageViewType viewflags)
 {
-  std::ifstream f(filepath);
-  assert(!f.fail());
-
-  ktxResult result;
-  ktxTexture* ktx_texture;
+  PROFILE_FUNCTION();
   device_ = context->logDevice_;
-
-  result = ktxTexture_CreateFromNamedFile(filepath, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktx_texture);
+  ktxTexture* ktx_texture = loadKtxToStaging(context, filepath);
   width_ = ktx_texture->baseWidth;
   height_ = ktx_texture->baseHeight;
   mipLevels_ = ktx_texture->numLevels;
-  ktx_uint8_t* ktx_texture_data = ktxTexture_GetData(ktx_texture);
-  ktx_size_t ktx_texture_size = ktxTexture_GetSize(ktx_texture);
-
-  vkdev::Buffer staging_buffer;
-  staging_buffer.createBuffer(context, ktx_texture_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-  void* data;
-  vkMapMemory(device_, staging_buffer.memory_, 0, ktx_texture_size, 0, &data);
-  memcpy(data, ktx_texture_data, ktx_texture_size);
-  vkUnmapMemory(device_, staging_buffer.memory_);
-
 
   createImage(context->physDevice_, format, 
               VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
@@ -61,25 +89,23 @@ void vkdev::VkTexture::loadCubemapKtx(Context* context, const char* filepath, Vk
   VkCommandBuffer cmd_buffer = dev::StaticHelpers::beginSingleTimeCommands(context);
 
   std::vector<VkBufferImageCopy> copyRegions;
-  uint32 offset = 0;
-
-  for (size_t face = 0; face < layer_count; face++) {
-    for (size_t levels = 0; levels < mipLevels_; levels++) {
+  for (uint32 face = 0; face < layer_count; face++) {
+    for (uint32 level = 0; level < mipLevels_; level++) {
       ktx_size_t offset;
-      KTX_error_code ret = ktxTexture_GetImageOffset(ktx_texture, levels, 0, face, &offset);
-      //assert(ret == KTX_SUCCESS);
+      ktxTexture_GetImageOffset(ktx_texture, level, 0, face, &offset);
       VkBufferImageCopy region{};
       region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-      region.imageSubresource.mipLevel = levels;
+      region.imageSubresource.mipLevel = level;
       region.imageSubresource.baseArrayLayer = face;
       region.imageSubresource.layerCount = 1;
-      region.imageExtent.width = width_ >> levels;
-      region.imageExtent.height = height_ >> levels;
+      region.imageExtent.width = std::max(width_ >> level, 1u);
+      region.imageExtent.height = std::max(height_ >> level, 1u);
       region.imageExtent.depth = 1;
       region.bufferOffset = offset;
       copyRegions.push_back(region);
     }
   }
+  ktxTexture_Destroy(ktx_texture);
 
   VkImageSubresourceRange subresource_range{};
   subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -89,7 +115,7 @@ void vkdev::VkTexture::loadCubemapKtx(Context* context, const char* filepath, Vk
   setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_range);
 
   vkCmdCopyBufferToImage(cmd_buffer, 
-                         staging_buffer.buffer_, 
+                         context->stagingArena.getBuffer(), 
                          image_, 
                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
                          static_cast<uint32>(copyRegions.size()), 
@@ -115,43 +141,63 @@ void vkdev::VkTexture::loadCubemapKtx(Context* context, const char* filepath, Vk
   descriptor_.imageLayout = layout_;
   descriptor_.imageView = view_;
   descriptor_.sampler = sampler_;
+}
 
-  ktxTexture_Destroy(ktx_texture);
+static bool isKtxPath(const char* texture_path)
+{
+  size_t path_length = strlen(texture_path);
+  return path_length > 4 && strcmp(texture_path + path_length - 4, ".ktx") == 0;
+}
+
+bool vkdev::VkTexture::decodeImage(const char* texture_path, DecodedImage* decoded)
+{
+  PROFILE_FUNCTION();
+  if (isKtxPath(texture_path)) return false;
+
+  int32 texChannels;
+  decoded->pixels = stbi_load(texture_path, &decoded->width, &decoded->height, &texChannels, STBI_rgb_alpha);
+  return decoded->pixels != nullptr;
 }
 
-void vkdev::VkTexture::loadImage(Context* context, const char* texture_path, VkFormat format)
+void vkdev::VkTexture::loadImage(Context* context, const char* texture_path, VkFormat format, DecodedImage* decoded)
 {
-  int32 texWidth, texHeight, texChannels;
-  stbi_uc* pixels = stbi_load(texture_path, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-  if (!pixels) {
+  PROFILE_FUNCTION();
+  if (isKtxPath(texture_path)) {
+    loadKtx(context, texture_path, format);
+    return;
+  }
+
+  DecodedImage image;
+  if (decoded && decoded->pixels) {
+    image = *decoded;
+    decoded->pixels = nullptr;
+  }
+  else if (!decodeImage(texture_path, &image)) {
     throw std::runtime_error("\nFailed to load image texture");
   }
+  int32 texWidth = image.width;
+  int32 texHeight = image.height;
+  stbi_uc* pixels = image.pixels;
 
   width_ = texWidth;
   height_ = texHeight;
-  mipLevels_ = 1;
+  bool mipmaps = canGenerateMipmaps(context->physDevice_, format);
+  mipLevels_ = mipmaps ? static_cast<uint32>(floor(log2(std::max(texWidth, texHeight)))) + 1 : 1;
   device_ = context->logDevice_;
   VkDeviceSize imageSize = (uint64_t)(texWidth) * (uint64_t)(texHeight) * sizeof(uint32);
-  vkdev::Buffer staging_buffer;
-  staging_buffer.createBuffer(context, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-  void* data;
-  vkMapMemory(device_, staging_buffer.memory_, 0, imageSize, 0, &data);
+  void* data = context->stagingArena.acquire(context, imageSize);
   memcpy(data, pixels, imageSize);
-  vkUnmapMemory(device_, staging_buffer.memory_);
-
   stbi_image_free(pixels);
 
   createImage(context->physDevice_, 
               format, 
-              VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
+              VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
               1, 0);
 
   VkImageSubresourceRange subresource_range{};
   subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   subresource_range.baseMipLevel = 0;
-  subresource_range.levelCount = 1;
+  subresource_range.levelCount = mipLevels_;
   subresource_range.layerCount = 1;
   VkCommandBuffer cmd_buffer = dev::StaticHelpers::beginSingleTimeCommands(context);
   setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_range);
@@ -170,30 +216,173 @@ void vkdev::VkTexture::loadImage(Context* context, const char* texture_path, VkF
   region.imageOffset = { 0, 0, 0 };
   region.imageExtent = { (uint32)texWidth, (uint32)texHeight, 1 };
 
-  vkCmdCopyBufferToImage(cmd_buffer, staging_buffer.buffer_, image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  vkCmdCopyBufferToImage(cmd_buffer, context->stagingArena.getBuffer(), image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
-  
-  setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range);
+  if (mipmaps) {
+    generateMipmaps(cmd_buffer);
+  }
+  else {
+    setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range);
+  }
   
   dev::StaticHelpers::endSingleTimeCommands(context, cmd_buffer);
   view_ = dev::StaticHelpers::createTextureImageView(device_, 
                                                      image_, 
                                                      format, 
                                                      VK_IMAGE_VIEW_TYPE_2D, 
-                                                     1, 1, 
+                                                     mipLevels_, 1, 
                                                      VK_IMAGE_ASPECT_COLOR_BIT);
 
   sampler_ = dev::StaticHelpers::createTextureSampler(context, 
                                                       VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 
                                                       VK_COMPARE_OP_ALWAYS, 
-                                                      1, 
+                                                      mipLevels_, 
                                                       VK_BORDER_COLOR_INT_OPAQUE_BLACK);
 
+  layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
   descriptor_.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
   descriptor_.imageView = view_;
   descriptor_.sampler = sampler_;
 }
 
+void vkdev::VkTexture::loadKtx(Context* context, const char* filepath, VkFormat format)
+{
+  PROFILE_FUNCTION();
+  ktxTexture* ktx_texture = loadKtxToStaging(context, filepath);
+
+  format = getKtxFormat(ktx_texture->glInternalformat, format);
+  VkFormatProperties format_properties;
+  vkGetPhysicalDeviceFormatProperties(context->physDevice_, format, &format_properties);
+  if (!(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+    ktxTexture_Destroy(ktx_texture);
+    throw std::runtime_error("\nKtx texture format not supported by the device");
+  }
+
+  width_ = ktx_texture->baseWidth;
+  height_ = ktx_texture->baseHeight;
+  device_ = context->logDevice_;
+  //Uncompressed files without levels still get the chain generated
+  bool mipmaps = ktx_texture->numLevels == 1 && !ktx_texture->isCompressed &&
+                 canGenerateMipmaps(context->physDevice_, format);
+  mipLevels_ = mipmaps ? static_cast<uint32>(floor(log2(std::max(width_, height_)))) + 1 : ktx_texture->numLevels;
+
+  createImage(context->physDevice_, format,
+              VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+              1, 0);
+
+  uint32 stored_levels = mipmaps ? 1 : mipLevels_;
+  std::vector<VkBufferImageCopy> copy_regions;
+  for (uint32 level = 0; level < stored_levels; level++) {
+    ktx_size_t offset;
+    ktxTexture_GetImageOffset(ktx_texture, level, 0, 0, &offset);
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = level;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = std::max(width_ >> level, 1u);
+    region.imageExtent.height = std::max(height_ >> level, 1u);
+    region.imageExtent.depth = 1;
+    region.bufferOffset = offset;
+    copy_regions.push_back(region);
+  }
+
+  VkImageSubresourceRange subresource_range{};
+  subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  subresource_range.baseMipLevel = 0;
+  subresource_range.levelCount = mipLevels_;
+  subresource_range.layerCount = 1;
+
+  VkCommandBuffer cmd_buffer = dev::StaticHelpers::beginSingleTimeCommands(context);
+  setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_range);
+  vkCmdCopyBufferToImage(cmd_buffer, context->stagingArena.getBuffer(), image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32>(copy_regions.size()), copy_regions.data());
+
+  layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  if (mipmaps) {
+    generateMipmaps(cmd_buffer);
+  }
+  else {
+    setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout_, subresource_range);
+  }
+  dev::StaticHelpers::endSingleTimeCommands(context, cmd_buffer);
+  ktxTexture_Destroy(ktx_texture);
+
+  view_ = dev::StaticHelpers::createTextureImageView(device_, image_, format, VK_IMAGE_VIEW_TYPE_2D,
+                                                     mipLevels_, 1, VK_IMAGE_ASPECT_COLOR_BIT);
+  sampler_ = dev::StaticHelpers::createTextureSampler(context, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                                                      VK_COMPARE_OP_ALWAYS, mipLevels_,
+                                                      VK_BORDER_COLOR_INT_OPAQUE_BLACK);
+
+  descriptor_.imageLayout = layout_;
+  descriptor_.imageView = view_;
+  descriptor_.sampler = sampler_;
+}
+
+bool vkdev::VkTexture::canGenerateMipmaps(VkPhysicalDevice pdevice, VkFormat format)
+{
+  //Levels are blitted with linear filtering
+  VkFormatProperties format_properties;
+  vkGetPhysicalDeviceFormatProperties(pdevice, format, &format_properties);
+  VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+  return (format_properties.optimalTilingFeatures & needed) == needed;
+}
+
+void vkdev::VkTexture::generateMipmaps(VkCommandBuffer cmd_buffer)
+{
+  VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image_;
+  barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layerCount_ };
+
+  int32 level_width = static_cast<int32>(width_);
+  int32 level_height = static_cast<int32>(height_);
+  for (uint32 i = 1; i < mipLevels_; i++) {
+    //Previous level becomes the blit source
+    barrier.subresourceRange.baseMipLevel = i - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    int32 next_width = std::max(level_width / 2, 1);
+    int32 next_height = std::max(level_height / 2, 1);
+    VkImageBlit blit{};
+    blit.srcOffsets[1] = { level_width, level_height, 1 };
+    blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, layerCount_ };
+    blit.dstOffsets[1] = { next_width, next_height, 1 };
+    blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, layerCount_ };
+    vkCmdBlitImage(cmd_buffer, image_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    level_width = next_width;
+    level_height = next_height;
+  }
+
+  //Last level was only written
+  barrier.subresourceRange.baseMipLevel = mipLevels_ - 1;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+  layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
 void vkdev::VkTexture::destroyTexture()
 {
   if (device_) {
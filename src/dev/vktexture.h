@@ -6,6 +6,13 @@
 
 struct Context;
 namespace vkdev {
+  //RGBA8 pixels of an image file, decoded away from the thread that uploads them
+  struct DecodedImage {
+    uint8* pixels = nullptr;
+    int32 width = 0;
+    int32 height = 0;
+  };
+
   class VkTexture {
   public:
     VkTexture();
@@ -18,7 +25,19 @@ namespace vkdev {
                         uint32 layer_count = 1, 
                         VkImageCreateFlags flags = 0, 
                         VkImageViewType viewflags = VK_IMAGE_VIEW_TYPE_2D);
-    void loadImage(Context* context, const char* texture_path, VkFormat format);
+    //Mip chain generated with blits, .ktx files go to loadKtx.
+    //Pixels already decoded are uploaded and freed instead of reading the file
+    void loadImage(Context* context, const char* texture_path, VkFormat format, DecodedImage* decoded = nullptr);
+    //Nothing is decoded for .ktx files, they are read by loadKtx
+    static bool decodeImage(const char* texture_path, DecodedImage* decoded);
+    //2D texture with the levels stored in the file, block compressed formats included.
+    //The file format wins over the one requested when it is known
+    void loadKtx(Context* context, const char* filepath, VkFormat format);
+    //Every level in transfer dst, level i is blitted from i - 1 and all end shader read only
+    void generateMipmaps(VkCommandBuffer cmd_buffer);
+    static bool canGenerateMipmaps(VkPhysicalDevice pdevice, VkFormat format);
+    //GL internal formats found in KTX files, anything else keeps the fallback
+    static VkFormat getKtxFormat(uint32 gl_internal_format, VkFormat fallback);
     void destroyTexture();
     void createImage(VkPhysicalDevice pdevice, VkFormat format, VkImageUsageFlags usage, uint32 layers, VkImageCreateFlags flags);
     void setImageLayout(VkCommandBuffer cmd_buffer, 
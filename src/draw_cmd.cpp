@@ -1,25 +1,79 @@
 #include "draw_cmd.h"
 #include "resource_manager.h"
 #include "dev/internal.h"
+#include "Components/geometry.h"
 
 
 void DrawCmd::Execute(VkCommandBuffer cmd_buffer, DrawCallData draw_call, uint32 index, int64_t buffer_padding)
 {
   Resources* intResources = ResourceManager::Get()->getResources();
-  InternalMaterial* internalMat = &intResources->internalMaterials[draw_call.materialType];
+  if (depthOnly_ && (draw_call.materialType == (int32)MaterialType::kMaterialType_Skybox ||
+                     (draw_call.renderState & kRenderState_NoDepth))) return;
+  BindMaterial(cmd_buffer, draw_call.materialType, index, depthOnly_ ? draw_call.depthPipeline : draw_call.pipeline);
+
+  const InternalVertexData& vertex_data = intResources->vertex_data[draw_call.geometry];
+  const LodLevel& level = vertex_data.lods[draw_call.lod];
+  uint32 first_vertex = vertex_data.offset;
+  uint32 first_index = vertex_data.index_offset + level.firstIndex;
+  //The object block is picked by gl_InstanceIndex in the shaders
+  vkCmdDrawIndexed(cmd_buffer, level.indexCount, 1, first_index, first_vertex, draw_call.offset);
+}
+
+void DrawCmd::ExecuteIndirect(VkCommandBuffer cmd_buffer, int32 material_type, uint32 index)
+{
+  Resources* intResources = ResourceManager::Get()->getResources();
+  InternalMaterial* internalMat = &intResources->internalMaterials[material_type];
+  if (!internalMat->entitiesReferenced) return;
+  if (depthOnly_ && material_type == (int32)MaterialType::kMaterialType_Skybox) return;
+
+  //Commands written by the cull pass, one slot per entity of the material
+  BindMaterial(cmd_buffer, material_type, index);
+  intResources->gpuCulling.drawIndirect(cmd_buffer, index, material_type, internalMat->entitiesReferenced);
+}
+
+void DrawCmd::ExecuteTerrain(VkCommandBuffer cmd_buffer, uint32 index)
+{
+  Resources* intResources = ResourceManager::Get()->getResources();
+  vkdev::TerrainQuadtree* terrain = &intResources->terrain;
+  if (!terrain->getNodeCount()) return;
+
+  int32 material_type = (int32)MaterialType::kMaterialType_Noise;
+  BindMaterial(cmd_buffer, material_type, index);
+
+  //Same patch for every node, placed by the push constants
+  VkPipelineLayout layout = intResources->layouts[intResources->internalMaterials[material_type].layout].pipeline;
+  const InternalVertexData& patch = intResources->vertex_data[(int32)PrimitiveType::kPrimitiveType_Terrain];
+  for (uint32 i = 0; i < terrain->getNodeCount(); i++) {
+    const TerrainPatch& node = terrain->getNode(i);
+    vkCmdPushConstants(cmd_buffer, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(TerrainConstants), &node.constants);
+    vkCmdDrawIndexed(cmd_buffer, patch.lods[0].indexCount, 1, patch.index_offset, patch.offset, node.instance);
+  }
+}
+
+void DrawCmd::BindMaterial(VkCommandBuffer cmd_buffer, int32 material_type, uint32 index, VkPipeline variant)
+{
+  Resources* intResources = ResourceManager::Get()->getResources();
+  InternalMaterial* internalMat = &intResources->internalMaterials[material_type];
   VkDeviceSize offsets[] = { 0 };
   VkBuffer vertexBuffers[] = { intResources->vertexBuffer.buffer_ };
 
-  vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, internalMat->matPipeline);
+  VkPipeline pipeline = depthOnly_ ? internalMat->depthPipeline : internalMat->matPipeline;
+  if (variant != VK_NULL_HANDLE) pipeline = variant;
+  vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
   vkCmdBindVertexBuffers(cmd_buffer, 0, 1, vertexBuffers, offsets);
   vkCmdBindIndexBuffer(cmd_buffer, intResources->indicesBuffer.buffer_, 0, VK_INDEX_TYPE_UINT32);
-  uint32 offset = draw_call.offset * static_cast<uint32>(buffer_padding);
   vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
     intResources->layouts[internalMat->layout].pipeline, 0, 1,
-    &internalMat->matDescriptorSet[index], 1, &offset);
-
-  InternalVertexData vertex_data = intResources->vertex_data[draw_call.geometry];
-  uint32 first_vertex = vertex_data.offset;
-  uint32 first_index = vertex_data.index_offset;
-  vkCmdDrawIndexed(cmd_buffer, static_cast<uint32>(vertex_data.indices.size()), 1, first_index, first_vertex, 0);
+    &internalMat->matDescriptorSet[index], 0, nullptr);
+  if (internalMat->layout == kLayoutType_Texture_Bindless) {
+    vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+      intResources->layouts[internalMat->layout].pipeline, 1, 1,
+      &intResources->bindless.set, 0, nullptr);
+  }
+  //Regular meshes with the noise material, the terrain overrides it per node
+  if (internalMat->layout == kLayoutType_Noise) {
+    TerrainConstants constants = vkdev::TerrainQuadtree::meshConstants();
+    vkCmdPushConstants(cmd_buffer, intResources->layouts[internalMat->layout].pipeline,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(TerrainConstants), &constants);
+  }
 }
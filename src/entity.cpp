@@ -31,6 +31,7 @@ int32 Entity::getId()
 
 void Entity::updateEntity(UpdateData* buffer, uint64_t buffer_padding)
 {
+  PROFILE_FUNCTION();
   Material* mat = getMaterial();
   
   for (auto& component : components_) {
@@ -39,6 +40,7 @@ void Entity::updateEntity(UpdateData* buffer, uint64_t buffer_padding)
   buffer->drawCall.offset = material_.offset;
   if (mat) {
     buffer->drawCall.materialType = mat->getMaterialType();
+    buffer->drawCall.renderState = mat->getRenderState();
     mat->updateMaterialSettings(buffer->model, material_.offset, buffer_padding);
   }
 }
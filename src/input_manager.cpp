@@ -40,6 +40,10 @@ void InputManager::keyCallback(Window* window, int32 key, int32 scancode, int32
     inputState[kKeyCode_ESC] = state;
     break;
   }
+  case GLFW_KEY_F12: {
+    inputState[kKeyCode_F12] = state;
+    break;
+  }
   default: {
     break;
   }
@@ -10,6 +10,7 @@ Material::Material()
   materialId_ = -1;
   type_ = MaterialType::kMaterialType_NONE;
   settings_ = new UniformBlocks();
+  renderState_ = kRenderState_Default;
 }
 
 Material::Material(const Material& other)
@@ -17,6 +18,7 @@ Material::Material(const Material& other)
   materialId_ = other.materialId_;
   type_ = other.type_;
   *settings_ = *other.settings_;
+  renderState_ = other.renderState_;
 }
 
 Material::~Material()
@@ -34,6 +36,16 @@ int32 Material::getMaterialType()
   return (int32)type_;
 }
 
+void Material::setRenderState(uint32 flags)
+{
+  renderState_ = flags;
+}
+
+uint32 Material::getRenderState()
+{
+  return renderState_;
+}
+
 void Material::setMaterialType(MaterialType type)
 {
   if ((int32)type_ >= 0)
@@ -169,6 +181,13 @@ void Material::updateMaterialSettings(glm::mat4 model, const uint32 buffer_offse
   UniformBlocks* uniform_buffer = (UniformBlocks*)((uint64_t)mat->dynamicUniformData +
                                                    (buffer_offset * buffer_padding));
   *uniform_buffer = *settings_;
+
+  //Bindless shaders index the global texture array with the slot of the texture id,
+  //streamed textures move to a new slot every time their levels change
+  if (mat->layout == kLayoutType_Texture_Bindless) {
+    uint32 texture = mat->texturesReferenced[settings_->textureBlock.textureIndex];
+    uniform_buffer->textureBlock.textureIndex = rm->getResources()->textureStreamer.getSlot(texture);
+  }
 }
 
 int32 Material::setRoughness(float rough)
@@ -1,6 +1,199 @@
 #include "perlin_noise.h"
 #include <numeric>
 #include <random>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+
+/*******************************************************************************/
+
+//Same operations in the same order as the scalar path, no fused multiply add,
+//so every lane matches PerlinNoise::noise bit for bit
+
+AVX2_FUNCTION static __m256 Fade8(__m256 t)
+{
+  __m256 inner = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))),
+                               _mm256_set1_ps(10.0f));
+  return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+}
+
+AVX2_FUNCTION static __m256 Lerp8(__m256 t, __m256 a, __m256 b)
+{
+  return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+AVX2_FUNCTION static __m256 Grad8(__m256i hash, __m256 x, __m256 y, __m256 z)
+{
+  __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+  __m256 lt8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+  __m256 lt4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+  __m256 use_x = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)),
+                                                     _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14))));
+  __m256 u = _mm256_blendv_ps(y, x, lt8);
+  __m256 v = _mm256_blendv_ps(_mm256_blendv_ps(z, x, use_x), y, lt4);
+
+  //Bits 0 and 1 of the hash flip the sign of u and v
+  __m256 sign_u = _mm256_castsi256_ps(_mm256_slli_epi32(h, 31));
+  __m256 sign_v = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_srli_epi32(h, 1), 31));
+  return _mm256_add_ps(_mm256_xor_ps(u, sign_u), _mm256_xor_ps(v, sign_v));
+}
+
+AVX2_FUNCTION static __m256 Perlin8(const uint32* p, __m256 x, __m256 y, __m256 z)
+{
+  const int* table = (const int*)p;
+  __m256i mask = _mm256_set1_epi32(255);
+  __m256i one = _mm256_set1_epi32(1);
+
+  __m256 floor_x = _mm256_floor_ps(x);
+  __m256 floor_y = _mm256_floor_ps(y);
+  __m256 floor_z = _mm256_floor_ps(z);
+  __m256i X = _mm256_and_si256(_mm256_cvttps_epi32(floor_x), mask);
+  __m256i Y = _mm256_and_si256(_mm256_cvttps_epi32(floor_y), mask);
+  __m256i Z = _mm256_and_si256(_mm256_cvttps_epi32(floor_z), mask);
+  x = _mm256_sub_ps(x, floor_x);
+  y = _mm256_sub_ps(y, floor_y);
+  z = _mm256_sub_ps(z, floor_z);
+
+  __m256 u = Fade8(x);
+  __m256 v = Fade8(y);
+  __m256 w = Fade8(z);
+
+  __m256i A = _mm256_add_epi32(_mm256_i32gather_epi32(table, X, 4), Y);
+  __m256i AA = _mm256_add_epi32(_mm256_i32gather_epi32(table, A, 4), Z);
+  __m256i AB = _mm256_add_epi32(_mm256_i32gather_epi32(table, _mm256_add_epi32(A, one), 4), Z);
+  __m256i B = _mm256_add_epi32(_mm256_i32gather_epi32(table, _mm256_add_epi32(X, one), 4), Y);
+  __m256i BA = _mm256_add_epi32(_mm256_i32gather_epi32(table, B, 4), Z);
+  __m256i BB = _mm256_add_epi32(_mm256_i32gather_epi32(table, _mm256_add_epi32(B, one), 4), Z);
+
+  __m256 one_f = _mm256_set1_ps(1.0f);
+  __m256 x1 = _mm256_sub_ps(x, one_f);
+  __m256 y1 = _mm256_sub_ps(y, one_f);
+  __m256 z1 = _mm256_sub_ps(z, one_f);
+
+  __m256 g0 = Grad8(_mm256_i32gather_epi32(table, AA, 4), x, y, z);
+  __m256 g1 = Grad8(_mm256_i32gather_epi32(table, BA, 4), x1, y, z);
+  __m256 g2 = Grad8(_mm256_i32gather_epi32(table, AB, 4), x, y1, z);
+  __m256 g3 = Grad8(_mm256_i32gather_epi32(table, BB, 4), x1, y1, z);
+  __m256 g4 = Grad8(_mm256_i32gather_epi32(table, _mm256_add_epi32(AA, one), 4), x, y, z1);
+  __m256 g5 = Grad8(_mm256_i32gather_epi32(table, _mm256_add_epi32(BA, one), 4), x1, y, z1);
+  __m256 g6 = Grad8(_mm256_i32gather_epi32(table, _mm256_add_epi32(AB, one), 4), x, y1, z1);
+  __m256 g7 = Grad8(_mm256_i32gather_epi32(table, _mm256_add_epi32(BB, one), 4), x1, y1, z1);
+
+  return Lerp8(w, Lerp8(v, Lerp8(u, g0, g1), Lerp8(u, g2, g3)),
+                  Lerp8(v, Lerp8(u, g4, g5), Lerp8(u, g6, g7)));
+}
+
+//Returns the number of elements done, the caller finishes the tail with the scalar path
+AVX2_FUNCTION static uint32 PerlinRowAVX2(const uint32* p, const float* x, float y, float z,
+                                          uint32 count, float* result)
+{
+  uint32 batched = count & ~7u;
+  __m256 y8 = _mm256_set1_ps(y);
+  __m256 z8 = _mm256_set1_ps(z);
+  for (uint32 i = 0; i < batched; i += 8) {
+    _mm256_storeu_ps(result + i, Perlin8(p, _mm256_loadu_ps(x + i), y8, z8));
+  }
+
+  return batched;
+}
+
+AVX2_FUNCTION static uint32 FractalRowAVX2(const uint32* p, uint32 octaves, float persistence,
+                                           const float* x, float y, float z, uint32 count, float* result)
+{
+  uint32 batched = count & ~7u;
+  for (uint32 i = 0; i < batched; i += 8) {
+    __m256 position = _mm256_loadu_ps(x + i);
+    __m256 sum = _mm256_setzero_ps();
+    float frequency = 1.0f;
+    float amplitude = 1.0f;
+    float max = 0.0f;
+    for (uint32 o = 0; o < octaves; o++) {
+      __m256 n = Perlin8(p, _mm256_mul_ps(position, _mm256_set1_ps(frequency)),
+                         _mm256_set1_ps(y * frequency), _mm256_set1_ps(z * frequency));
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(n, _mm256_set1_ps(amplitude)));
+      max += amplitude;
+      amplitude *= persistence;
+      frequency *= 2.0f;
+    }
+
+    sum = _mm256_div_ps(sum, _mm256_set1_ps(max));
+    sum = _mm256_div_ps(_mm256_add_ps(sum, _mm256_set1_ps(1.0f)), _mm256_set1_ps(2.0f));
+    _mm256_storeu_ps(result + i, sum);
+  }
+
+  return batched;
+}
+
+AVX2_FUNCTION static __m256 Perlin2D8(const uint32* p, __m256 x, __m256 y, uint32 period)
+{
+  const int* table = (const int*)p;
+  __m256i mask = _mm256_set1_epi32(static_cast<int32>(period) - 1);
+  __m256i one = _mm256_set1_epi32(1);
+
+  __m256 floor_x = _mm256_floor_ps(x);
+  __m256 floor_y = _mm256_floor_ps(y);
+  __m256i X = _mm256_and_si256(_mm256_cvttps_epi32(floor_x), mask);
+  __m256i Y = _mm256_and_si256(_mm256_cvttps_epi32(floor_y), mask);
+  __m256i X1 = _mm256_and_si256(_mm256_add_epi32(X, one), mask);
+  __m256i Y1 = _mm256_and_si256(_mm256_add_epi32(Y, one), mask);
+  x = _mm256_sub_ps(x, floor_x);
+  y = _mm256_sub_ps(y, floor_y);
+
+  __m256 u = Fade8(x);
+  __m256 v = Fade8(y);
+
+  __m256i PA = _mm256_i32gather_epi32(table, X, 4);
+  __m256i PB = _mm256_i32gather_epi32(table, X1, 4);
+  __m256i A = _mm256_i32gather_epi32(table, _mm256_i32gather_epi32(table, _mm256_add_epi32(PA, Y), 4), 4);
+  __m256i A1 = _mm256_i32gather_epi32(table, _mm256_i32gather_epi32(table, _mm256_add_epi32(PA, Y1), 4), 4);
+  __m256i B = _mm256_i32gather_epi32(table, _mm256_i32gather_epi32(table, _mm256_add_epi32(PB, Y), 4), 4);
+  __m256i B1 = _mm256_i32gather_epi32(table, _mm256_i32gather_epi32(table, _mm256_add_epi32(PB, Y1), 4), 4);
+
+  __m256 zero = _mm256_setzero_ps();
+  __m256 x1 = _mm256_sub_ps(x, _mm256_set1_ps(1.0f));
+  __m256 y1 = _mm256_sub_ps(y, _mm256_set1_ps(1.0f));
+
+  return Lerp8(v, Lerp8(u, Grad8(A, x, y, zero), Grad8(B, x1, y, zero)),
+                  Lerp8(u, Grad8(A1, x, y1, zero), Grad8(B1, x1, y1, zero)));
+}
+
+AVX2_FUNCTION static uint32 FractalRow2DAVX2(const uint32* p, uint32 octaves, float persistence,
+                                             const float* x, float y, uint32 period, uint32 count, float* result)
+{
+  uint32 batched = count & ~7u;
+  for (uint32 i = 0; i < batched; i += 8) {
+    __m256 position = _mm256_loadu_ps(x + i);
+    __m256 sum = _mm256_setzero_ps();
+    float frequency = 1.0f;
+    float amplitude = 1.0f;
+    float max = 0.0f;
+    for (uint32 o = 0; o < octaves; o++) {
+      __m256 n = Perlin2D8(p, _mm256_mul_ps(position, _mm256_set1_ps(frequency)),
+                           _mm256_set1_ps(y * frequency), std::min(period << o, 256u));
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(n, _mm256_set1_ps(amplitude)));
+      max += amplitude;
+      amplitude *= persistence;
+      frequency *= 2.0f;
+    }
+
+    sum = _mm256_div_ps(sum, _mm256_set1_ps(max));
+    sum = _mm256_div_ps(_mm256_add_ps(sum, _mm256_set1_ps(1.0f)), _mm256_set1_ps(2.0f));
+    _mm256_storeu_ps(result + i, sum);
+  }
+
+  return batched;
+}
+
+/*******************************************************************************/
 
 float PerlinNoise::fade(float t)
 {
@@ -21,14 +214,23 @@ float PerlinNoise::grad(int hash, float x, float y, float z)
   return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
 }
 
-PerlinNoise::PerlinNoise()
+PerlinNoise::PerlinNoise() : PerlinNoise(std::random_device{}())
+{
+}
+
+PerlinNoise::PerlinNoise(uint32 seed)
 {
   // Generate random lookup for permutations containing all numbers from 0..255
   std::vector<uint8> plookup;
   plookup.resize(256);
   std::iota(plookup.begin(), plookup.end(), 0);
-  std::default_random_engine rndEngine(std::random_device{}());
-  std::shuffle(plookup.begin(), plookup.end(), rndEngine);
+
+  // mt19937 output is fixed by the standard, std::shuffle and the default engine are not
+  std::mt19937 rndEngine(seed);
+  for (uint32 i = 255; i > 0; i--)
+  {
+    std::swap(plookup[i], plookup[rndEngine() % (i + 1)]);
+  }
 
   for (uint32_t i = 0; i < 256; i++)
   {
@@ -67,6 +269,61 @@ float PerlinNoise::noise(float x, float y, float z)
   return res;
 }
 
+float PerlinNoise::noise2D(float x, float y, uint32 period)
+{
+  // Find unit square that contains point, wrapped to the period
+  int32 mask = static_cast<int32>(period) - 1;
+  int32 X = (int32)floor(x) & mask;
+  int32 Y = (int32)floor(y) & mask;
+  int32 X1 = (X + 1) & mask;
+  int32 Y1 = (Y + 1) & mask;
+  x -= floor(x);
+  y -= floor(y);
+
+  float u = fade(x);
+  float v = fade(y);
+
+  // Hash coordinates of the 4 square corners, same hashes as the z = 0 face of the cube
+  uint32 A = permutations[X] + Y;
+  uint32 A1 = permutations[X] + Y1;
+  uint32 B = permutations[X1] + Y;
+  uint32 B1 = permutations[X1] + Y1;
+
+  return lerp(v, lerp(u, grad(permutations[permutations[A]], x, y, 0.0f), grad(permutations[permutations[B]], x - 1, y, 0.0f)),
+                 lerp(u, grad(permutations[permutations[A1]], x, y - 1, 0.0f), grad(permutations[permutations[B1]], x - 1, y - 1, 0.0f)));
+}
+
+void PerlinNoise::noise(const float* x, float y, float z, uint32 count, float* result)
+{
+  uint32 done = hasAVX2() ? PerlinRowAVX2(permutations, x, y, z, count, result) : 0;
+  for (uint32 i = done; i < count; i++) {
+    result[i] = noise(x[i], y, z);
+  }
+}
+
+const uint32* PerlinNoise::getPermutations() const
+{
+  return permutations;
+}
+
+bool PerlinNoise::hasAVX2()
+{
+  static const bool supported = []() {
+#ifdef _MSC_VER
+    int32 info[4];
+    __cpuid(info, 1);
+    //OS has to save the ymm registers too
+    bool os_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+    __cpuidex(info, 7, 0);
+    return os_avx && (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+  }();
+
+  return supported;
+}
+
 FractalNoise::FractalNoise(const PerlinNoise& perlinNoise)
 {
   this->perlinNoise = perlinNoise;
@@ -91,3 +348,106 @@ float FractalNoise::noise(float x, float y, float z)
   sum = sum / max;
   return (sum + 1.0f) / 2.0f;
 }
+
+void FractalNoise::noise(const float* x, float y, float z, uint32 count, float* result)
+{
+  uint32 done = 0;
+  if (PerlinNoise::hasAVX2()) {
+    done = FractalRowAVX2(perlinNoise.getPermutations(), octaves, persistence, x, y, z, count, result);
+  }
+  for (uint32 i = done; i < count; i++) {
+    result[i] = noise(x[i], y, z);
+  }
+}
+
+float FractalNoise::noise2D(float x, float y, uint32 period)
+{
+  float sum = 0;
+  float frequency = 1.0f;
+  float amplitude = 1.0f;
+  float max = 0.0f;
+  for (uint32_t i = 0; i < octaves; i++)
+  {
+    sum += perlinNoise.noise2D(x * frequency, y * frequency, std::min(period << i, 256u)) * amplitude;
+    max += amplitude;
+    amplitude *= persistence;
+    frequency *= 2.0f;
+  }
+
+  sum = sum / max;
+  return (sum + 1.0f) / 2.0f;
+}
+
+void FractalNoise::noise2D(const float* x, float y, uint32 period, uint32 count, float* result)
+{
+  uint32 done = 0;
+  if (PerlinNoise::hasAVX2()) {
+    done = FractalRow2DAVX2(perlinNoise.getPermutations(), octaves, persistence, x, y, period, count, result);
+  }
+  for (uint32 i = done; i < count; i++) {
+    result[i] = noise2D(x[i], y, period);
+  }
+}
+
+void FractalNoise::noiseImage(uint32 width, uint32 height, float scale, uint32 period, float* result)
+{
+  std::vector<float> row_x(width);
+  for (uint32 j = 0; j < width; j++) {
+    row_x[j] = j / (float)width * scale;
+  }
+
+  //Contiguous blocks of rows, every thread writes its own part of result
+  uint32 thread_count = std::max(std::min(std::thread::hardware_concurrency(), height), 1u);
+  uint32 rows_per_thread = (height + thread_count - 1) / thread_count;
+  auto generate_rows = [&](uint32 first, uint32 last) {
+    for (uint32 i = first; i < last; i++) {
+      noise2D(row_x.data(), i / (float)height * scale, period, width, result + (size_t)i * width);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (uint32 t = 1; t < thread_count; t++) {
+    uint32 first = std::min(t * rows_per_thread, height);
+    threads.emplace_back(generate_rows, first, std::min(first + rows_per_thread, height));
+  }
+  generate_rows(0, std::min(rows_per_thread, height));
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void FractalNoise::benchmark()
+{
+  PerlinNoise perlin_noise(1);
+  FractalNoise fractal(perlin_noise);
+  const float scale = 8.0f;
+  const uint32 period = 8;
+  const uint32 sizes[] = { 512, 2048, 8192 };
+
+  printf("Fractal noise benchmark, AVX2: %s, threads: %u\n",
+         PerlinNoise::hasAVX2() ? "yes" : "no", std::thread::hardware_concurrency());
+
+  for (uint32 size : sizes) {
+    std::vector<float> batched((size_t)size * size);
+    auto start = std::chrono::high_resolution_clock::now();
+    fractal.noiseImage(size, size, scale, period, batched.data());
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    //Scalar reference, every texel has to match the batched result exactly
+    uint32 mismatches = 0;
+    for (uint32 i = 0; i < size; i++) {
+      float nh = i / (float)size * scale;
+      for (uint32 j = 0; j < size; j++) {
+        float n = fractal.noise2D(j / (float)size * scale, nh, period);
+        mismatches += memcmp(&n, &batched[(size_t)i * size + j], sizeof(float)) != 0;
+      }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    float batched_ms = std::chrono::duration<float, std::chrono::milliseconds::period>(middle - start).count();
+    float scalar_ms = std::chrono::duration<float, std::chrono::milliseconds::period>(end - middle).count();
+    printf("%5u^2  scalar: %9.2f ms  batched: %8.2f ms  speedup: %6.2fx  mismatches: %u\n",
+           size, scalar_ms, batched_ms, scalar_ms / batched_ms, mismatches);
+  }
+}
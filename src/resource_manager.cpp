@@ -6,6 +6,7 @@
 #include "material.h"
 #include "camera.h"
 #include "Components/texture.h"
+#include "dev/mesh_simplifier.h"
 #include <unordered_map>
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
@@ -138,8 +139,8 @@ void ResourceManager::initPrimitiveGeometries()
   sphereGenerator(50.0f, 30.0f);
 
 
-  /*****TERRAIN MESH*****/
-  terrainGenerator(64, 64);
+  /*****TERRAIN PATCH*****/
+  terrainGenerator(kTerrainPatchSize, kTerrainPatchSize);
 }
 
 
@@ -159,6 +160,42 @@ void ResourceManager::createVertexBuffer(VertexBuffer* buffer)
   const uint32* indices = buffer->indices_array_.data();
   std::copy(indices, indices + indices_number, newVertexData.indices.data());
 
+  newVertexData.aabbMin = glm::vec3(0.0f);
+  newVertexData.aabbMax = glm::vec3(0.0f);
+  if (!newVertexData.vertex.empty()) {
+    newVertexData.aabbMin = newVertexData.vertex[0].vertex;
+    newVertexData.aabbMax = newVertexData.vertex[0].vertex;
+  }
+  for (auto& vertex : newVertexData.vertex) {
+    newVertexData.aabbMin = glm::min(newVertexData.aabbMin, vertex.vertex);
+    newVertexData.aabbMax = glm::max(newVertexData.aabbMax, vertex.vertex);
+  }
+
+  glm::vec3 center = (newVertexData.aabbMin + newVertexData.aabbMax) * 0.5f;
+  float radius = 0.0f;
+  for (auto& vertex : newVertexData.vertex) {
+    radius = std::max(radius, glm::length(vertex.vertex - center));
+  }
+  newVertexData.sphere = glm::vec4(center, radius);
+
+  //Each level halves the triangles of the previous one, stops once the locked
+  //borders and seams don't let the mesh shrink any further
+  newVertexData.lods.push_back({ 0, indices_number });
+  if (indices_number >= kLodMinIndices) {
+    vkdev::MeshSimplifier simplifier;
+    std::vector<uint32> source(newVertexData.indices);
+    std::vector<uint32> level;
+    for (uint32 i = 1; i < kMaxLodLevels; i++) {
+      uint32 target = static_cast<uint32>(source.size() / 6) * 3;
+      uint32 level_count = simplifier.simplify(newVertexData.vertex, source, target, &level);
+      if (!level_count || level_count > source.size() * 3 / 4) break;
+
+      newVertexData.lods.push_back({ static_cast<uint32>(newVertexData.indices.size()), level_count });
+      newVertexData.indices.insert(newVertexData.indices.end(), level.begin(), level.end());
+      source.swap(level);
+    }
+  }
+
   resources_->vertex_data.push_back(newVertexData);
 }
 
@@ -198,12 +235,26 @@ Camera& ResourceManager::getCamera()
   return Scene::camera;
 }
 
+CullingStats ResourceManager::getCullingStats() const
+{
+  return resources_->cullingStats;
+}
+
 
 void ResourceManager::terrainGenerator(uint32 w, uint32 h)
 {
-  float divw = 1.0f / (float)w;// - 1.0f;
-  float divh = 1.0f / (float)h;// - 1.0f;
+  //Grid patch with shared vertices at integer coordinates, the terrain
+  //quadtree scales and places it for every node
+  float divw = 1.0f / (float)w;
+  float divh = 1.0f / (float)h;
   std::vector<Vertex> vertices;
+  for (size_t i = 0; i <= h; i++) {
+    for (size_t j = 0; j <= w; j++) {
+      vertices.push_back({{ (float)j, 0.0f, (float)i }, { 0.0f, 1.0f, 0.0f }, {(float)j * divw, (float)i * divh}});
+    }
+  }
+
+  std::vector<uint32> indices;
   for (size_t i = 0; i < h; i++) {
     for (size_t j = 0; j < w; j++) {
       // v0-----v1
@@ -211,39 +262,17 @@ void ResourceManager::terrainGenerator(uint32 w, uint32 h)
       // |   \   |
       // |    \  |
       // v3-----v2
-      float nextw = (float)j + 1.0f;
-      float nexth = (float)i + 1.0f;
-      vertices.push_back({{ j - 0.5f, 0.0f, i - 0.5f }, { 0.0f, 0.0f, 1.0f }, {(float)j * divw, (float)i * divh}});
-      vertices.push_back({{ j + 0.5f, 0.0f, i - 0.5f }, { 0.0f, 0.0f, 1.0f }, {nextw    * divw, (float)i * divh}});
-      vertices.push_back({{ j + 0.5f, 0.0f, i + 0.5f }, { 0.0f, 0.0f, 1.0f }, {nextw    * divw, nexth    * divh}});
-      vertices.push_back({{ j - 0.5f, 0.0f, i + 0.5f }, { 0.0f, 0.0f, 1.0f }, {(float)j * divw, nexth    * divh}});
-
-      //vertices.push_back({{ j, 0.0f, i }, { 0.0f, 0.0f, 1.0f }, {(float)j / w, (float)i / h}});
-
-
-    }
-  }
-
-  std::vector<uint32> indices;
-  for (size_t i = 0; i < h; i++) {
-    uint32 index1 = w * i;
-    for (size_t j = 0; j < w; j++) {
-      uint32 index = index1 + j;
-      ////v0--v1
-      //// \  |
-      ////  \ |
-      ////   v2
-      indices.push_back(4 * index);
-      indices.push_back(4 * index + 1);
-      indices.push_back(4 * index + 2);
-
-      //// v0
-      //// | \ 
-      //// |  \
-      //// v2--v1
-      indices.push_back(4 * index);
-      indices.push_back(4 * index + 2);
-      indices.push_back(4 * index + 3);
+      uint32 v0 = i * (w + 1) + j;
+      uint32 v1 = v0 + 1;
+      uint32 v2 = v1 + w + 1;
+      uint32 v3 = v0 + w + 1;
+      indices.push_back(v0);
+      indices.push_back(v1);
+      indices.push_back(v2);
+
+      indices.push_back(v0);
+      indices.push_back(v2);
+      indices.push_back(v3);
     }
   }
 
@@ -329,6 +358,7 @@ void ResourceManager::sphereGenerator(float longitude_rev, float latitude_rev)
 
 std::list<PtrAlloc<Geometry>> ResourceManager::loadObj(std::string path)
 {
+  PROFILE_FUNCTION();
   tinyobj::attrib_t attrib;
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
@@ -3,28 +3,62 @@
 
 layout(location = 0) in vec3 worldPosition;
 layout(location = 1) in vec3 worldNormal;
+layout(location = 2) flat in uint objectIndex;
 layout(location = 0) out vec4 finalColor;
 
+//Set when the pipeline is created
+layout(constant_id = 0) const uint MAX_CLUSTER_LIGHTS = 64u;
+layout(constant_id = 1) const bool TONEMAP = true;
+
 #define LIGHT
 
 layout(binding = 0) uniform SceneUniformBuffer {
     mat4 proj;
     mat4 view;
-    LightSource lights[MAX_LIGHTS];
     vec3 camPos;
     int light_number;
+    uvec4 clusterGrid;
+    vec4 clusterParams;
 } sb;
 
-layout(binding = 1) uniform UniformBufferObject {
+//Clustered lights, built on the CPU every frame
+layout(std430, binding = 5) readonly buffer LightBuffer {
+    LightSource lights[];
+} lb;
+
+layout(std430, binding = 6) readonly buffer ClusterBuffer {
+    uvec2 clusters[];
+} cb;
+
+layout(std430, binding = 7) readonly buffer LightIndexBuffer {
+    uint indices[];
+} lib;
+
+struct ObjectData {
     mat4 model;
     vec4 albedo;
     float roughness;
     float metallic;
     vec2 padding;
-} ubo;
+    vec4 objectStride[2];
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} ob;
+
+ObjectData ubo;
 
 const float PI = 3.14159265359;
 
+//x: first light index, y: light count
+uvec2 GetCluster(vec3 position) {
+    float depth = max(-(sb.view * vec4(position, 1.0)).z, 0.0001);
+    uint slice = uint(max(log(depth) * sb.clusterParams.x + sb.clusterParams.y, 0.0));
+    uvec3 cluster = min(uvec3(uvec2(gl_FragCoord.xy * sb.clusterParams.zw), slice), sb.clusterGrid.xyz - uvec3(1));
+    return cb.clusters[cluster.x + sb.clusterGrid.x * (cluster.y + sb.clusterGrid.y * cluster.z)];
+}
+
 //Normal Distribution Function
 float NormalDistribution(float dotNH, float roughness) {
     float alpha = roughness * roughness;
@@ -78,24 +112,31 @@ vec3 SpecularBRDF(vec3 L, vec3 V, vec3 N, float metallic, float roughness, vec3
 }
 
 void main() {
+    ubo = ob.objects[objectIndex];
     vec3 N = normalize(worldNormal);
     vec3 V = normalize(sb.camPos.xyz - worldPosition);
 
     float roughness = ubo.roughness;
 
     vec3 Lo = vec3(0.0);
-    for (int i = 0; i < sb.light_number; i++) {
-        vec3 light_position = sb.lights[i].pos.xyz;
-        vec3 L = normalize(vec3(light_position - worldPosition));
-        float distance = length(light_position - worldPosition);
+    uvec2 cluster = GetCluster(worldPosition);
+    //Constant bound, the compiler can unroll it
+    for (uint i = 0; i < MAX_CLUSTER_LIGHTS; i++) {
+        if (i >= cluster.y) break;
+        LightSource light = lb.lights[lib.indices[cluster.x + i]];
+        vec3 light_vector = light.pos.xyz - worldPosition;
+        float distance = length(light_vector);
+        if (distance > light.pos.w) continue;
+        vec3 L = light_vector / distance;
         float attenuation = 1.0 / (distance * distance);
-        float c = step(distance, 4.0);
-        vec3 radiance = sb.lights[i].lightcolor.xyz * attenuation;
-        Lo += c * radiance * SpecularBRDF(L, V, N, ubo.metallic, roughness, ubo.albedo.xyz);
+        vec3 radiance = light.lightcolor.rgb * light.lightcolor.w * attenuation;
+        Lo += radiance * SpecularBRDF(L, V, N, ubo.metallic, roughness, ubo.albedo.xyz);
     }
     vec3 color = ubo.albedo.xyz * 0.03;
     color += Lo;
-    color = color / (color + vec3(1.0));
+    if (TONEMAP) {
+        color = color / (color + vec3(1.0));
+    }
     color = pow(color, vec3(0.4545));
 
     finalColor = vec4(color, 1.0);
@@ -0,0 +1,27 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//Depth pre-pass, the main pass tests against it with EQUAL.
+//Same position math as the mesh vertex shaders and invariant like them
+layout(location = 0) in vec3 inPosition;
+
+layout(binding = 0) uniform SceneUniformBuffer {
+    mat4 proj;
+    mat4 view;
+} sb;
+
+struct ObjectData {
+    mat4 model;
+    vec4 objectStride[4];
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} ob;
+
+invariant gl_Position;
+
+void main() {
+    vec3 worldPosition = vec3(ob.objects[gl_InstanceIndex].model * vec4(inPosition, 1.0));
+    gl_Position = sb.proj * sb.view * vec4(worldPosition, 1.0);
+}
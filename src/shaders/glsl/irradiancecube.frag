@@ -6,10 +6,9 @@ layout (location = 0) in vec3 inPos;
 layout (location = 0) out vec4 outColor;
 layout (binding = 0) uniform samplerCube samplerEnv;
 
-layout(push_constant) uniform PushConsts {
-	layout (offset = 64) float deltaPhi;
-	layout (offset = 68) float deltaTheta;
-} consts;
+//Sampling steps, set when the pipeline is created
+layout (constant_id = 0) const float DELTA_PHI = 0.0349066;
+layout (constant_id = 1) const float DELTA_THETA = 0.0245437;
 
 #define PI 3.1415926535897932384626433832795
 
@@ -25,8 +24,8 @@ void main()
 
 	vec3 color = vec3(0.0);
 	uint sampleCount = 0u;
-	for (float phi = 0.0; phi < TWO_PI; phi += consts.deltaPhi) {
-		for (float theta = 0.0; theta < HALF_PI; theta += consts.deltaTheta) {
+	for (float phi = 0.0; phi < TWO_PI; phi += DELTA_PHI) {
+		for (float theta = 0.0; theta < HALF_PI; theta += DELTA_THETA) {
 			vec3 tempVec = cos(phi) * right + sin(phi) * up;
 			vec3 sampleVector = cos(theta) * N + sin(theta) * tempVec;
 			color += texture(samplerEnv, sampleVector).rgb * cos(theta) * sin(theta);
@@ -6,12 +6,15 @@ layout(binding = 4) uniform sampler2D grass_texture;
 
 layout(location = 0) in float noiseval;
 layout(location = 1) in vec2 outUv;
+layout(location = 2) flat in float terrain;
 
 layout(location = 0) out vec4 finalColor;
 
 
 void main() {
     float s = smoothstep(0.50, 0.65, noiseval);
-    vec4 a = mix(texture(mount_texture, outUv), texture(grass_texture, outUv), s);
+    //Terrain uvs go past 1 and the samplers clamp, mesh uvs stay as they are so 1 doesn't wrap to 0
+    vec2 uv = terrain > 0.0 ? fract(outUv) : outUv;
+    vec4 a = mix(texture(mount_texture, uv), texture(grass_texture, uv), s);
     finalColor = a;
 }
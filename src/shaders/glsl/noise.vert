@@ -5,34 +5,93 @@ layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inUv;
 
-#define LIGHT
-
 layout(binding = 0) uniform SceneUniformBuffer {
     mat4 proj;
     mat4 view;
     vec3 camPos;
-    LightSource lights[MAX_LIGHTS];
     int light_number;
 } sb;
 
-layout(binding = 1) uniform UniformBufferObject {
+struct ObjectData {
     mat4 model;
     float randc;
     float amp;
     vec2 padding;
-} ubo;
+    vec4 objectStride[3];
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} ob;
 
 layout(binding = 2) uniform sampler2D noise_texture;
+layout(binding = 5) uniform sampler2DArray height_tiles;
+
+//Resident tiles of the window around the camera, -1 while a tile is being loaded
+layout(std430, binding = 6) readonly buffer HeightmapPages {
+    //xy: first tile of the window, z: window side, w: 1 when streaming
+    ivec4 window;
+    //x: cells per tile, y: 1 / samples per tile side
+    vec4 tile;
+    int layers[];
+} hp;
+
+//One terrain quadtree node, regular meshes get node (0, 0, 1, 0) and no morph
+layout(push_constant) uniform TerrainNode {
+    vec4 node;
+    vec4 morph;
+    vec4 camera;
+} tn;
 
 layout(location = 0) out float noiseval;
 layout(location = 1) out vec2 outUv;
+//1 on terrain patches, their uvs go past 1
+layout(location = 2) flat out float terrain;
+
+//Detail textures repeat every 64 cells
+const float kDetailScale = 1.0 / 64.0;
+
+
+vec2 NoiseUv(vec2 local) {
+    return tn.node.w > 0.0 ? local * tn.node.w : inUv;
+}
 
+//Terrain patches read the streamed tiles when there are any, missing tiles stay at mid height
+float Height(vec2 local) {
+    if (hp.window.w == 0 || tn.node.w == 0.0) return texture(noise_texture, NoiseUv(local)).r;
+
+    vec2 tile = floor(local / hp.tile.x);
+    ivec2 slot = ivec2(tile) - hp.window.xy;
+    if (any(lessThan(slot, ivec2(0))) || any(greaterThanEqual(slot, hp.window.zz))) return 0.5;
+    int layer = hp.layers[slot.y * hp.window.z + slot.x];
+    if (layer < 0) return 0.5;
+
+    //Sample k of a tile sits on cell k, the last one is shared with the next tile
+    vec2 uv = (local - tile * hp.tile.x + 0.5) * hp.tile.y;
+    return textureLod(height_tiles, vec3(uv, float(layer)), 0.0).r;
+}
+
+//Matches the depth pre-pass
+invariant gl_Position;
 
 void main() {
-    vec4 tex = texture(noise_texture, inUv);
-    vec3 pos = inPosition;
-    pos.y += (tex.r * ubo.amp) - ubo.amp * 0.5;
+    ObjectData ubo = ob.objects[gl_InstanceIndex];
+
+    vec2 grid = inPosition.xz;
+    vec2 local = tn.node.xy + grid * tn.node.z;
+    float height = Height(local) * ubo.amp - ubo.amp * 0.5 + inPosition.y;
+
+    //Odd vertices slide onto the next coarser grid as the distance reaches the end of the node range
+    float dist = length(vec3(local.x, height, local.y) - tn.camera.xyz);
+    float morph = clamp((dist - tn.morph.x) * tn.morph.z, 0.0, 1.0);
+    grid -= fract(grid * 0.5) * 2.0 * morph;
+    local = tn.node.xy + grid * tn.node.z;
+
+    float h = Height(local);
+    vec3 pos = vec3(local.x, inPosition.y, local.y);
+    pos.y += (h * ubo.amp) - ubo.amp * 0.5;
     gl_Position = sb.proj * sb.view * ubo.model * vec4(pos, 1.0);
-    noiseval = tex.r;
-    outUv = inUv;
+    noiseval = h;
+    outUv = tn.node.w > 0.0 ? local * kDetailScale : inUv;
+    terrain = tn.node.w > 0.0 ? 1.0 : 0.0;
 }
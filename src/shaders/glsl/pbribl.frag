@@ -3,20 +3,41 @@
 
 layout(location = 0) in vec3 worldPosition;
 layout(location = 1) in vec3 worldNormal;
+layout(location = 2) flat in uint objectIndex;
 
 layout(location = 0) out vec4 finalColor;
 
+//Set when the pipeline is created
+layout(constant_id = 0) const uint MAX_CLUSTER_LIGHTS = 64u;
+layout(constant_id = 1) const bool TONEMAP = true;
+//Last mip level of the prefiltered cube
+layout(constant_id = 2) const float REFLECTION_LOD = 9.0;
+
 #define LIGHT
 
 layout(binding = 0) uniform SceneUniformBuffer {
     mat4 proj;
     mat4 view;
-    LightSource lights[MAX_LIGHTS];
     vec3 camPos;
     int light_number;
+    uvec4 clusterGrid;
+    vec4 clusterParams;
 } sb;
 
-layout(binding = 1) uniform UniformBufferObject {
+//Clustered lights, built on the CPU every frame
+layout(std430, binding = 5) readonly buffer LightBuffer {
+    LightSource lights[];
+} lb;
+
+layout(std430, binding = 6) readonly buffer ClusterBuffer {
+    uvec2 clusters[];
+} cb;
+
+layout(std430, binding = 7) readonly buffer LightIndexBuffer {
+    uint indices[];
+} lib;
+
+struct ObjectData {
     mat4 model;
     vec4 albedo;
     float roughness;
@@ -24,8 +45,14 @@ layout(binding = 1) uniform UniformBufferObject {
     float specular;
     float exposure;
     float gamma;
-    vec3 padding;
-} ubo;
+    float padding[7];
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} ob;
+
+ObjectData ubo;
 
 layout(binding = 2) uniform samplerCube samplerIrradiance;
 layout(binding = 3) uniform sampler2D samplerBRDFLUT;
@@ -33,6 +60,14 @@ layout(binding = 4) uniform samplerCube prefilteredMap;
 
 const float PI = 3.14159265359;
 
+//x: first light index, y: light count
+uvec2 GetCluster(vec3 position) {
+    float depth = max(-(sb.view * vec4(position, 1.0)).z, 0.0001);
+    uint slice = uint(max(log(depth) * sb.clusterParams.x + sb.clusterParams.y, 0.0));
+    uvec3 cluster = min(uvec3(uvec2(gl_FragCoord.xy * sb.clusterParams.zw), slice), sb.clusterGrid.xyz - uvec3(1));
+    return cb.clusters[cluster.x + sb.clusterGrid.x * (cluster.y + sb.clusterGrid.y * cluster.z)];
+}
+
 vec3 Uncharted2Tonemap(vec3 x) {
   float A = 0.15;
 	float B = 0.50;
@@ -43,6 +78,9 @@ vec3 Uncharted2Tonemap(vec3 x) {
 	return ((x*(A*x+C*B)+D*E)/(x*(A*x+B)+D*F))-E/F;
 }
 
+//1 / Uncharted2Tonemap(11.2), the white point
+const float kTonemapWhiteScale = 1.3790642;
+
 //Normal Distribution Function
 float NormalDistribution(float dotNH, float roughness) {
     float alpha = roughness * roughness;
@@ -70,8 +108,7 @@ vec3 FresnelR(float cos_theta, vec3 F0, float roughness) {
 }
 
 vec3 PrefilteredReflection(vec3 R, float roughness) {
-    const float kReflectionLod = 9.0;
-    float lod = roughness * kReflectionLod;
+    float lod = roughness * REFLECTION_LOD;
     float lodf = floor(lod);
     float lodc = ceil(lod);
     vec3 a = textureLod(prefilteredMap, R, lodf).rgb;
@@ -105,6 +142,7 @@ vec3 SpecularBRDF(vec3 L, vec3 V, vec3 N, float metallic, float roughness, vec3
 }
 
 void main() {
+  ubo = ob.objects[objectIndex];
   vec3 N = normalize(worldNormal);
   vec3 V = normalize(sb.camPos.xyz - worldPosition);
   vec3 R = reflect(-V, N);
@@ -115,14 +153,18 @@ void main() {
   F0 = mix(F0, ubo.albedo.rgb, metallic);
 
   vec3 Lo = vec3(0.0);
-  for (int i = 0; i < sb.light_number; i++) {
-      vec3 light_position = sb.lights[i].pos.xyz;
-      vec3 L = normalize(vec3(light_position - worldPosition));
-      float distance = length(light_position - worldPosition);
+  uvec2 cluster = GetCluster(worldPosition);
+  //Constant bound, the compiler can unroll it
+  for (uint i = 0; i < MAX_CLUSTER_LIGHTS; i++) {
+      if (i >= cluster.y) break;
+      LightSource light = lb.lights[lib.indices[cluster.x + i]];
+      vec3 light_vector = light.pos.xyz - worldPosition;
+      float distance = length(light_vector);
+      if (distance > light.pos.w) continue;
+      vec3 L = light_vector / distance;
       float attenuation = 1.0 / (distance * distance);
-      float c = step(distance, 5.0);
-      vec3 radiance = sb.lights[i].lightcolor.xyz * attenuation;
-      Lo += c * radiance * SpecularBRDF(L, V, N, metallic, roughness, F0);
+      vec3 radiance = light.lightcolor.rgb * light.lightcolor.w * attenuation;
+      Lo += radiance * SpecularBRDF(L, V, N, metallic, roughness, F0);
   }
 
   vec2 brdf = texture(samplerBRDFLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
@@ -141,8 +183,9 @@ void main() {
   vec3 color = ambient + Lo;
 
   //Tone mapping
-  color = Uncharted2Tonemap(color * ubo.exposure);
-  color = color * (1.0 / Uncharted2Tonemap(vec3(11.2)));
+  if (TONEMAP) {
+    color = Uncharted2Tonemap(color * ubo.exposure) * kTonemapWhiteScale;
+  }
 
   //Gamma correction
   color = pow(color, vec3(1.0 / ubo.gamma));
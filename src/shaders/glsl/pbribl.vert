@@ -6,18 +6,16 @@ layout(location = 1) in vec3 inNormal;
 
 layout(location = 0) out vec3 worldPosition;
 layout(location = 1) out vec3 worldNormal;
-
-#define LIGHT
+layout(location = 2) flat out uint objectIndex;
 
 layout(binding = 0) uniform SceneUniformBuffer {
     mat4 proj;
     mat4 view;
-    LightSource lights[MAX_LIGHTS];
     vec3 camPos;
     int light_number;
 } sb;
 
-layout(binding = 1) uniform UniformBufferObject {
+struct ObjectData {
     mat4 model;
     vec4 albedo;
     float roughness;
@@ -25,11 +23,20 @@ layout(binding = 1) uniform UniformBufferObject {
     float specular;
     float exposure;
     float gamma;
-    vec3 padding;
-} ubo;
+    float padding[7];
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} ob;
+
 
+//Matches the depth pre-pass
+invariant gl_Position;
 
 void main() {
+    ObjectData ubo = ob.objects[gl_InstanceIndex];
+    objectIndex = uint(gl_InstanceIndex);
     worldPosition = vec3(ubo.model * vec4(inPosition, 1.0));
     worldNormal = mat3(ubo.model) * inNormal;
     gl_Position = sb.proj * sb.view * vec4(worldPosition, 1.0);
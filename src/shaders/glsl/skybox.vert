@@ -9,14 +9,22 @@ layout(binding = 0) uniform SceneUniformBuffer {
     mat4 proj;
 } sb;
 
-layout(binding = 1) uniform UniformBufferObject {
+struct ObjectData {
     mat4 viewStatic;
-} ubo;
+    vec4 objectStride[4];
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} ob;
 
 layout(location = 0) out vec3 outPos;
 
 void main() {
+    ObjectData ubo = ob.objects[gl_InstanceIndex];
     outPos = inPosition;
     outPos.xy *= -1.0;
-    gl_Position = sb.proj * ubo.viewStatic * vec4(inPosition, 1.0);
+    vec4 position = sb.proj * ubo.viewStatic * vec4(inPosition, 1.0);
+    //z = w, at the far plane after the perspective divide
+    gl_Position = position.xyww;
 }
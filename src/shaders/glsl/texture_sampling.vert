@@ -5,27 +5,34 @@ layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inUv;
 
-#define LIGHT
-
 layout(binding = 0) uniform SceneUniformBuffer {
     mat4 proj;
     mat4 view;
     vec3 camPos;
-    LightSource lights[MAX_LIGHTS];
     int light_number;
 } sb;
 
-layout(binding = 1) uniform UniformBufferObject {
+struct ObjectData {
     mat4 model;
     int textureIndex;
-    vec3 padding;
-} ubo;
+    int padding[3];
+    vec4 objectStride[3];
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} ob;
 
 layout(location = 0) out vec2 outUv;
 layout(location = 1) out int outTIndex;
 
+//Matches the depth pre-pass
+invariant gl_Position;
+
 void main() {
-    gl_Position = sb.proj * sb.view * ubo.model * vec4(inPosition, 1.0);
+    ObjectData ubo = ob.objects[gl_InstanceIndex];
+    vec3 worldPosition = vec3(ubo.model * vec4(inPosition, 1.0));
+    gl_Position = sb.proj * sb.view * vec4(worldPosition, 1.0);
     outUv = inUv;
     outTIndex = ubo.textureIndex;
 }
@@ -0,0 +1,15 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 outUv;
+layout(location = 1) flat in int inTIndex;
+
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(location = 0) out vec4 finalColor;
+
+
+void main() {
+    finalColor = texture(textures[nonuniformEXT(inTIndex)], outUv);
+}
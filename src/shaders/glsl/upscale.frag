@@ -0,0 +1,20 @@
+#version 450
+
+layout (location = 0) in vec2 inUV;
+
+layout (binding = 0) uniform sampler2D sceneColor;
+
+//Scaled region of the scene color and its last texel center
+layout (push_constant) uniform UpscaleConstants {
+	vec2 uvScale;
+	vec2 uvMax;
+} pc;
+
+layout (location = 0) out vec4 outColor;
+
+void main()
+{
+	//Bilinear, clamped so no texel outside the region rendered this frame is filtered in
+	vec2 uv = min(inUV * pc.uvScale, pc.uvMax);
+	outColor = vec4(texture(sceneColor, uv).rgb, 1.0);
+}
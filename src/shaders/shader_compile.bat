@@ -1,7 +1,6 @@
 @echo off
 setlocal ENABLEDELAYEDEXPANSION
 
-set MAX_LIGHTS=#define MAX_LIGHTS 25
 set LIGHT_DATA=struct LightSource{vec4 pos; vec4 lightcolor;};
 set LIGHT_DEFINE="#define LIGHT"
 
@@ -9,7 +8,6 @@ FOR %%a IN (glsl\*.vert) DO (
     FOR /f "delims=" %%i IN (%%a) DO (
         set var=%%i
         if "%%i"==%LIGHT_DEFINE% (
-            echo %MAX_LIGHTS% >> output.vert
             set var=%LIGHT_DATA%
         )
         echo !var! >> output.vert
@@ -22,7 +20,6 @@ FOR %%a IN (glsl\*.frag) DO (
     FOR /f "delims=" %%i IN (%%a) DO (
         set var=%%i
         if "%%i"==%LIGHT_DEFINE% (
-            echo %MAX_LIGHTS% >> output.frag
             set var=%LIGHT_DATA%
         )
         echo !var! >> output.frag
@@ -31,4 +28,8 @@ FOR %%a IN (glsl\*.frag) DO (
     del output.frag
 )
 
+FOR %%a IN (glsl\*.comp) DO (
+    .\..\..\deps\vulkan\Bin32\glslc.exe %%a -o spir-v\%%~na_comp.spv
+)
+
 pause
\ No newline at end of file
@@ -139,7 +139,7 @@ void UserMain::init()
   terraingeo.alloc();
   terraingeo->initWithPrimitive(PrimitiveType::kPrimitiveType_Terrain);
   terraintr.alloc();
-  terraintr->setPosition(0.0f, 5.0f, 0.0f);
+  terraintr->setPosition(-1024.0f, 5.0f, -1024.0f);
 
   terrainmat.alloc();
   terrainmat->setMaterialType(MaterialType::kMaterialType_Noise);
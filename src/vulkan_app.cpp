@@ -17,6 +17,11 @@
 #include "dev/vktexture.h"
 #include "glm/gtx/transform.hpp"
 #include "perlin_noise.h"
+#include "dev/task_graph.h"
+#include <cfloat>
+#include <thread>
+#include <algorithm>
+#include <fstream>
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
 
@@ -91,7 +96,7 @@ void VulkanApp::createAppInstance()
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "My Vulkan Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  appInfo.apiVersion = VK_API_VERSION_1_1;
 
   uint32 glfwExtensionCount = 0;
   const char** glfwExtension;
@@ -184,7 +189,7 @@ static bool checkDeviceExtensionSupport(VkPhysicalDevice device)
 
 /************************************************************************************************/
 
-static int32 rateDeviceSuitability(VkPhysicalDevice device, Context context) {
+static int32 rateDeviceSuitability(VkPhysicalDevice device, Context& context) {
   int32 score = 0;
   VkPhysicalDeviceProperties deviceProperties;
   VkPhysicalDeviceFeatures deviceFeatures;
@@ -238,6 +243,48 @@ void VulkanApp::setupPhysicalDevice()
 
 /**********************************LOGICAL DEVICE*********************************************/
 
+static bool checkDeviceExtension(VkPhysicalDevice device, const char* extension_name)
+{
+  uint32 extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> avaliableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, avaliableExtensions.data());
+
+  for (const auto& extension : avaliableExtensions) {
+    if (strcmp(extension.extensionName, extension_name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool checkDescriptorIndexingSupport(VkPhysicalDevice device)
+{
+  if (!checkDeviceExtension(device, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) return false;
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT };
+  VkPhysicalDeviceFeatures2 features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+  features.pNext = &indexingFeatures;
+  vkGetPhysicalDeviceFeatures2(device, &features);
+
+  return indexingFeatures.runtimeDescriptorArray &&
+         indexingFeatures.descriptorBindingPartiallyBound &&
+         indexingFeatures.descriptorBindingVariableDescriptorCount &&
+         indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+         indexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+}
+
+//Streamed textures rewrite elements of the bindless array while frames using other elements are pending
+static bool checkTextureStreamingSupport(VkPhysicalDevice device)
+{
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT };
+  VkPhysicalDeviceFeatures2 features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+  features.pNext = &indexingFeatures;
+  vkGetPhysicalDeviceFeatures2(device, &features);
+
+  return indexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+}
+
 void VulkanApp::createLogicalDevice()
 {
   QueueFamilyIndices indices = dev::StaticHelpers::findQueueFamilies(context_->physDevice_, context_->surface);
@@ -258,13 +305,68 @@ void VulkanApp::createLogicalDevice()
   deviceFeatures.samplerAnisotropy = VK_TRUE;
   //vkGetPhysicalDeviceFeatures(context_->physDevice_, &deviceFeatures);
 
+  std::vector<const char*> extensions(deviceExtensions.begin(), deviceExtensions.end());
+
+  //Bindless textures, falls back to per material samplers if not supported
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT };
+  context_->caps.descriptorIndexing = enableBindlessTextures && checkDescriptorIndexingSupport(context_->physDevice_);
+  if (context_->caps.descriptorIndexing) {
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+    context_->caps.textureStreaming = enableTextureStreaming && checkTextureStreamingSupport(context_->physDevice_);
+    if (context_->caps.textureStreaming) {
+      indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    }
+  }
+
+  //GPU culling writes one indirect command per object, the count draw is optional
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(context_->physDevice_, &supportedFeatures);
+  context_->caps.gpuCulling = enableGPUCulling && supportedFeatures.multiDrawIndirect &&
+                              supportedFeatures.drawIndirectFirstInstance;
+  if (context_->caps.gpuCulling) {
+    deviceFeatures.multiDrawIndirect = VK_TRUE;
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+    context_->caps.drawIndirectCount = checkDeviceExtension(context_->physDevice_, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if (context_->caps.drawIndirectCount) {
+      extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+  }
+
+  //Line rasterization for the wireframe render state
+  context_->caps.wireframe = supportedFeatures.fillModeNonSolid;
+  deviceFeatures.fillModeNonSolid = supportedFeatures.fillModeNonSolid;
+
+  //Block compressed 2D textures loaded from ktx files
+  deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+  deviceFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+
+  //Timestamps around every pass, pipeline statistics only when the feature is there
+  context_->caps.gpuProfiler = enableGPUProfiler &&
+                               vkdev::GPUProfiler::isSupported(context_->physDevice_, indices.graphicsFamily);
+  context_->caps.pipelineStatistics = context_->caps.gpuProfiler && supportedFeatures.pipelineStatisticsQuery;
+  deviceFeatures.pipelineStatisticsQuery = context_->caps.pipelineStatistics;
+  //The render scale follows the frame time measured by the profiler
+  context_->caps.dynamicResolution = enableDynamicResolution && context_->caps.gpuProfiler;
+
+  context_->caps.gpuNoise = enableGPUNoise && vkdev::NoiseGenerator::isSupported(context_->physDevice_);
+  if (context_->caps.gpuNoise) {
+    deviceFeatures.shaderStorageImageExtendedFormats = VK_TRUE;
+  }
+
   VkDeviceCreateInfo deviceInfo{};
   deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  deviceInfo.pNext = context_->caps.descriptorIndexing ? &indexingFeatures : nullptr;
   deviceInfo.pQueueCreateInfos = queueCreateInfos.data();
   deviceInfo.queueCreateInfoCount = static_cast<uint32>(queueCreateInfos.size());
   deviceInfo.pEnabledFeatures = &deviceFeatures;
-  deviceInfo.enabledExtensionCount = static_cast<uint32>(deviceExtensions.size());
-  deviceInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  deviceInfo.enabledExtensionCount = static_cast<uint32>(extensions.size());
+  deviceInfo.ppEnabledExtensionNames = extensions.data();
 
   if (enableValidationLayers) {
     deviceInfo.enabledLayerCount = static_cast<uint32>(validationLayers.size());
@@ -377,6 +479,7 @@ void VulkanApp::createSwapChain()
 
   initFrameData(swapImageCount);
   context_->swapchainImageViews.resize(swapImageCount);
+  context_->swapchainImages = swap_chain_images;
   for (size_t i = 0; i < swapImageCount; i++) {
     context_->swapchainImageViews[i] = dev::StaticHelpers::createTextureImageView(context_->logDevice_, 
                                                                                   swap_chain_images[i],
@@ -400,6 +503,20 @@ void VulkanApp::createPipelineLayout()
     pipelineLayoutInfo.setLayoutCount = 1;
     pipelineLayoutInfo.pSetLayouts = &res->layouts[i].descriptor;
 
+    VkDescriptorSetLayout bindless_layouts[] = { res->layouts[i].descriptor, res->bindless.layout };
+    if (i == kLayoutType_Texture_Bindless) {
+      if (!context_->caps.descriptorIndexing) continue;
+      pipelineLayoutInfo.setLayoutCount = 2;
+      pipelineLayoutInfo.pSetLayouts = bindless_layouts;
+    }
+
+    //Terrain quadtree node of the patch being drawn
+    VkPushConstantRange terrain_range{ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(TerrainConstants) };
+    if (i == kLayoutType_Noise) {
+      pipelineLayoutInfo.pushConstantRangeCount = 1;
+      pipelineLayoutInfo.pPushConstantRanges = &terrain_range;
+    }
+
     vkCreatePipelineLayout(context_->logDevice_, &pipelineLayoutInfo, nullptr, &res->layouts[i].pipeline);
   }
 }
@@ -416,60 +533,118 @@ void VulkanApp::createPipelineCache()
 
 void VulkanApp::createInternalMaterials()
 {
-  //Resources* res = ResourceManager::Get()->getResources();
+  vkdev::PipelineStateCache* states = &resources_->pipelineStates;
+  states->create(context_, resources_->pipelineCache);
+
   InternalMaterial* material = &resources_->internalMaterials[(int32)MaterialType::kMaterialType_UnlitColor];
   material->layout = kLayoutType_Simple_2Binds;
-  material->matPipeline = dev::StaticHelpers::createPipeline(context_, 
-                                                             "./../../src/shaders/spir-v/unlit_color_vert.spv",
-                                                             "./../../src/shaders/spir-v/unlit_color_frag.spv",
-                                                             resources_->layouts[kLayoutType_Simple_2Binds].pipeline, 
-                                                             VK_CULL_MODE_FRONT_BIT, VK_TRUE);
+  states->setMaterial((uint32)MaterialType::kMaterialType_UnlitColor,
+                      { "./../../src/shaders/spir-v/unlit_color_vert.spv",
+                        "./../../src/shaders/spir-v/unlit_color_frag.spv",
+                        resources_->layouts[kLayoutType_Simple_2Binds].pipeline,
+                        VK_CULL_MODE_FRONT_BIT, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS, 3 });
 
+  //Light loop bound and tone mapping are specialized into both PBR shaders
   material = &resources_->internalMaterials[(int32)MaterialType::kMaterialType_BasicPBR];
   material->layout = kLayoutType_Simple_2Binds;
-  material->matPipeline = dev::StaticHelpers::createPipeline(context_, 
-                                                             "./../../src/shaders/spir-v/basic_pbr_vert.spv",
-                                                             "./../../src/shaders/spir-v/basic_pbr_frag.spv",
-                                                             resources_->layouts[kLayoutType_Simple_2Binds].pipeline, 
-                                                             VK_CULL_MODE_FRONT_BIT, VK_TRUE);
+  PipelineDesc desc = { "./../../src/shaders/spir-v/basic_pbr_vert.spv",
+                        "./../../src/shaders/spir-v/basic_pbr_frag.spv",
+                        resources_->layouts[kLayoutType_Simple_2Binds].pipeline,
+                        VK_CULL_MODE_FRONT_BIT, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS, 3 };
+  desc.specCount = 2;
+  desc.specData[0] = kMaxClusterLights;
+  desc.specData[1] = enableTonemapping ? VK_TRUE : VK_FALSE;
+  states->setMaterial((uint32)MaterialType::kMaterialType_BasicPBR, desc);
 
   material = &resources_->internalMaterials[(int32)MaterialType::kMaterialType_TextureSampler];
-  material->layout = kLayoutType_Texture_3Binds;
-  material->matPipeline = dev::StaticHelpers::createPipeline(context_, 
-                                                             "./../../src/shaders/spir-v/texture_sampling_vert.spv",
-                                                             "./../../src/shaders/spir-v/texture_sampling_frag.spv",
-                                                             resources_->layouts[kLayoutType_Texture_3Binds].pipeline, 
-                                                             VK_CULL_MODE_FRONT_BIT, VK_TRUE);
+  if (context_->caps.descriptorIndexing) {
+    material->layout = kLayoutType_Texture_Bindless;
+    states->setMaterial((uint32)MaterialType::kMaterialType_TextureSampler,
+                        { "./../../src/shaders/spir-v/texture_sampling_vert.spv",
+                          "./../../src/shaders/spir-v/texture_sampling_bindless_frag.spv",
+                          resources_->layouts[kLayoutType_Texture_Bindless].pipeline,
+                          VK_CULL_MODE_FRONT_BIT, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS, 3 });
+  }
+  else {
+    material->layout = kLayoutType_Texture_3Binds;
+    states->setMaterial((uint32)MaterialType::kMaterialType_TextureSampler,
+                        { "./../../src/shaders/spir-v/texture_sampling_vert.spv",
+                          "./../../src/shaders/spir-v/texture_sampling_frag.spv",
+                          resources_->layouts[kLayoutType_Texture_3Binds].pipeline,
+                          VK_CULL_MODE_FRONT_BIT, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS, 3 });
+  }
 
   material = &resources_->internalMaterials[(int32)MaterialType::kMaterialType_Skybox];
   material->layout = kLayoutType_Texture_Cubemap;
-  material->matPipeline = dev::StaticHelpers::createPipeline(context_, 
-                                                             "./../../src/shaders/spir-v/skybox_vert.spv",
-                                                             "./../../src/shaders/spir-v/skybox_frag.spv",
-                                                             resources_->layouts[kLayoutType_Texture_Cubemap].pipeline,
-                                                             VK_CULL_MODE_BACK_BIT, VK_FALSE);
-
+  //Projected at the far plane, shades the pixels no opaque draw covered
+  material->queue = kRenderQueue_Skybox;
+  states->setMaterial((uint32)MaterialType::kMaterialType_Skybox,
+                      { "./../../src/shaders/spir-v/skybox_vert.spv",
+                        "./../../src/shaders/spir-v/skybox_frag.spv",
+                        resources_->layouts[kLayoutType_Texture_Cubemap].pipeline,
+                        VK_CULL_MODE_BACK_BIT, VK_POLYGON_MODE_FILL, VK_TRUE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL, 3 });
 
   material = &resources_->internalMaterials[(int32)MaterialType::kMaterialType_PBRIBL];
   material->layout = kLayoutType_PBRIBL;
-  material->matPipeline = dev::StaticHelpers::createPipeline(context_, 
-                                                             "./../../src/shaders/spir-v/pbribl_vert.spv",
-                                                             "./../../src/shaders/spir-v/pbribl_frag.spv",
-                                                             resources_->layouts[kLayoutType_PBRIBL].pipeline,
-                                                             VK_CULL_MODE_FRONT_BIT, VK_TRUE, 2);
+  desc = { "./../../src/shaders/spir-v/pbribl_vert.spv",
+           "./../../src/shaders/spir-v/pbribl_frag.spv",
+           resources_->layouts[kLayoutType_PBRIBL].pipeline,
+           VK_CULL_MODE_FRONT_BIT, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS, 2 };
+  //Roughness 1 samples the last mip of the prefiltered cube
+  float reflection_lod = floor(log2((float)kPrefilteredCubeSize));
+  desc.specCount = 3;
+  desc.specData[0] = kMaxClusterLights;
+  desc.specData[1] = enableTonemapping ? VK_TRUE : VK_FALSE;
+  memcpy(&desc.specData[2], &reflection_lod, sizeof(float));
+  states->setMaterial((uint32)MaterialType::kMaterialType_PBRIBL, desc);
 
   material = &resources_->internalMaterials[(int32)MaterialType::kMaterialType_Noise];
   material->layout = kLayoutType_Noise;
-  material->matPipeline = dev::StaticHelpers::createPipeline(context_,
-                                                             "./../../src/shaders/spir-v/noise_vert.spv",
-                                                             "./../../src/shaders/spir-v/noise_frag.spv",
-                                                             resources_->layouts[kLayoutType_Noise].pipeline,
-                                                             VK_CULL_MODE_FRONT_BIT, VK_TRUE, 3);
+  states->setMaterial((uint32)MaterialType::kMaterialType_Noise,
+                      { "./../../src/shaders/spir-v/noise_vert.spv",
+                        "./../../src/shaders/spir-v/noise_frag.spv",
+                        resources_->layouts[kLayoutType_Noise].pipeline,
+                        VK_CULL_MODE_FRONT_BIT, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS, 3 });
+
+  //Meshes fetch positions only in the depth pre-pass, the terrain is displaced by its own vertex shader
+  const char* depth_vert = "./../../src/shaders/spir-v/depth_only_vert.spv";
+  uint8 depth_desc = (uint8)VertexDescriptor::kVertexDescriptor_Pos;
+  states->setDepthShader((uint32)MaterialType::kMaterialType_UnlitColor, depth_vert, depth_desc);
+  states->setDepthShader((uint32)MaterialType::kMaterialType_BasicPBR, depth_vert, depth_desc);
+  states->setDepthShader((uint32)MaterialType::kMaterialType_TextureSampler, depth_vert, depth_desc);
+  states->setDepthShader((uint32)MaterialType::kMaterialType_PBRIBL, depth_vert, depth_desc);
+
+  //Unlit color is built first as the base every other pipeline derives from,
+  //the rest compile at the same time against the shared pipeline cache
+  uint32 main_state = enableDepthPrepass ? kRenderState_DepthEqual : kRenderState_Default;
+  vkdev::TaskGraph pipelines;
+  uint32 base = pipelines.addTask("unlit color pipeline", [this, states, main_state]() {
+    InternalMaterial* material = &resources_->internalMaterials[(int32)MaterialType::kMaterialType_UnlitColor];
+    material->matPipeline = states->getPipeline((uint32)MaterialType::kMaterialType_UnlitColor, main_state);
+  });
+  for (int32 i = (int32)MaterialType::kMaterialType_BasicPBR; i < (int32)MaterialType::kMaterialType_MAX; i++) {
+    pipelines.addTask("material pipeline", [this, states, main_state, i]() {
+      InternalMaterial* material = &resources_->internalMaterials[i];
+      uint32 state = material->queue == kRenderQueue_Opaque ? main_state : kRenderState_Default;
+      material->matPipeline = states->getPipeline(i, state);
+    }, { base });
+  }
+  //The skybox doesn't write depth, it has no pre-pass pipeline
+  for (int32 i = 0; enableDepthPrepass && i < (int32)MaterialType::kMaterialType_MAX; i++) {
+    if (i == (int32)MaterialType::kMaterialType_Skybox) continue;
+    pipelines.addTask("depth pipeline", [this, states, i]() {
+      resources_->internalMaterials[i].depthPipeline = states->getPipeline(i, kRenderState_DepthOnly);
+    }, { base });
+  }
+  pipelines.run(std::max(std::thread::hardware_concurrency(), 2u));
 
+  //Render state variants drawn by the last run
+  states->warm(kPipelineVariantsPath);
 }
 
 /*********************************************************************************************/
 
+//Pipelines are created against this pass, the frame graph begins compatible ones with its own load and store ops
 void VulkanApp::createRenderPass()
 {
   VkAttachmentDescription colorAttachment{};
@@ -547,31 +722,178 @@ void VulkanApp::createRenderPass()
 #else
   assert(vkCreateRenderPass(context_->logDevice_, &renderPassInfo, nullptr, &context_->renderPass) == VK_SUCCESS);
 #endif
-}
 
-/*********************************************************************************************/
+  //Same depth attachment alone, for the pipelines of the depth pre-pass
+  VkAttachmentReference depth_only_ref{};
+  depth_only_ref.attachment = 0;
+  depth_only_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-void VulkanApp::createFramebuffer()
-{
-  int32 imageCount = context_->swapchainImageViews.size();
-  context_->swapchainFramebuffers.resize(imageCount);
-  for (size_t i = 0; i < imageCount; i++) {
-    std::array<VkImageView, 2> attachment = { context_->swapchainImageViews[i], resources_->depthAttachment.view_ };
-    VkFramebufferCreateInfo framebufferInfo{};
-    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebufferInfo.renderPass = context_->renderPass;
-    framebufferInfo.attachmentCount = static_cast<uint32>(attachment.size());
-    framebufferInfo.pAttachments = attachment.data();
-    framebufferInfo.width = context_->swapchainDimensions.width;
-    framebufferInfo.height = context_->swapchainDimensions.height;
-    framebufferInfo.layers = 1;
+  VkSubpassDescription depth_subpass{};
+  depth_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  depth_subpass.pDepthStencilAttachment = &depth_only_ref;
+
+  VkRenderPassCreateInfo depthPassInfo{};
+  depthPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  depthPassInfo.attachmentCount = 1;
+  depthPassInfo.pAttachments = &depth_attachment;
+  depthPassInfo.subpassCount = 1;
+  depthPassInfo.pSubpasses = &depth_subpass;
 
 #ifdef NDEBUG
-    vkCreateFramebuffer(context_->logDevice_, &framebufferInfo, nullptr, &context_->swapchainFramebuffers[i]);
+  vkCreateRenderPass(context_->logDevice_, &depthPassInfo, nullptr, &context_->depthRenderPass);
 #else
-    assert(vkCreateFramebuffer(context_->logDevice_, &framebufferInfo, nullptr, &context_->swapchainFramebuffers[i]) == VK_SUCCESS);
+  assert(vkCreateRenderPass(context_->logDevice_, &depthPassInfo, nullptr, &context_->depthRenderPass) == VK_SUCCESS);
 #endif
+}
+
+/*********************************************************************************************/
+
+void VulkanApp::createRenderGraph()
+{
+  FrameGraph* frame = &resources_->frameGraph;
+  vkdev::RenderGraph* graph = &frame->graph;
+  bool gpu_culling = context_->caps.gpuCulling;
+  graph->create(context_);
+  graph->setProfiler(&resources_->gpuProfiler);
+
+  VkFormat depth_format = dev::StaticHelpers::findDepthFormat(context_);
+  VkImageAspectFlags depth_aspect = depth_format == VK_FORMAT_D32_SFLOAT ? VK_IMAGE_ASPECT_DEPTH_BIT :
+                                    VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+  frame->swapchain = graph->importImage("swapchain", context_->swapchainDimensions.format, VK_IMAGE_ASPECT_COLOR_BIT,
+                                        1, 1, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false);
+  frame->depth = graph->importImage("depth", depth_format, depth_aspect, 1, 1, VK_IMAGE_LAYOUT_UNDEFINED, true);
+  graph->bindImage(frame->depth, resources_->depthAttachment.image_, resources_->depthAttachment.view_,
+                   resources_->depthAttachment.width_, resources_->depthAttachment.height_);
+  graph->markOutput(frame->swapchain);
+
+  //Scene passes draw the scaled region of full size targets, upscaled to the swapchain at the end
+  vkdev::DynamicResolution* resolution = &resources_->dynamicResolution;
+  resolution->setExtent(context_->swapchainDimensions.width, context_->swapchainDimensions.height);
+  bool upscale = context_->caps.dynamicResolution;
+  uint32 scene_color = frame->swapchain;
+  if (upscale) {
+    frame->color = graph->createImage("scene color", context_->swapchainDimensions.format, VK_IMAGE_ASPECT_COLOR_BIT,
+                                      context_->swapchainDimensions.width, context_->swapchainDimensions.height,
+                                      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    scene_color = frame->color;
+  }
+
+  //Uploads and noise keep their own barriers, nothing else in the frame writes what they touch
+  uint32 stream = graph->addPass("stream", kRenderPassType_Transfer, [this, frame](VkCommandBuffer cmd_buffer) {
+    resources_->heightmap.upload(cmd_buffer, frame->frameIndex);
+    resources_->textureStreamer.update(cmd_buffer);
+  });
+  graph->setSideEffects(stream);
+
+  if (resources_->noiseGenerator.isAnimated()) {
+    uint32 noise = graph->addPass("noise", kRenderPassType_Compute, [this](VkCommandBuffer cmd_buffer) {
+      resources_->noiseGenerator.generate(cmd_buffer, static_cast<float>(glfwGetTime()) * kNoiseAnimationSpeed);
+    });
+    graph->setSideEffects(noise);
+  }
+
+  if (gpu_culling) {
+    vkdev::GPUCulling* culling = &resources_->gpuCulling;
+    frame->pyramid = graph->importImage("depth pyramid", VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT,
+                                        culling->getPyramidLevels(), 1, VK_IMAGE_LAYOUT_UNDEFINED, true);
+    graph->bindImage(frame->pyramid, culling->getPyramidImage(), VK_NULL_HANDLE, 0, 0);
+    frame->indirect = graph->importBuffer("indirect draws");
+    frame->count = graph->importBuffer("draw counts");
+
+    uint32 cull = graph->addPass("cull", kRenderPassType_Compute, [culling, frame](VkCommandBuffer cmd_buffer) {
+      culling->cull(cmd_buffer, frame->frameIndex);
+    });
+    VkPipelineStageFlags cull_stages = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkAccessFlags cull_access = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    graph->read(cull, frame->pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_GENERAL);
+    graph->write(cull, frame->indirect, cull_stages, cull_access);
+    graph->write(cull, frame->count, cull_stages, cull_access);
+  }
+
+  VkClearValue clear_depth{};
+  clear_depth.depthStencil = { 1.0f, 0 };
+  uint32 prepass = 0;
+  if (enableDepthPrepass) {
+    prepass = graph->addPass("depth prepass", kRenderPassType_Graphics, [this, frame, gpu_culling](VkCommandBuffer cmd_buffer) {
+      uint32 index = frame->frameIndex;
+      int64_t padding = sizeof(UniformBlocks);
+      resources_->dynamicResolution.setViewport(cmd_buffer);
+
+      DrawCmd drawcmd(true);
+      for (const DrawCallData& draw_call : resources_->draw_calls) {
+        drawcmd.Execute(cmd_buffer, draw_call, index, padding);
+      }
+      if (gpu_culling) {
+        for (int32 i = 0; i < (int32)MaterialType::kMaterialType_MAX; i++) {
+          drawcmd.ExecuteIndirect(cmd_buffer, i, index);
+        }
+      }
+      drawcmd.ExecuteTerrain(cmd_buffer, index);
+    });
+    graph->writeDepth(prepass, frame->depth, &clear_depth);
+    if (gpu_culling) {
+      graph->read(prepass, frame->indirect, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+      graph->read(prepass, frame->count, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    }
+  }
+
+  uint32 main = graph->addPass("main", kRenderPassType_Graphics, [this, frame, gpu_culling](VkCommandBuffer cmd_buffer) {
+    uint32 index = frame->frameIndex;
+    int64_t padding = sizeof(UniformBlocks);
+    resources_->dynamicResolution.setViewport(cmd_buffer);
+
+    //Queue by queue, the terrain with the opaques so the skybox is tested against it
+    DrawCmd drawcmd;
+    std::vector<DrawCallData>& draw_calls = resources_->draw_calls;
+    uint32 next = 0;
+    for (uint32 queue = 0; queue < kRenderQueue_MAX; queue++) {
+      for (; next < draw_calls.size() && draw_calls[next].renderQueue == queue; next++) {
+        drawcmd.Execute(cmd_buffer, draw_calls[next], index, padding);
+      }
+      for (int32 i = 0; gpu_culling && i < (int32)MaterialType::kMaterialType_MAX; i++) {
+        if (resources_->internalMaterials[i].queue == queue) drawcmd.ExecuteIndirect(cmd_buffer, i, index);
+      }
+      if (queue == kRenderQueue_Opaque) drawcmd.ExecuteTerrain(cmd_buffer, index);
+    }
+    draw_calls.clear();
+  });
+
+  VkClearValue clear_color{};
+  clear_color.color = { 0.0f, 0.0f, 0.0f, 1.0f };
+  graph->writeColor(main, scene_color, &clear_color);
+  //Tested with EQUAL against the depth of the pre-pass
+  graph->writeDepth(main, frame->depth, enableDepthPrepass ? nullptr : &clear_depth);
+
+  if (gpu_culling) {
+    graph->read(main, frame->indirect, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    graph->read(main, frame->count, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+    //Built from the depth of this frame, read by the cull pass of the next one
+    vkdev::GPUCulling* culling = &resources_->gpuCulling;
+    uint32 pyramid = graph->addPass("depth pyramid", kRenderPassType_Compute, [culling](VkCommandBuffer cmd_buffer) {
+      culling->buildDepthPyramid(cmd_buffer);
+    });
+    graph->read(pyramid, frame->depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    graph->write(pyramid, frame->pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                 VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+    graph->markOutput(frame->pyramid);
+  }
+
+  uint32 upscale_pass = 0;
+  if (upscale) {
+    upscale_pass = graph->addPass("upscale", kRenderPassType_Graphics, [resolution](VkCommandBuffer cmd_buffer) {
+      resolution->upscale(cmd_buffer);
+    });
+    graph->read(upscale_pass, frame->color, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    graph->writeColor(upscale_pass, frame->swapchain, &clear_color);
   }
+
+  graph->compile();
+  //The scene color only has a view once the graph placed it
+  if (upscale) resolution->create(context_, graph->getRenderPass(upscale_pass), graph->getView(frame->color));
 }
 
 /*********************************************************************************************/
@@ -602,7 +924,10 @@ void VulkanApp::createDepthResource()
   depth->device_ = context_->logDevice_;
   depth->width_ = k_wWidth;
   depth->height_ = k_wHeight;
-  depth->createImage(context_->physDevice_, depth_format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 1, 0);
+  //Sampled by the depth pyramid of the GPU culling
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  if (context_->caps.gpuCulling) usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+  depth->createImage(context_->physDevice_, depth_format, usage, 1, 0);
   depth->view_ = dev::StaticHelpers::createTextureImageView(context_->logDevice_, 
                                                             depth->image_, 
                                                             depth_format, 
@@ -613,14 +938,27 @@ void VulkanApp::createDepthResource()
 
 /*********************************************************************************************/
 
-void VulkanApp::storeTextures()
+void VulkanApp::storeTextures(vkdev::DecodedImage* decoded)
 {
   uint32 textures_number = Scene::textureCount;
   resources_->itextures.resize(textures_number);
 
+  bool streaming = context_->caps.textureStreaming;
+  if (streaming) {
+    resources_->textureStreamer.create(context_, textures_number,
+                                       static_cast<uint32>(context_->swapchainImageViews.size()));
+  }
+
   for (size_t i = 0; i < textures_number; i++) {
     Texture* user_texture = Scene::userTextures[i].get();
     //vkdev::VkTexture new_texture;
+    VkFormat format = dev::StaticHelpers::getTextureFormat(user_texture->getFormat());
+    //Only the mip tail is loaded, files that cannot be streamed are fully loaded
+    if (streaming && user_texture->getType() == TextureType::kTextureType_2D &&
+        resources_->textureStreamer.addTexture(static_cast<uint32>(i), &resources_->itextures[i],
+                                               user_texture->getPath().c_str(), format))
+      continue;
+
     if (user_texture->getType() == TextureType::kTextureType_Cubemap)
       resources_->itextures[i].loadCubemapKtx(context_, 
                                               user_texture->getPath().c_str(), 
@@ -629,7 +967,7 @@ void VulkanApp::storeTextures()
     else
       resources_->itextures[i].loadImage(context_, 
                                          user_texture->getPath().c_str(), 
-                                         dev::StaticHelpers::getTextureFormat(user_texture->getFormat()));
+                                         format, &decoded[i]);
   }
 }
 
@@ -892,11 +1230,8 @@ void VulkanApp::generateBRDFLUT()
   pipelineCI.pVertexInputState = &emptyInputState;
 
 
-  auto vertex_shader = dev::StaticHelpers::loadShader("./../../src/shaders/spir-v/genbrdflut_vert.spv");
-  auto fragment_shader = dev::StaticHelpers::loadShader("./../../src/shaders/spir-v/genbrdflut_frag.spv");
-  
-  VkShaderModule vert_module = dev::StaticHelpers::createShaderModule(context_->logDevice_, vertex_shader);
-  VkShaderModule frag_module = dev::StaticHelpers::createShaderModule(context_->logDevice_, fragment_shader);
+  VkShaderModule vert_module = context_->shaderCache.getModule(context_->logDevice_, "./../../src/shaders/spir-v/genbrdflut_vert.spv");
+  VkShaderModule frag_module = context_->shaderCache.getModule(context_->logDevice_, "./../../src/shaders/spir-v/genbrdflut_frag.spv");
   
   VkPipelineShaderStageCreateInfo vertexShaderInfo{};
   vertexShaderInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -909,6 +1244,9 @@ void VulkanApp::generateBRDFLUT()
   fragmentShaderInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   fragmentShaderInfo.module = frag_module;
   fragmentShaderInfo.pName = "main";
+  VkSpecializationMapEntry spec_entry;
+  VkSpecializationInfo spec_info = dev::StaticHelpers::specializationInfo(&kBRDFSamples, 1, &spec_entry);
+  fragmentShaderInfo.pSpecializationInfo = &spec_info;
   
   VkPipelineShaderStageCreateInfo shaderInfo[]{ vertexShaderInfo, fragmentShaderInfo };
   pipelineCI.stageCount = 2;
@@ -918,9 +1256,6 @@ void VulkanApp::generateBRDFLUT()
   VkPipeline pipeline;
   vkCreateGraphicsPipelines(context_->logDevice_, resources_->pipelineCache, 1, &pipelineCI, nullptr, &pipeline);
 
-  vkDestroyShaderModule(context_->logDevice_, vert_module, nullptr);
-  vkDestroyShaderModule(context_->logDevice_, frag_module, nullptr);
-
   // Render
   VkClearValue clearValues[1];
   clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
@@ -934,6 +1269,7 @@ void VulkanApp::generateBRDFLUT()
   renderPassBeginInfo.framebuffer = framebuffer;
 
   VkCommandBuffer cmdBuf = dev::StaticHelpers::beginSingleTimeCommands(context_);
+  resources_->gpuProfiler.beginImmediate(cmdBuf, "brdf lut");
   vkCmdBeginRenderPass(cmdBuf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
   VkViewport viewport{};
   viewport.width = (float)dim;
@@ -952,7 +1288,9 @@ void VulkanApp::generateBRDFLUT()
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
   vkCmdDraw(cmdBuf, 3, 1, 0, 0);
   vkCmdEndRenderPass(cmdBuf);
+  resources_->gpuProfiler.endScope(cmdBuf);
   dev::StaticHelpers::endSingleTimeCommands(context_, cmdBuf);
+  resources_->gpuProfiler.collectImmediate();
 
   vkDestroyPipeline(context_->logDevice_, pipeline, nullptr);
   vkDestroyPipelineLayout(context_->logDevice_, pipelinelayout, nullptr);
@@ -1100,9 +1438,6 @@ void VulkanApp::generateIrradianceCube()
   // Pipeline layout
   struct PushBlock {
     glm::mat4 mvp;
-    // Sampling deltas
-    float deltaPhi = (2.0f * PI) / 180.0f;
-    float deltaTheta = (0.5f * PI) / 64.0f;
   } pushBlock;
 
   VkPipelineLayout pipelinelayout;
@@ -1184,11 +1519,12 @@ void VulkanApp::generateIrradianceCube()
 
   pipelineCI.pVertexInputState = &vertexInputInfo;
 
-  auto vertex_shader = dev::StaticHelpers::loadShader("./../../src/shaders/spir-v/filtercube_vert.spv");
-  auto fragment_shader = dev::StaticHelpers::loadShader("./../../src/shaders/spir-v/irradiancecube_frag.spv");
-
-  VkShaderModule vert_module = dev::StaticHelpers::createShaderModule(context_->logDevice_, vertex_shader);
-  VkShaderModule frag_module = dev::StaticHelpers::createShaderModule(context_->logDevice_, fragment_shader);
+  VkShaderModule vert_module = context_->shaderCache.getModule(context_->logDevice_, "./../../src/shaders/spir-v/filtercube_vert.spv");
+  VkShaderModule frag_module = context_->shaderCache.getModule(context_->logDevice_, "./../../src/shaders/spir-v/irradiancecube_frag.spv");
+  //Sampling deltas
+  float deltas[] = { kIrradianceDeltaPhi, kIrradianceDeltaTheta };
+  VkSpecializationMapEntry spec_entries[2];
+  VkSpecializationInfo spec_info = dev::StaticHelpers::specializationInfo(deltas, 2, spec_entries);
 
   shaderStages[0] = {};
   shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -1201,13 +1537,11 @@ void VulkanApp::generateIrradianceCube()
   shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   shaderStages[1].module = frag_module;
   shaderStages[1].pName = "main";
+  shaderStages[1].pSpecializationInfo = &spec_info;
 
   VkPipeline pipeline;
   vkCreateGraphicsPipelines(context_->logDevice_, resources_->pipelineCache, 1, &pipelineCI, nullptr, &pipeline);
 
-  vkDestroyShaderModule(context_->logDevice_, vert_module, nullptr);
-  vkDestroyShaderModule(context_->logDevice_, frag_module, nullptr);
-
   // Render
   VkClearValue clearValues[1];
   clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 0.0f } };
@@ -1236,6 +1570,7 @@ void VulkanApp::generateIrradianceCube()
   };
 
   cmd_buffer = dev::StaticHelpers::beginSingleTimeCommands(context_);
+  resources_->gpuProfiler.beginImmediate(cmd_buffer, "irradiance cube");
   VkViewport viewport{};
   viewport.width = (float)dim;
   viewport.height = (float)dim;
@@ -1281,10 +1616,10 @@ void VulkanApp::generateIrradianceCube()
       VkBuffer vertexBuffers[] = { intResources->vertexBuffer.buffer_ };
       vkCmdBindVertexBuffers(cmd_buffer, 0, 1, vertexBuffers, offsets);
       vkCmdBindIndexBuffer(cmd_buffer, intResources->indicesBuffer.buffer_, 0, VK_INDEX_TYPE_UINT32);
-      InternalVertexData vertex_data = intResources->vertex_data[(int)PrimitiveType::kPrimitiveType_Cube];
+      const InternalVertexData& vertex_data = intResources->vertex_data[(int)PrimitiveType::kPrimitiveType_Cube];
       uint32 first_vertex = vertex_data.offset;
       uint32 first_index = vertex_data.index_offset;
-      vkCmdDrawIndexed(cmd_buffer, static_cast<uint32>(vertex_data.indices.size()), 1, first_index, first_vertex, 0);
+      vkCmdDrawIndexed(cmd_buffer, vertex_data.lods[0].indexCount, 1, first_index, first_vertex, 0);
       //models.skybox.draw(cmdBuf);
 
       vkCmdEndRenderPass(cmd_buffer);
@@ -1334,7 +1669,9 @@ void VulkanApp::generateIrradianceCube()
   subresourceRange.layerCount = 6;
   resources_->irradianceCube.setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
 
+  resources_->gpuProfiler.endScope(cmd_buffer);
   dev::StaticHelpers::endSingleTimeCommands(context_, cmd_buffer);
+  resources_->gpuProfiler.collectImmediate();
 
   VkDevice device = context_->logDevice_;
   vkDestroyRenderPass(device, renderpass, nullptr);
@@ -1350,7 +1687,7 @@ void VulkanApp::generateIrradianceCube()
 void VulkanApp::generatePrefilteredCube()
 {
   const VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
-  const int32_t dim = 512;
+  const int32_t dim = kPrefilteredCubeSize;
   const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
 
   vkdev::VkTexture* prefilteredCube = &resources_->prefilteredCube;
@@ -1489,9 +1826,7 @@ void VulkanApp::generatePrefilteredCube()
   // Pipeline layout
   struct PushBlock {
     glm::mat4 mvp;
-    // Sampling deltas
     float roughness;
-    uint32 samples_number = 32u;
   } pushBlock;
 
   VkPipelineLayout pipelinelayout;
@@ -1572,11 +1907,10 @@ void VulkanApp::generatePrefilteredCube()
 
   pipelineCI.pVertexInputState = &vertexInputInfo;
 
-  auto vertex_shader = dev::StaticHelpers::loadShader("./../../src/shaders/spir-v/filtercube_vert.spv");
-  auto fragment_shader = dev::StaticHelpers::loadShader("./../../src/shaders/spir-v/prefilterenvmap_frag.spv");
-
-  VkShaderModule vert_module = dev::StaticHelpers::createShaderModule(context_->logDevice_, vertex_shader);
-  VkShaderModule frag_module = dev::StaticHelpers::createShaderModule(context_->logDevice_, fragment_shader);
+  VkShaderModule vert_module = context_->shaderCache.getModule(context_->logDevice_, "./../../src/shaders/spir-v/filtercube_vert.spv");
+  VkShaderModule frag_module = context_->shaderCache.getModule(context_->logDevice_, "./../../src/shaders/spir-v/prefilterenvmap_frag.spv");
+  VkSpecializationMapEntry spec_entry;
+  VkSpecializationInfo spec_info = dev::StaticHelpers::specializationInfo(&kPrefilteredSamples, 1, &spec_entry);
 
   shaderStages[0] = {};
   shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -1589,13 +1923,11 @@ void VulkanApp::generatePrefilteredCube()
   shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   shaderStages[1].module = frag_module;
   shaderStages[1].pName = "main";
+  shaderStages[1].pSpecializationInfo = &spec_info;
 
   VkPipeline pipeline;
   vkCreateGraphicsPipelines(context_->logDevice_, resources_->pipelineCache, 1, &pipelineCI, nullptr, &pipeline);
 
-  vkDestroyShaderModule(context_->logDevice_, vert_module, nullptr);
-  vkDestroyShaderModule(context_->logDevice_, frag_module, nullptr);
-
   VkClearValue clearValues[1];
   clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 0.0f } };
 
@@ -1623,6 +1955,7 @@ void VulkanApp::generatePrefilteredCube()
   };
 
   VkCommandBuffer cmd_buffer = dev::StaticHelpers::beginSingleTimeCommands(context_);
+  resources_->gpuProfiler.beginImmediate(cmd_buffer, "prefiltered cube");
   VkViewport viewport{};
   viewport.width = (float)dim;
   viewport.height = (float)dim;
@@ -1669,10 +2002,10 @@ void VulkanApp::generatePrefilteredCube()
       VkBuffer vertexBuffers[] = { intResources->vertexBuffer.buffer_ };
       vkCmdBindVertexBuffers(cmd_buffer, 0, 1, vertexBuffers, offsets);
       vkCmdBindIndexBuffer(cmd_buffer, intResources->indicesBuffer.buffer_, 0, VK_INDEX_TYPE_UINT32);
-      InternalVertexData vertex_data = intResources->vertex_data[(uint32)PrimitiveType::kPrimitiveType_Cube];
+      const InternalVertexData& vertex_data = intResources->vertex_data[(uint32)PrimitiveType::kPrimitiveType_Cube];
       uint32 first_vertex = vertex_data.offset;
       uint32 first_index = vertex_data.index_offset;
-      vkCmdDrawIndexed(cmd_buffer, static_cast<uint32>(vertex_data.indices.size()), 1, first_index, first_vertex, 0);
+      vkCmdDrawIndexed(cmd_buffer, vertex_data.lods[0].indexCount, 1, first_index, first_vertex, 0);
 
       vkCmdEndRenderPass(cmd_buffer);
 
@@ -1728,7 +2061,9 @@ void VulkanApp::generatePrefilteredCube()
                                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
                                              subresourceRange);
 
+  resources_->gpuProfiler.endScope(cmd_buffer);
   dev::StaticHelpers::endSingleTimeCommands(context_, cmd_buffer);
+  resources_->gpuProfiler.collectImmediate();
 
   VkDevice device = context_->logDevice_;
   vkDestroyRenderPass(device, renderpass, nullptr);
@@ -1740,17 +2075,10 @@ void VulkanApp::generatePrefilteredCube()
   vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
 }
 
-uint32 VulkanApp::generateIBLTextures()
+bool VulkanApp::hasSkyboxTexture()
 {
   InternalMaterial* mat = &resources_->internalMaterials[(uint32)MaterialType::kMaterialType_Skybox];
-  if (mat->texturesReferenced.empty()) {
-    return 1;
-  }
-
-  generateBRDFLUT();
-  generateIrradianceCube();
-  generatePrefilteredCube();
-  return 0;
+  return !mat->texturesReferenced.empty();
 }
 
 void VulkanApp::generateNoiseTexture(uint32 width, uint32 height)
@@ -1762,18 +2090,37 @@ void VulkanApp::generateNoiseTexture(uint32 width, uint32 height)
   noisetext->mipLevels_ = 1;
   noisetext->device_ = context_->logDevice_;
 
-  noisetext->createImage(context_->physDevice_, VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 1, 0);
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  if (context_->caps.gpuNoise) usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+  noisetext->createImage(context_->physDevice_, VK_FORMAT_R8_UNORM, usage, 1, 0);
   noisetext->view_ = dev::StaticHelpers::createTextureImageView(context_->logDevice_, noisetext->image_, VK_FORMAT_R8_UNORM, VK_IMAGE_VIEW_TYPE_2D, 1, 1, VK_IMAGE_ASPECT_COLOR_BIT);
-  noisetext->sampler_ = dev::StaticHelpers::createTextureSampler(context_, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_COMPARE_OP_NEVER, 0, VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE, VK_FALSE);
+  noisetext->sampler_ = dev::StaticHelpers::createTextureSampler(context_, VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_COMPARE_OP_NEVER, 0, VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE, VK_FALSE);
 
   noisetext->descriptor_.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
   noisetext->descriptor_.imageView = noisetext->view_;
   noisetext->descriptor_.sampler = noisetext->sampler_;
 
-  updateNoiseTexture(noisetext);
+  if (context_->caps.gpuNoise) {
+    PerlinNoise perlin_noise(kNoiseSeed);
+    resources_->noiseGenerator.create(context_, noisetext, perlin_noise.getPermutations(),
+                                      static_cast<float>(kNoiseScale), kNoiseScale);
 
-  resources_->grassTerrainTexture.loadImage(context_, "./../../data/textures/grass.jpg", VK_FORMAT_R8G8B8A8_SRGB);
-  resources_->rockTerrainTexture.loadImage(context_, "./../../data/textures/mountain_rock.jpg", VK_FORMAT_R8G8B8A8_SRGB);
+    VkCommandBuffer cmd_buffer = dev::StaticHelpers::beginSingleTimeCommands(context_);
+    resources_->gpuProfiler.beginImmediate(cmd_buffer, "noise");
+    resources_->noiseGenerator.generate(cmd_buffer, 0.0f);
+    resources_->gpuProfiler.endScope(cmd_buffer);
+    dev::StaticHelpers::endSingleTimeCommands(context_, cmd_buffer);
+    resources_->gpuProfiler.collectImmediate();
+  }
+  else {
+    updateNoiseTexture(noisetext);
+  }
+}
+
+void VulkanApp::loadTerrainTextures(vkdev::DecodedImage* decoded)
+{
+  resources_->grassTerrainTexture.loadImage(context_, kGrassTexturePath, VK_FORMAT_R8G8B8A8_SRGB, &decoded[0]);
+  resources_->rockTerrainTexture.loadImage(context_, kRockTexturePath, VK_FORMAT_R8G8B8A8_SRGB, &decoded[1]);
 }
 
 void VulkanApp::updateNoiseTexture(vkdev::VkTexture* texture)
@@ -1785,20 +2132,15 @@ void VulkanApp::updateNoiseTexture(vkdev::VkTexture* texture)
   uint8* data = new uint8[mem_size];
   memset(data, 0, mem_size);
 
-  PerlinNoise perlin_noise;
+  PerlinNoise perlin_noise(kNoiseSeed);
   FractalNoise fractal(perlin_noise);
-  const float scale = static_cast<float>(rand() % 10) + 4.0f;
-
-  for (size_t i = 0; i < h; i++) {
-    for (size_t j = 0; j < w; j++) {
-      float nw = j / (float)w;
-      float nh = i / (float)h;
 
-      //float n = 20.0f * perlin_noise.noise(nw, nh, 0);
-      float n = fractal.noise(nw * scale, nh * scale, 0);
-      n = n - floor(n);
-      data[i * w + j] = static_cast<uint8>(floor(n * 255));
-    }
+  //Periodic over the texture, it wraps without a seam
+  std::vector<float> values(mem_size);
+  fractal.noiseImage(w, h, static_cast<float>(kNoiseScale), kNoiseScale, values.data());
+  for (uint32 i = 0; i < mem_size; i++) {
+    float n = values[i] - floor(values[i]);
+    data[i] = static_cast<uint8>(floor(n * 255));
   }
 
   vkdev::Buffer image_buffer;
@@ -1812,6 +2154,7 @@ void VulkanApp::updateNoiseTexture(vkdev::VkTexture* texture)
 
   VkCommandBuffer cmd_buffer;
   cmd_buffer = dev::StaticHelpers::beginSingleTimeCommands(context_);
+  resources_->gpuProfiler.beginImmediate(cmd_buffer, "noise upload");
 
   VkImageSubresourceRange subresource_range{};
   subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -1835,7 +2178,9 @@ void VulkanApp::updateNoiseTexture(vkdev::VkTexture* texture)
   texture->layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
   texture->setImageLayout(cmd_buffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture->layout_, subresource_range);
 
+  resources_->gpuProfiler.endScope(cmd_buffer);
   dev::StaticHelpers::endSingleTimeCommands(context_, cmd_buffer);
+  resources_->gpuProfiler.collectImmediate();
   delete[] data;
   image_buffer.destroyBuffer();
 }
@@ -1844,7 +2189,7 @@ void VulkanApp::createDescriptorSetLayout()
 {
   Resources* res = ResourceManager::Get()->getResources();
 
-  std::vector<VkDescriptorSetLayoutBinding> layoutBinding(2);
+  std::vector<VkDescriptorSetLayoutBinding> layoutBinding(5);
   layoutBinding[0].binding = 0;
   layoutBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
   layoutBinding[0].descriptorCount = 1;
@@ -1852,11 +2197,17 @@ void VulkanApp::createDescriptorSetLayout()
   layoutBinding[0].pImmutableSamplers = nullptr;
 
   layoutBinding[1].binding = 1;
-  layoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  layoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
   layoutBinding[1].descriptorCount = 1;
   layoutBinding[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
   layoutBinding[1].pImmutableSamplers = nullptr;
 
+  //Clustered lights: light list, per cluster offset/count and light indices
+  for (uint32 i = 0; i < 3; i++) {
+    layoutBinding[2 + i] = dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                                                        VK_SHADER_STAGE_FRAGMENT_BIT, 5 + i);
+  }
+
 
   VkDescriptorSetLayoutCreateInfo layoutInfo{};
   layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1876,7 +2227,7 @@ void VulkanApp::createDescriptorSetLayout()
   layoutBinding[0].pImmutableSamplers = nullptr;
 
   layoutBinding[1].binding = 1;
-  layoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  layoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
   layoutBinding[1].descriptorCount = 1;
   layoutBinding[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
   layoutBinding[1].pImmutableSamplers = nullptr;
@@ -1901,7 +2252,7 @@ void VulkanApp::createDescriptorSetLayout()
 
 
   layoutBinding.clear();
-  layoutBinding.resize(5);
+  layoutBinding.resize(8);
   layoutBinding[0].binding = 0;
   layoutBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
   layoutBinding[0].descriptorCount = 1;
@@ -1909,7 +2260,7 @@ void VulkanApp::createDescriptorSetLayout()
   layoutBinding[0].pImmutableSamplers = nullptr;
 
   layoutBinding[1].binding = 1;
-  layoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  layoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
   layoutBinding[1].descriptorCount = 1;
   layoutBinding[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
   layoutBinding[1].pImmutableSamplers = nullptr;
@@ -1932,6 +2283,11 @@ void VulkanApp::createDescriptorSetLayout()
   layoutBinding[4].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
   layoutBinding[4].pImmutableSamplers = nullptr;
 
+  for (uint32 i = 0; i < 3; i++) {
+    layoutBinding[5 + i] = dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                                                        VK_SHADER_STAGE_FRAGMENT_BIT, 5 + i);
+  }
+
   layoutInfo.bindingCount = static_cast<uint32>(layoutBinding.size());
   layoutInfo.pBindings = layoutBinding.data();
 
@@ -1941,9 +2297,147 @@ void VulkanApp::createDescriptorSetLayout()
   layoutBinding[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
   layoutBinding[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
   layoutBinding[2].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  layoutBinding.resize(5);
+  //Streamed heightmap tiles and the page table of the window around the camera
+  layoutBinding.push_back(dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                                       VK_SHADER_STAGE_VERTEX_BIT, 5));
+  layoutBinding.push_back(dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                                                       VK_SHADER_STAGE_VERTEX_BIT, 6));
+  layoutInfo.bindingCount = static_cast<uint32>(layoutBinding.size());
+  layoutInfo.pBindings = layoutBinding.data();
 
   assert(vkCreateDescriptorSetLayout(context_->logDevice_, &layoutInfo, nullptr,
     &res->layouts[kLayoutType_Noise].descriptor) == VK_SUCCESS);
+
+  if (!context_->caps.descriptorIndexing) return;
+
+  //Bindless: set 0 only keeps the uniform buffers, textures go to the global set 1
+  layoutBinding.clear();
+  layoutBinding.resize(2);
+  layoutBinding[0] = dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                                                  VK_SHADER_STAGE_VERTEX_BIT, 0);
+  layoutBinding[1] = dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                                                  VK_SHADER_STAGE_VERTEX_BIT, 1);
+
+  layoutInfo.bindingCount = static_cast<uint32>(layoutBinding.size());
+  layoutInfo.pBindings = layoutBinding.data();
+
+  assert(vkCreateDescriptorSetLayout(context_->logDevice_, &layoutInfo, nullptr,
+    &res->layouts[kLayoutType_Texture_Bindless].descriptor) == VK_SUCCESS);
+
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT };
+  VkPhysicalDeviceProperties2 properties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+  properties.pNext = &indexingProperties;
+  vkGetPhysicalDeviceProperties2(context_->physDevice_, &properties);
+  res->bindless.capacity = std::min(kMaxBindlessTextures, 
+                                    indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages);
+
+  VkDescriptorSetLayoutBinding texture_array = dev::StaticHelpers::layoutBindingInitializer(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                                                            VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                                                                                            res->bindless.capacity);
+  VkDescriptorBindingFlagsEXT binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                              VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                                              VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT;
+  if (context_->caps.textureStreaming) {
+    binding_flags |= VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+  }
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT };
+  binding_flags_info.bindingCount = 1;
+  binding_flags_info.pBindingFlags = &binding_flags;
+
+  VkDescriptorSetLayoutCreateInfo bindlessInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+  bindlessInfo.pNext = &binding_flags_info;
+  bindlessInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+  bindlessInfo.bindingCount = 1;
+  bindlessInfo.pBindings = &texture_array;
+
+  assert(vkCreateDescriptorSetLayout(context_->logDevice_, &bindlessInfo, nullptr,
+    &res->bindless.layout) == VK_SUCCESS);
+}
+
+/*********************************************************************************************/
+
+void VulkanApp::createBindlessTextureSet()
+{
+  if (!context_->caps.descriptorIndexing) return;
+
+  BindlessTextureSet* bindless = &resources_->bindless;
+  VkDescriptorPoolSize pool_size = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, bindless->capacity };
+
+  VkDescriptorPoolCreateInfo poolInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &pool_size;
+  poolInfo.maxSets = 1;
+
+  assert(vkCreateDescriptorPool(context_->logDevice_, &poolInfo, nullptr, &bindless->pool) == VK_SUCCESS);
+
+  VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableCount{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT };
+  variableCount.descriptorSetCount = 1;
+  variableCount.pDescriptorCounts = &bindless->capacity;
+
+  VkDescriptorSetAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+  allocInfo.pNext = &variableCount;
+  allocInfo.descriptorPool = bindless->pool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &bindless->layout;
+
+  if (vkAllocateDescriptorSets(context_->logDevice_, &allocInfo, &bindless->set) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate bindless descriptor set");
+  }
+
+  //Texture id is the array element, cubemaps are left unbound (partially bound binding)
+  std::vector<VkWriteDescriptorSet> descriptor_write;
+  for (size_t i = 0; i < resources_->itextures.size() && i < bindless->capacity; i++) {
+    if (Scene::userTextures[i]->getType() != TextureType::kTextureType_2D) continue;
+
+    VkWriteDescriptorSet write = dev::StaticHelpers::descriptorWriteInitializer(0,
+                                            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                                       bindless->set,
+                                                &resources_->itextures[i].descriptor_);
+    write.dstArrayElement = static_cast<uint32>(i);
+    descriptor_write.push_back(write);
+  }
+
+  vkUpdateDescriptorSets(context_->logDevice_, static_cast<uint32>(descriptor_write.size()), 
+                         descriptor_write.data(), 0, nullptr);
+
+  if (context_->caps.textureStreaming) {
+    resources_->textureStreamer.setBindlessSet(bindless->set, bindless->capacity);
+  }
+}
+
+/*********************************************************************************************/
+
+void VulkanApp::createGPUCulling()
+{
+  if (!context_->caps.gpuCulling) return;
+
+  resources_->gpuCulling.create(context_, &resources_->depthAttachment,
+                                static_cast<uint32>(context_->swapchainImageViews.size()));
+}
+
+/*********************************************************************************************/
+
+void VulkanApp::createGPUProfiler()
+{
+  resources_->gpuProfiler.create(context_, static_cast<uint32>(context_->swapchainImageViews.size()));
+}
+
+/*********************************************************************************************/
+
+void VulkanApp::createHeightmapStreamer()
+{
+  //Written once, later runs stream the file that is already there
+  if (enableHeightmapGenerator && !std::ifstream(kHeightmapPath) &&
+      !vkdev::HeightmapStreamer::writeNoiseTiles(kHeightmapPath, kHeightmapNoiseSize, kHeightmapTileCells)) {
+    printf("\nCould not write %s, the terrain reads the noise texture\n", kHeightmapPath);
+  }
+  resources_->heightmap.create(context_, kHeightmapPath, static_cast<uint32>(context_->swapchainImageViews.size()));
+  //The quadtree root has to cover every tile of the file
+  if (resources_->heightmap.isStreaming()) {
+    resources_->terrain.setSize(resources_->heightmap.getTerrainSize());
+  }
 }
 
 /*********************************************************************************************/
@@ -1956,19 +2450,37 @@ void VulkanApp::createDescriptorPool()
     InternalMaterial* mat = &resources_->internalMaterials[i];
     std::vector<VkDescriptorPoolSize> poolSizes;
     switch (mat->layout) {
+      case kLayoutType_Texture_Bindless: {
+        poolSizes.resize(2);
+        poolSizes[0] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER , descriptor_size };
+        poolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER , descriptor_size };
+        break;
+      }
       case kLayoutType_Simple_2Binds: {
         poolSizes.resize(2);
         poolSizes[0] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER , descriptor_size };
-        poolSizes[1] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC , descriptor_size };
+        poolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER , 4 * descriptor_size };
+        break;
+      }
+      case kLayoutType_PBRIBL: {
+        poolSizes.resize(3);
+        poolSizes[0] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER , descriptor_size };
+        poolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER , 4 * descriptor_size };
+        poolSizes[2] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER , 3 * descriptor_size };
+        break;
+      }
+      case kLayoutType_Noise: {
+        poolSizes.resize(3);
+        poolSizes[0] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER , descriptor_size };
+        poolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER , 2 * descriptor_size };
+        poolSizes[2] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER , 4 * descriptor_size };
         break;
       }
-      case kLayoutType_PBRIBL:
-      case kLayoutType_Noise:
       case kLayoutType_Texture_3Binds:
       case kLayoutType_Texture_Cubemap: {
         poolSizes.resize(3);
         poolSizes[0] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER , descriptor_size };
-        poolSizes[1] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC , descriptor_size };
+        poolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER , descriptor_size };
         poolSizes[2] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER , descriptor_size };
         break;
       }
@@ -2016,13 +2528,37 @@ std::vector<VkWriteDescriptorSet> getSimpleLayoutBinding(VkDescriptorSet descset
                                                          &bufferdesc[0]);
 
   descriptor_write[1] = dev::StaticHelpers::descriptorWriteInitializer(1,
-                               VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                               VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                                                                  descset,
                                                          &bufferdesc[1]);
 
   return descriptor_write;
 }
 
+//bufferdesc[2..4]: light list, clusters and light indices
+void appendLightingBinding(std::vector<VkWriteDescriptorSet>* descriptor_write,
+                                                   VkDescriptorSet descset,
+                                          VkDescriptorBufferInfo* bufferdesc) {
+
+  for (uint32 i = 0; i < 3; i++) {
+    descriptor_write->push_back(dev::StaticHelpers::descriptorWriteInitializer(5 + i,
+                                                     VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                                                               descset,
+                                                                   &bufferdesc[2 + i]));
+  }
+}
+
+std::vector<VkWriteDescriptorSet> getLightingLayoutBinding(VkDescriptorSet descset, 
+                                                VkDescriptorBufferInfo* bufferdesc,
+                                    std::vector<VkDescriptorImageInfo>* image_info = nullptr,
+                                                              Resources* resources = nullptr) {
+
+  std::vector<VkWriteDescriptorSet> descriptor_write = getSimpleLayoutBinding(descset, bufferdesc);
+  appendLightingBinding(&descriptor_write, descset, bufferdesc);
+
+  return descriptor_write;
+}
+
 std::vector<VkWriteDescriptorSet> getTextureLayoutBinding(VkDescriptorSet descset, 
                                                VkDescriptorBufferInfo* bufferdesc,
                                    std::vector<VkDescriptorImageInfo>* image_info,
@@ -2036,7 +2572,7 @@ std::vector<VkWriteDescriptorSet> getTextureLayoutBinding(VkDescriptorSet descse
                                                          &bufferdesc[0]);
 
   descriptor_write[1] = dev::StaticHelpers::descriptorWriteInitializer(1,
-                               VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                               VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                                                                  descset,
                                                          &bufferdesc[1]);
 
@@ -2062,7 +2598,7 @@ std::vector<VkWriteDescriptorSet> getIBLLayoutBinding(VkDescriptorSet descset,
                                                          &bufferdesc[0]);
 
   descriptor_write[1] = dev::StaticHelpers::descriptorWriteInitializer(1,
-                               VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                               VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                                                                  descset,
                                                          &bufferdesc[1]);
 
@@ -2081,6 +2617,8 @@ std::vector<VkWriteDescriptorSet> getIBLLayoutBinding(VkDescriptorSet descset,
                                                                  descset,
                                 &resources->prefilteredCube.descriptor_);
 
+  appendLightingBinding(&descriptor_write, descset, bufferdesc);
+
   return descriptor_write;
 }
 
@@ -2097,7 +2635,7 @@ std::vector<VkWriteDescriptorSet> getNoiseLayoutBinding(VkDescriptorSet descset,
                                                          &bufferdesc[0]);
 
   descriptor_write[1] = dev::StaticHelpers::descriptorWriteInitializer(1,
-                               VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                               VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                                                                  descset,
                                                          &bufferdesc[1]);
 
@@ -2116,6 +2654,17 @@ std::vector<VkWriteDescriptorSet> getNoiseLayoutBinding(VkDescriptorSet descset,
                                                                  descset,
                             &resources->grassTerrainTexture.descriptor_);
 
+  //bufferdesc[5]: heightmap page table
+  descriptor_write.push_back(dev::StaticHelpers::descriptorWriteInitializer(5,
+                               VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                                 descset,
+                            resources->heightmap.getTilesDescriptor()));
+
+  descriptor_write.push_back(dev::StaticHelpers::descriptorWriteInitializer(6,
+                               VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                                                 descset,
+                                                         &bufferdesc[5]));
+
   return descriptor_write;
 }
 
@@ -2128,11 +2677,12 @@ void VulkanApp::createDescriptorSets()
                                     std::vector<VkDescriptorImageInfo>*image_info,
                                                             Resources * resources);
 
-  f[kLayoutType_Simple_2Binds] = &getSimpleLayoutBinding;
+  f[kLayoutType_Simple_2Binds] = &getLightingLayoutBinding;
   f[kLayoutType_Texture_3Binds] = &getTextureLayoutBinding;
   f[kLayoutType_Texture_Cubemap] = &getTextureLayoutBinding;
   f[kLayoutType_PBRIBL] = &getIBLLayoutBinding;
   f[kLayoutType_Noise] = &getNoiseLayoutBinding;
+  f[kLayoutType_Texture_Bindless] = &getSimpleLayoutBinding;
 
   for (size_t j = 0; j < (int32)MaterialType::kMaterialType_MAX; j++) {
     InternalMaterial* mat = &resources->internalMaterials[j];
@@ -2168,11 +2718,29 @@ void VulkanApp::createDescriptorSets()
         bufferSceneInfo.range = sizeof(SceneUniformBuffer);
         VkDescriptorBufferInfo bufferObjectInfo{};
         bufferObjectInfo.offset = 0;
-        bufferObjectInfo.range = sizeof(UniformBlocks);
-        VkDescriptorBufferInfo buffer_descriptor[] = { bufferSceneInfo, bufferObjectInfo };
+        bufferObjectInfo.range = VK_WHOLE_SIZE;
+        VkDescriptorBufferInfo bufferLightInfo{};
+        bufferLightInfo.offset = 0;
+        bufferLightInfo.range = VK_WHOLE_SIZE;
+        VkDescriptorBufferInfo bufferClusterInfo{};
+        bufferClusterInfo.offset = 0;
+        bufferClusterInfo.range = sizeof(glm::uvec2) * kClusterCount;
+        VkDescriptorBufferInfo bufferIndexInfo{};
+        bufferIndexInfo.offset = 0;
+        bufferIndexInfo.range = sizeof(uint32) * kMaxClusterLightIndices;
+        VkDescriptorBufferInfo bufferPageInfo{};
+        bufferPageInfo.offset = 0;
+        bufferPageInfo.range = VK_WHOLE_SIZE;
+        VkDescriptorBufferInfo buffer_descriptor[] = { bufferSceneInfo, bufferObjectInfo, 
+                                                       bufferLightInfo, bufferClusterInfo, bufferIndexInfo,
+                                                       bufferPageInfo };
       for (size_t i = 0; i < context_->swapchainImageViews.size(); i++) {
         buffer_descriptor[0].buffer = resources->staticUniform[i].buffer_;
         buffer_descriptor[1].buffer = mat->dynamicUniform[i].buffer_;
+        buffer_descriptor[2].buffer = resources->lightStorage[i].buffer_;
+        buffer_descriptor[3].buffer = resources->clusterStorage[i].buffer_;
+        buffer_descriptor[4].buffer = resources->lightIndexStorage[i].buffer_;
+        buffer_descriptor[5].buffer = resources->heightmap.getPageTable(i);
 
         std::vector<VkWriteDescriptorSet> descriptor_write = f[mat->layout](mat->matDescriptorSet[i],
                                                                                    buffer_descriptor,
@@ -2189,7 +2757,7 @@ void VulkanApp::createDescriptorSets()
 
 void VulkanApp::createUniformBuffers()
 {
-  uint64_t dynamicAlignment = dev::StaticHelpers::padUniformBufferOffset(context_, sizeof(UniformBlocks));
+  uint64_t dynamicAlignment = sizeof(UniformBlocks);
 
   Resources* resources = ResourceManager::Get()->getResources();
   uint32 swapChainImageCount = context_->swapchainImageViews.size();
@@ -2200,7 +2768,7 @@ void VulkanApp::createUniformBuffers()
     VkDeviceSize dynamicBufferSize = dynamicAlignment * mat->entitiesReferenced;
       mat->dynamicUniformData = (UniformBlocks*)_aligned_malloc(dynamicBufferSize, dynamicAlignment);
       for (size_t i = 0; i < swapChainImageCount; i++) {
-        mat->dynamicUniform[i].createBuffer(context_, dynamicBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        mat->dynamicUniform[i].createBuffer(context_, dynamicBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
         vkMapMemory(context_->logDevice_, mat->dynamicUniform[i].memory_, 0, dynamicBufferSize, 0, &mat->dynamicUniform[i].mapped_);
       }
@@ -2215,12 +2783,74 @@ void VulkanApp::createUniformBuffers()
     vkMapMemory(context_->logDevice_, resources->staticUniform[i].memory_, 0, 
                 sizeof(SceneUniformBuffer), 0, &resources->staticUniform[i].mapped_);
   }
+
+  //Clustered lighting storage, written every frame from updateUniformBuffers
+  resources->sceneLights.reserve(kMinLightCapacity);
+  resources->lightClusters.setGrid(context_->swapchainDimensions.width, context_->swapchainDimensions.height,
+                                   Scene::camera.getNearPlane(), Scene::camera.getFarPlane());
+
+  VkDeviceSize light_size = sizeof(LightParams) * kMinLightCapacity;
+  VkDeviceSize cluster_size = sizeof(glm::uvec2) * kClusterCount;
+  VkDeviceSize index_size = sizeof(uint32) * kMaxClusterLightIndices;
+  VkMemoryPropertyFlags storage_props = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  resources->lightStorage.resize(swapChainImageCount);
+  resources->lightCapacity.resize(swapChainImageCount, kMinLightCapacity);
+  resources->clusterStorage.resize(swapChainImageCount);
+  resources->lightIndexStorage.resize(swapChainImageCount);
+  for (size_t i = 0; i < swapChainImageCount; i++) {
+    resources->lightStorage[i].createBuffer(context_, light_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, storage_props);
+    vkMapMemory(context_->logDevice_, resources->lightStorage[i].memory_, 0,
+                light_size, 0, &resources->lightStorage[i].mapped_);
+
+    resources->clusterStorage[i].createBuffer(context_, cluster_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, storage_props);
+    vkMapMemory(context_->logDevice_, resources->clusterStorage[i].memory_, 0,
+                cluster_size, 0, &resources->clusterStorage[i].mapped_);
+
+    resources->lightIndexStorage[i].createBuffer(context_, index_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, storage_props);
+    vkMapMemory(context_->logDevice_, resources->lightIndexStorage[i].memory_, 0,
+                index_size, 0, &resources->lightIndexStorage[i].mapped_);
+  }
 }
 
 /*********************************************************************************************/
 
+//Level of detail from the screen height fraction covered by the world bounds,
+//the current level is kept while the size stays inside the hysteresis band
+static uint8 selectLod(const InternalVertexData* vertex_data, const glm::vec4& world_sphere,
+                       const SceneUniformBuffer& scene, uint8 current)
+{
+  uint32 levels = static_cast<uint32>(vertex_data->lods.size());
+  if (levels < 2) return 0;
+
+  float distance = glm::length(glm::vec3(world_sphere) - scene.cameraPosition);
+  float size = distance > world_sphere.w ? world_sphere.w * scene.projection[1][1] / distance : FLT_MAX;
+
+  uint32 lod = std::min((uint32)current, levels - 1);
+  while (lod + 1 < levels && size < kLodScreenSize[lod] * (1.0f - kLodHysteresis)) ++lod;
+  while (lod > 0 && size > kLodScreenSize[lod - 1] * (1.0f + kLodHysteresis)) --lod;
+
+  return static_cast<uint8>(lod);
+}
+
+//Screen size feedback for the streamed levels of the texture sampled by the entity.
+//Visibility is not known yet on the GPU culling path, objects out of the frustum count too
+static void requestTextureLevels(Resources* res, Entity* entity, const UpdateData& update_data,
+                                 const glm::vec4& world_sphere, uint32 screen_height)
+{
+  InternalMaterial* mat = &res->internalMaterials[update_data.drawCall.materialType];
+  uint32 index = entity->getMaterial()->getMaterialSettings().textureBlock.textureIndex;
+  if (mat->layout != kLayoutType_Texture_Bindless || index >= mat->texturesReferenced.size()) return;
+
+  uint32 texture = mat->texturesReferenced[index];
+  const SceneUniformBuffer& scene = update_data.sceneBuffer;
+  float distance = glm::length(glm::vec3(world_sphere) - scene.cameraPosition);
+  float size = distance > world_sphere.w ? world_sphere.w * scene.projection[1][1] / distance : FLT_MAX;
+  res->textureStreamer.requestSize(texture, size * static_cast<float>(screen_height));
+}
+
 void VulkanApp::updateUniformBuffers(uint32 index)
 {
+  PROFILE_FUNCTION();
   Resources* resources = ResourceManager::Get()->getResources();
 
   UpdateData update_data{};
@@ -2229,15 +2859,199 @@ void VulkanApp::updateUniformBuffers(uint32 index)
   update_data.sceneBuffer.cameraPosition = { Scene::camera.getPosition() };
   update_data.sceneBuffer.lightNumber = 0;
   Resources* res = ResourceManager::Get()->getResources();
-  uint64_t padding = dev::StaticHelpers::padUniformBufferOffset(context_, sizeof(UniformBlocks));
+  res->sceneLights.clear();
+  update_data.lights = &res->sceneLights;
+  uint64_t padding = sizeof(UniformBlocks);
+  vkdev::FrustumCulling* culling = &res->culling;
+  culling->clear();
+  res->drawCandidates.clear();
+  res->occluders.clear();
+  res->terrain.clear();
+
+  glm::vec4 frustum_planes[6];
+  Scene::camera.getFrustumPlanes(frustum_planes);
+
+  //On the GPU path the bounds go to the cull pass instead, no draw calls are queued
+  bool gpu_culling = context_->caps.gpuCulling;
+  GPUObject* gpu_objects = gpu_culling ? res->gpuCulling.getObjects(index) : nullptr;
+  uint32 object_count = 0;
+  if (gpu_culling) res->cullingStats = res->gpuCulling.getStats(index);
+
   for (size_t i = 0; i < Scene::entitiesCount; i++) {
     Entity* entity = Scene::sceneEntities[i].get();
     update_data.drawCall.geometry = -1;
     entity->updateEntity(&update_data, padding);
-    if (update_data.drawCall.geometry > -1) res->draw_calls.push(update_data.drawCall);
+    if (update_data.drawCall.geometry < 0) continue;
+
+    //The terrain is drawn by patches selected and culled in its quadtree
+    if (update_data.drawCall.geometry == (int32)PrimitiveType::kPrimitiveType_Terrain &&
+        update_data.drawCall.materialType == (int32)MaterialType::kMaterialType_Noise) {
+      res->terrain.select(update_data.model, update_data.sceneBuffer.cameraPosition, frustum_planes,
+                          entity->getMaterial()->getMaterialSettings().noiseBlock.amplification,
+                          update_data.drawCall.offset);
+      res->heightmap.update(glm::vec3(glm::inverse(update_data.model) *
+                                      glm::vec4(update_data.sceneBuffer.cameraPosition, 1.0f)));
+      continue;
+    }
+
+    InternalVertexData* vertex_data = &res->vertex_data[update_data.drawCall.geometry];
+    glm::vec4 sphere = vertex_data->sphere;
+    uint32 flags = 0;
+    switch ((MaterialType)update_data.drawCall.materialType) {
+      case MaterialType::kMaterialType_Skybox: {
+        sphere.w = FLT_MAX;
+        flags = kObjectFlag_AlwaysVisible;
+        break;
+      }
+      case MaterialType::kMaterialType_Noise: {
+        //Vertices are displaced in the vertex shader up to half the amplification
+        sphere.w += entity->getMaterial()->getMaterialSettings().noiseBlock.amplification * 0.5f;
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+    glm::vec4 world_sphere = vkdev::FrustumCulling::transformSphere(sphere, update_data.model);
+    update_data.drawCall.renderQueue = res->internalMaterials[update_data.drawCall.materialType].queue;
+    update_data.drawCall.viewDepth = -(update_data.sceneBuffer.view * glm::vec4(glm::vec3(world_sphere), 1.0f)).z;
+    res->entityLod[i] = selectLod(vertex_data, world_sphere, update_data.sceneBuffer, res->entityLod[i]);
+    requestTextureLevels(res, entity, update_data, world_sphere, res->dynamicResolution.getRenderExtent().height);
+    update_data.drawCall.lod = res->entityLod[i];
+    const LodLevel& level = vertex_data->lods[update_data.drawCall.lod];
+
+    //Indirect draws use the pipeline of the material, variants are culled and drawn one by one
+    if (gpu_culling && !update_data.drawCall.renderState) {
+      GPUObject* object = &gpu_objects[object_count++];
+      object->sphere = world_sphere;
+      object->materialType = update_data.drawCall.materialType;
+      object->firstInstance = update_data.drawCall.offset;
+      object->firstIndex = vertex_data->index_offset + level.firstIndex;
+      object->indexCount = level.indexCount;
+      object->vertexOffset = vertex_data->offset;
+      object->flags = flags;
+      continue;
+    }
+
+    //The noise material is displaced on the GPU, its vertices here are not the ones drawn
+    float size = glm::length(glm::vec3(world_sphere) - update_data.sceneBuffer.cameraPosition);
+    size = size > world_sphere.w ? world_sphere.w * update_data.sceneBuffer.projection[1][1] / size : FLT_MAX;
+    if (enableCPUOcclusion && !flags && !update_data.drawCall.renderState && size >= kOccluderScreenSize &&
+        update_data.drawCall.materialType != (int32)MaterialType::kMaterialType_Noise) {
+      res->occluders.push_back({ update_data.model, culling->getCount(), size });
+    }
+
+    culling->addSphere(sphere, update_data.model);
+    res->drawCandidates.push_back(update_data.drawCall);
   }
 
+  if (gpu_culling) {
+    //Front to back, the cull pass writes the draws of each material in this order
+    glm::mat4 view = update_data.sceneBuffer.view;
+    std::sort(gpu_objects, gpu_objects + object_count, [&view](const GPUObject& a, const GPUObject& b) {
+      return (view * glm::vec4(glm::vec3(a.sphere), 1.0f)).z > (view * glm::vec4(glm::vec3(b.sphere), 1.0f)).z;
+    });
+    res->gpuCulling.update(index, object_count, frustum_planes,
+                           update_data.sceneBuffer.projection * update_data.sceneBuffer.view,
+                           res->dynamicResolution.getPreviousScale());
+  }
+  else {
+    res->cullingStats = {};
+  }
+
+  culling->cull(frustum_planes);
+
+  //The largest occluders in the frustum are rasterized at the level they are drawn with,
+  //a coarser one could cover pixels the drawn mesh leaves open. The other candidates are tested against them
+  vkdev::OcclusionCulling* occlusion = &res->occlusion;
+  bool test_occlusion = false;
+  if (!res->occluders.empty()) {
+    std::sort(res->occluders.begin(), res->occluders.end(), [](const Occluder& a, const Occluder& b) {
+      return a.size > b.size;
+    });
+    occlusion->begin(update_data.sceneBuffer.view, update_data.sceneBuffer.projection,
+                     Scene::camera.getNearPlane());
+    uint32 occluder_count = 0;
+    for (uint32 i = 0; i < res->occluders.size() && occluder_count < kMaxOccluders; i++) {
+      const Occluder& occluder = res->occluders[i];
+      if (!culling->isVisible(occluder.candidate)) continue;
+      const DrawCallData& draw_call = res->drawCandidates[occluder.candidate];
+      InternalVertexData* vertex_data = &res->vertex_data[draw_call.geometry];
+      const LodLevel& level = vertex_data->lods[draw_call.lod];
+      occlusion->addOccluder(occluder.model, &vertex_data->vertex[0].vertex.x, sizeof(Vertex),
+                             &vertex_data->indices[level.firstIndex], level.indexCount);
+      ++occluder_count;
+    }
+    occlusion->end();
+    test_occlusion = occluder_count > 0;
+  }
+
+  for (uint32 i = 0; i < culling->getCount(); i++) {
+    if (!culling->isVisible(i)) {
+      ++res->cullingStats.culled;
+      continue;
+    }
+    if (test_occlusion && !occlusion->isVisible(culling->getSphere(i))) {
+      ++res->cullingStats.occluded;
+      continue;
+    }
+    res->draw_calls.push_back(res->drawCandidates[i]);
+    ++res->cullingStats.visible;
+  }
+  std::sort(res->draw_calls.begin(), res->draw_calls.end(), [](const DrawCallData& a, const DrawCallData& b) {
+    if (a.renderQueue != b.renderQueue) return a.renderQueue < b.renderQueue;
+    if (a.renderQueue == kRenderQueue_Transparent) return a.viewDepth > b.viewDepth;
+    return a.viewDepth < b.viewDepth;
+  });
+
+  //Variants are resolved here instead of while recording. One still being built by the
+  //pipeline cache is drawn with the material pipelines, both passes switch to it together
+  res->variantPipelines.clear();
+  for (DrawCallData& draw_call : res->draw_calls) {
+    draw_call.pipeline = VK_NULL_HANDLE;
+    draw_call.depthPipeline = VK_NULL_HANDLE;
+    if (!draw_call.renderState) continue;
+
+    uint32 v = 0;
+    while (v < res->variantPipelines.size() && (res->variantPipelines[v].materialType != draw_call.materialType ||
+                                                res->variantPipelines[v].renderState != draw_call.renderState)) v++;
+    if (v == res->variantPipelines.size()) {
+      //Only the opaque queue is in the depth pre-pass
+      bool depth_equal = enableDepthPrepass && draw_call.renderQueue == kRenderQueue_Opaque;
+      bool depth_pass = enableDepthPrepass && !(draw_call.renderState & kRenderState_NoDepth);
+      VariantPipelines variant = { draw_call.materialType, draw_call.renderState, VK_NULL_HANDLE, VK_NULL_HANDLE };
+      variant.pipeline = res->pipelineStates.findPipeline(draw_call.materialType, draw_call.renderState |
+                                                          (depth_equal ? kRenderState_DepthEqual : kRenderState_Default));
+      if (depth_pass) {
+        variant.depthPipeline = res->pipelineStates.findPipeline(draw_call.materialType,
+                                                                 draw_call.renderState | kRenderState_DepthOnly);
+      }
+      if (variant.pipeline == VK_NULL_HANDLE || (depth_pass && variant.depthPipeline == VK_NULL_HANDLE)) {
+        variant.pipeline = VK_NULL_HANDLE;
+        variant.depthPipeline = VK_NULL_HANDLE;
+      }
+      res->variantPipelines.push_back(variant);
+    }
+    draw_call.pipeline = res->variantPipelines[v].pipeline;
+    draw_call.depthPipeline = res->variantPipelines[v].depthPipeline;
+  }
+
+  //Only the lights touching a cluster are shaded by the fragment shaders
+  vkdev::LightClusters* clusters = &res->lightClusters;
+  uint32 light_count = update_data.sceneBuffer.lightNumber;
+  uint32 index_count = clusters->build(update_data.sceneBuffer.view, update_data.sceneBuffer.projection,
+                                       res->sceneLights.data(), light_count);
+  update_data.sceneBuffer.clusterGrid = clusters->getGrid();
+  update_data.sceneBuffer.clusterParams = clusters->getParams();
+  //Fragment coordinates are in the scaled region, the tiles in swapchain pixels
+  glm::vec2 render_scale = res->dynamicResolution.getScale();
+  update_data.sceneBuffer.clusterParams.z /= render_scale.x;
+  update_data.sceneBuffer.clusterParams.w /= render_scale.y;
+
   memcpy(resources->staticUniform[index].mapped_, &update_data.sceneBuffer, sizeof(SceneUniformBuffer));
+  updateLightStorage(index, light_count);
+  memcpy(resources->clusterStorage[index].mapped_, clusters->getClusters(), sizeof(glm::uvec2) * kClusterCount);
+  memcpy(resources->lightIndexStorage[index].mapped_, clusters->getIndices(), sizeof(uint32) * index_count);
 
   for (auto& internal_material : resources->internalMaterials) {
     uint64_t sceneUboSize = internal_material.entitiesReferenced * padding;
@@ -2247,6 +3061,46 @@ void VulkanApp::updateUniformBuffers(uint32 index)
 
 /*********************************************************************************************/
 
+void VulkanApp::updateLightStorage(uint32 index, uint32 light_count)
+{
+  Resources* res = ResourceManager::Get()->getResources();
+  vkdev::Buffer* storage = &res->lightStorage[index];
+
+  //The fence of this image has been waited, the old buffer is no longer in use
+  if (light_count > res->lightCapacity[index]) {
+    uint32 capacity = res->lightCapacity[index];
+    while (capacity < light_count) capacity *= 2;
+    VkDeviceSize light_size = sizeof(LightParams) * capacity;
+
+    storage->destroyBuffer();
+    storage->createBuffer(context_, light_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    vkMapMemory(context_->logDevice_, storage->memory_, 0, light_size, 0, &storage->mapped_);
+    res->lightCapacity[index] = capacity;
+
+    VkDescriptorBufferInfo bufferLightInfo{};
+    bufferLightInfo.buffer = storage->buffer_;
+    bufferLightInfo.offset = 0;
+    bufferLightInfo.range = VK_WHOLE_SIZE;
+
+    std::vector<VkWriteDescriptorSet> descriptor_write;
+    for (auto& material : res->internalMaterials) {
+      if (!material.entitiesReferenced) continue;
+      if (material.layout != kLayoutType_Simple_2Binds && material.layout != kLayoutType_PBRIBL) continue;
+      descriptor_write.push_back(dev::StaticHelpers::descriptorWriteInitializer(5,
+                                                  VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                                 material.matDescriptorSet[index],
+                                                                &bufferLightInfo));
+    }
+    vkUpdateDescriptorSets(context_->logDevice_, static_cast<uint32>(descriptor_write.size()),
+                           descriptor_write.data(), 0, nullptr);
+  }
+
+  memcpy(storage->mapped_, res->sceneLights.data(), sizeof(LightParams) * light_count);
+}
+
+/*********************************************************************************************/
+
 void VulkanApp::initFrameData(uint32 frame_count)
 {
   for (size_t i = 0; i < frame_count; i++) {
@@ -2306,6 +3160,7 @@ void VulkanApp::destroyFrameData(FrameData& frame_data)
 
 int32 VulkanApp::acquireNextImage(uint32* image)
 {
+  PROFILE_FUNCTION();
   VkSemaphore acquireSemaphore;
   if (context_->recycledSemaphores.empty()) {
     VkSemaphoreCreateInfo info = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
@@ -2354,39 +3209,26 @@ int32 VulkanApp::acquireNextImage(uint32* image)
 
 void VulkanApp::render(uint32 index)
 {
-  VkFramebuffer framebuffer = context_->swapchainFramebuffers[index];
-
+  PROFILE_FUNCTION();
   VkCommandBuffer cmd_buffer = context_->perFrame[index].primaryCommandBuffer;
 
   VkCommandBufferBeginInfo begin_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
   begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
   vkBeginCommandBuffer(cmd_buffer, &begin_info);
-  
-  std::array<VkClearValue, 2> clearColor{};
-  clearColor[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-  clearColor[1].depthStencil = { 1.0f, 0 };
-
-  VkRenderPassBeginInfo rp_begin{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
-  rp_begin.renderPass = context_->renderPass;
-  rp_begin.framebuffer = framebuffer;
-  rp_begin.renderArea.extent.width = context_->swapchainDimensions.width;
-  rp_begin.renderArea.extent.height = context_->swapchainDimensions.height;
-  rp_begin.clearValueCount = clearColor.size();
-  rp_begin.pClearValues = clearColor.data();
-
-  vkCmdBeginRenderPass(cmd_buffer, &rp_begin, VK_SUBPASS_CONTENTS_INLINE);
-
-  int64_t padding = dev::StaticHelpers::padUniformBufferOffset(context_, sizeof(UniformBlocks));
-
-  std::queue<DrawCallData>* drawcs = &resources_->draw_calls;
-  DrawCmd drawcmd;
-  while (!drawcs->empty()) {
-    drawcmd.Execute(cmd_buffer, drawcs->front(), index, padding);
-    drawcs->pop();
+  resources_->gpuProfiler.beginFrame(cmd_buffer, index);
+
+  FrameGraph* frame = &resources_->frameGraph;
+  frame->frameIndex = index;
+  frame->graph.bindImage(frame->swapchain, context_->swapchainImages[index], context_->swapchainImageViews[index],
+                         context_->swapchainDimensions.width, context_->swapchainDimensions.height);
+  if (context_->caps.gpuCulling) {
+    frame->graph.bindBuffer(frame->indirect, resources_->gpuCulling.getIndirectBuffer(index));
+    frame->graph.bindBuffer(frame->count, resources_->gpuCulling.getCountBuffer(index));
   }
 
-  vkCmdEndRenderPass(cmd_buffer);
+  frame->graph.execute(cmd_buffer);
+
   vkEndCommandBuffer(cmd_buffer);
 
   VkPipelineStageFlags waitStage{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
@@ -2406,6 +3248,7 @@ void VulkanApp::render(uint32 index)
 
 int32 VulkanApp::presentImage(uint32 index)
 {
+  PROFILE_FUNCTION();
   VkPresentInfoKHR present{ VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
   present.swapchainCount = 1;
   present.pSwapchains = &context_->swapChain;
@@ -2421,6 +3264,7 @@ int32 VulkanApp::presentImage(uint32 index)
 
 void VulkanApp::drawFrame()
 {
+  PROFILE_FUNCTION();
   uint32 imageIndex;
 
   auto result = acquireNextImage(&imageIndex);
@@ -2433,6 +3277,8 @@ void VulkanApp::drawFrame()
 
   render(imageIndex);
   result = presentImage(imageIndex);
+  resources_->dynamicResolution.update(resources_->gpuProfiler.getFrameTime());
+  resources_->gpuProfiler.update();
 }
 
 /*********************************************************************************************/
@@ -2467,30 +3313,99 @@ void VulkanApp::start()
   glfwSetKeyCallback(context_->window_, InputManager::keyCallback);
   glfwSetInputMode(context_->window_, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
   glfwSetCursorPosCallback(context_->window_, InputManager::mouseCallback);
-  user_app_->init();
-  createAppInstance();
-  setupDebugMessenger();
-  createSurface();
-  setupPhysicalDevice();
-  createLogicalDevice();
-  createSwapChain();
-  createRenderPass();
-  createDescriptorSetLayout();
-  createPipelineLayout();
-  createPipelineCache();
-  createInternalMaterials();
-  createCommandPool();
-  createDepthResource();
-  createFramebuffer();
-  storeTextures();
-  createVertexBuffers();
-  createIndexBuffers();
-  generateNoiseTexture(512, 512);
-  generateIBLTextures();
-
-  createUniformBuffers();
-  createDescriptorPool();
-  createDescriptorSets();
+
+  //Scene, device and file decoding overlap. Everything submitting to the queue shares its lane,
+  //pipelines compile meanwhile on other threads
+  vkdev::TaskGraph startup;
+  std::vector<vkdev::DecodedImage> decoded;
+  std::array<vkdev::DecodedImage, 2> terrain_decoded;
+  uint32 textures = 0;
+
+  uint32 scene = startup.addTask("scene", [this]() { user_app_->init(); });
+  uint32 device = startup.addTask("device", [this]() {
+    createAppInstance();
+    setupDebugMessenger();
+    createSurface();
+    setupPhysicalDevice();
+    createLogicalDevice();
+  });
+  uint32 swapchain = startup.addTask("swapchain", [this]() {
+    createSwapChain();
+    createRenderPass();
+  }, { device });
+  uint32 layouts = startup.addTask("layouts", [this]() {
+    createDescriptorSetLayout();
+    createPipelineLayout();
+    createPipelineCache();
+  }, { device });
+  uint32 pipelines = startup.addTask("pipelines", [this]() { createInternalMaterials(); }, { layouts, swapchain });
+  uint32 commands = startup.addTask("commands", [this]() {
+    createCommandPool();
+    createGPUProfiler();
+  }, { swapchain });
+  uint32 depth = startup.addTask("depth", [this]() { createDepthResource(); }, { device });
+
+  //One decode per image file, the list is known once the scene is built. Streamed textures read their own levels
+  uint32 decode = startup.addTask("decode list", [this, &startup, &decoded, &textures]() {
+    decoded.resize(Scene::textureCount);
+    if (context_->caps.textureStreaming) return;
+    for (uint32 i = 0; i < Scene::textureCount; i++) {
+      Texture* user_texture = Scene::userTextures[i].get();
+      if (user_texture->getType() != TextureType::kTextureType_2D) continue;
+      vkdev::DecodedImage* image = &decoded[i];
+      uint32 task = startup.addTask("decode texture", [user_texture, image]() {
+        vkdev::VkTexture::decodeImage(user_texture->getPath().c_str(), image);
+      });
+      startup.addDependency(textures, task);
+    }
+  }, { scene, device });
+  textures = startup.addTask("textures", [this, &decoded]() { storeTextures(decoded.data()); },
+                             { decode, commands }, kTaskLane_Queue);
+
+  uint32 meshes = startup.addTask("meshes", [this]() {
+    createVertexBuffers();
+    createIndexBuffers();
+  }, { scene, commands }, kTaskLane_Queue);
+
+  uint32 noise = startup.addTask("noise", [this]() {
+    uint32 noise_size = context_->caps.gpuNoise ? kGPUNoiseResolution : 512;
+    if (enableNoiseBenchmark) FractalNoise::benchmark();
+    generateNoiseTexture(noise_size, noise_size);
+  }, { commands }, kTaskLane_Queue);
+
+  uint32 grass = startup.addTask("decode grass", [&terrain_decoded]() {
+    vkdev::VkTexture::decodeImage(kGrassTexturePath, &terrain_decoded[0]);
+  });
+  uint32 rock = startup.addTask("decode rock", [&terrain_decoded]() {
+    vkdev::VkTexture::decodeImage(kRockTexturePath, &terrain_decoded[1]);
+  });
+  uint32 terrain = startup.addTask("terrain textures", [this, &terrain_decoded]() {
+    loadTerrainTextures(terrain_decoded.data());
+  }, { commands, grass, rock }, kTaskLane_Queue);
+
+  //Skipped without a skybox texture to filter
+  uint32 brdf = startup.addTask("brdf lut", [this]() {
+    if (hasSkyboxTexture()) generateBRDFLUT();
+  }, { scene, layouts, commands }, kTaskLane_Queue);
+  uint32 irradiance = startup.addTask("irradiance cube", [this]() {
+    if (hasSkyboxTexture()) generateIrradianceCube();
+  }, { layouts, textures, meshes }, kTaskLane_Queue);
+  uint32 prefiltered = startup.addTask("prefiltered cube", [this]() {
+    if (hasSkyboxTexture()) generatePrefilteredCube();
+  }, { layouts, textures, meshes }, kTaskLane_Queue);
+
+  startup.addTask("frame resources", [this]() {
+    createUniformBuffers();
+    createHeightmapStreamer();
+    createDescriptorPool();
+    createDescriptorSets();
+    createBindlessTextureSet();
+    createGPUCulling();
+    createRenderGraph();
+  }, { pipelines, depth, textures, meshes, noise, terrain, brdf, irradiance, prefiltered }, kTaskLane_Queue);
+
+  startup.run(std::max(std::thread::hardware_concurrency(), 2u));
+  startup.report();
 }
 
 /*********************************************************************************************/
@@ -2499,21 +3414,35 @@ void VulkanApp::loop()
 { 
   Scene::lastTime = std::chrono::high_resolution_clock::now();
   bool should_close = false;
+  bool trace_requested = false;
+  bool first_frame = true;
+  PROFILE_THREAD("main");
   while (!should_close && !glfwWindowShouldClose(context_->window_)) {
+    PROFILE_ZONE("frame");
     auto currentTime = std::chrono::high_resolution_clock::now();
     float deltaTime = std::chrono::duration<float, std::chrono::seconds::period>
                                   (currentTime - Scene::lastTime).count();
     glfwPollEvents();
     Scene::camera.cameraInput(deltaTime);
     should_close = InputManager::getInputState(kKeyCode_ESC);
+    //Trace written once per press
+    bool trace_key = InputManager::getInputState(kKeyCode_F12);
+    if (enableCPUProfiler && trace_key && !trace_requested) PROFILE_WRITE_TRACE(kTracePath);
+    trace_requested = trace_key;
     user_app_->run(deltaTime);
     Scene::camera.updateCamera();
     drawFrame();
+    //Reported with the other timings of the GPU profiler
+    if (enableGPUProfiler && first_frame) {
+      printf("\nFirst frame after %.2f ms\n", glfwGetTime() * 1000.0);
+      first_frame = false;
+    }
 
     Scene::lastTime = currentTime;
   }
 
   vkDeviceWaitIdle(context_->logDevice_);
+  PROFILE_WRITE_TRACE(kTracePath);
 }
 
 /*********************************************************************************************/
@@ -2523,10 +3452,7 @@ void VulkanApp::end()
   user_app_->clear();
 
   vkQueueWaitIdle(context_->graphicsQueue);
-  for (auto& framebuffer : context_->swapchainFramebuffers) {
-    vkDestroyFramebuffer(context_->logDevice_, framebuffer, nullptr);
-  }
-  context_->swapchainFramebuffers.clear();
+  resources_->frameGraph.graph.destroy();
 
   for (auto& frame_data : context_->perFrame) {
     destroyFrameData(frame_data);
@@ -2545,12 +3471,25 @@ void VulkanApp::end()
 
   vkDestroyPipelineCache(context_->logDevice_, resources_->pipelineCache, nullptr);
 
+  vkDestroyDescriptorPool(context_->logDevice_, resources_->bindless.pool, nullptr);
+  vkDestroyDescriptorSetLayout(context_->logDevice_, resources_->bindless.layout, nullptr);
+
   for (auto& material : resources_->internalMaterials) {
     dev::StaticHelpers::destroyMaterial(context_, &material);
   }
+  resources_->pipelineStates.save(kPipelineVariantsPath);
+  resources_->pipelineStates.destroy();
+
+  resources_->gpuCulling.destroy();
+  resources_->gpuProfiler.destroy();
+  resources_->dynamicResolution.destroy();
+  resources_->noiseGenerator.destroy();
+  resources_->heightmap.destroy();
+  resources_->textureStreamer.destroy();
 
 
   vkDestroyRenderPass(context_->logDevice_, context_->renderPass, nullptr);
+  vkDestroyRenderPass(context_->logDevice_, context_->depthRenderPass, nullptr);
 
   //Swap chain
   resources_->depthAttachment.destroyTexture();
@@ -2567,6 +3506,8 @@ void VulkanApp::end()
   resources_->brdf.destroyTexture();
   resources_->irradianceCube.destroyTexture();
   resources_->prefilteredCube.destroyTexture();
+  context_->stagingArena.destroy();
+  context_->shaderCache.destroy(context_->logDevice_);
 
   //Vertex Buffers
   ResourceManager* rm = ResourceManager::Get();